@@ -2,10 +2,14 @@
 //The MIT License - See ../../LICENSE for more info
 #include "SE_PhotoStudio.h"
 #include "DataManager.h"
+#include "FrameScheduler.h"
+#include "Metrics.h"
 
 
 
 DataManager::DataManager()
+	: meshMutex("DataManager::meshMutex"), configMutex("DataManager::configMutex"),
+	toolboxMutex("DataManager::toolboxMutex"), imgMutex("DataManager::imgMutex")
 {
 	_runningthreads = 0;
 }
@@ -47,7 +51,7 @@ OrbiterMesh* DataManager::GetGlobalMesh(string meshName, video::IVideoDriver* dr
 //returns pointer to the requsted mesh. Loads mesh if it doesn't exist yet. returns NULL if mesh could not be created
 {
 	//prevent race condition
-	meshMutex.lock();
+	meshMutex.lock(__FUNCTION__);
 	map<string, OrbiterMesh*>::iterator pos = meshMap.find(meshName);
 	bool temp = (pos == meshMap.end());	//split this check here so we can unlock the mutex ASAP
 	meshMutex.unlock();
@@ -55,14 +59,16 @@ OrbiterMesh* DataManager::GetGlobalMesh(string meshName, video::IVideoDriver* dr
 	if (temp) 
 	//meshName not found in the map, load mesh from file
 	{
+		Metrics::incrementCounter("datamanager.mesh_misses");
 		OrbiterMesh *newMesh = new OrbiterMesh;
 		if (newMesh->setupMesh(string(Helpers::workingDirectory + "\\Meshes\\" + meshName + ".msh"), driver))
 		//mesh loaded succesfully, enter in map and return pointer
 		{
 			//lock to prevent race condition
-			meshMutex.lock();
+			meshMutex.lock(__FUNCTION__);
 			meshMap[meshName] = newMesh;
 			meshMutex.unlock();
+			Metrics::addToGauge("datamanager.resident_bytes", newMesh->getResidentBytes());
 
 			return newMesh;
 		}
@@ -77,6 +83,7 @@ OrbiterMesh* DataManager::GetGlobalMesh(string meshName, video::IVideoDriver* dr
 	else 
 	//mesh found in map, return pointer
 	{
+		Metrics::incrementCounter("datamanager.mesh_hits");
 		return pos->second;
 	}
 }
@@ -85,7 +92,7 @@ OrbiterMesh* DataManager::GetGlobalMesh(string meshName, video::IVideoDriver* dr
 VesselData* DataManager::GetGlobalConfig(string cfgName, video::IVideoDriver* driver)
 //returns pointer to the requsted VesselData. Loads VesselData if it doesn't exist yet. returns NULL if cfg could not be found
 {
-	configMutex.lock();
+	configMutex.lock(__FUNCTION__);
 	//insure a consistent style for the key
 	transform(cfgName.begin(), cfgName.end(), cfgName.begin(), ::tolower);
 	Helpers::slashreplace(cfgName);
@@ -96,13 +103,16 @@ VesselData* DataManager::GetGlobalConfig(string cfgName, video::IVideoDriver* dr
 	if (temp)
 	//cfg not found in the map, load from file
 	{
+		Metrics::incrementCounter("datamanager.config_misses");
 		VesselData *newVessel = LoadVesselData(cfgName, driver);
 		if (newVessel != NULL)
 		//cfg loaded succesfully, enter in map and return pointer
 		{
-			configMutex.lock();
+			configMutex.lock(__FUNCTION__);
 			cfgMap[cfgName] = newVessel;
 			configMutex.unlock();
+			//whatever waited for this vessel can be shown now
+			FrameScheduler::markDirty();
 			//Helpers::writeToLog(std::string("\n Loaded vessel config:" + cfgName));
 		}
 		else
@@ -110,11 +120,13 @@ VesselData* DataManager::GetGlobalConfig(string cfgName, video::IVideoDriver* dr
             Log::writeToLog(Log::ERR, "Could not load cfg: ", cfgName);
 		}
 		_runningthreads--;		//the loading thread will terminate after returning
+		Metrics::setGauge("datamanager.loader_queue", _runningthreads);
 		return newVessel;
 	}
 	else
 	//cfg found in map, return pointer
 	{
+		Metrics::incrementCounter("datamanager.config_hits");
 		return pos->second;
 	}
 }
@@ -122,7 +134,7 @@ VesselData* DataManager::GetGlobalConfig(string cfgName, video::IVideoDriver* dr
 ToolboxData* DataManager::GetGlobalToolboxData(std::string configName, video::IVideoDriver* driver)
 //returns pointer to requested ToolboxData
 {
-	toolboxMutex.lock();
+	toolboxMutex.lock(__FUNCTION__);
 	map<string, ToolboxData*>::iterator pos = toolboxMap.find(configName);
 	bool temp = (pos == toolboxMap.end());	//again, put this here so we can unlock ASAP
 	toolboxMutex.unlock();
@@ -130,6 +142,7 @@ ToolboxData* DataManager::GetGlobalToolboxData(std::string configName, video::IV
 	if (temp)
 	//data not found in the map, load from file
 	{
+		Metrics::incrementCounter("datamanager.toolbox_misses");
 		//create new toolbox data
 		ToolboxData* toolboxData = new ToolboxData;
 		//set the config file path
@@ -217,10 +230,11 @@ ToolboxData* DataManager::GetGlobalToolboxData(std::string configName, video::IV
 		{
 			std::thread backgroundLoadThread = std::thread(&DataManager::GetGlobalConfig, this, configName, driver);
 			_runningthreads++;
+			Metrics::setGauge("datamanager.loader_queue", _runningthreads);
 			//detach the thread to continue background loading
 			backgroundLoadThread.detach();
 
-			toolboxMutex.lock();
+			toolboxMutex.lock(__FUNCTION__);
 			toolboxMap[configName] = toolboxData;
 			toolboxMutex.unlock();
 			//Helpers::writeToLog(std::string("\n Loaded toolbox data:" + configName));
@@ -236,6 +250,7 @@ ToolboxData* DataManager::GetGlobalToolboxData(std::string configName, video::IV
 	else
 		//data found in map, return pointer
 	{
+		Metrics::incrementCounter("datamanager.toolbox_hits");
 		return pos->second;
 	}
 }
@@ -244,7 +259,7 @@ ToolboxData* DataManager::GetGlobalToolboxData(std::string configName, video::IV
 video::ITexture *DataManager::GetGlobalImg(string imgname, string configname, video::IVideoDriver* driver)
 //returns pointer to an image, loads it from file if image is requested for the first time
 {
-	imgMutex.lock();
+	imgMutex.lock(__FUNCTION__);
 	map<string, video::ITexture*>::iterator pos = imgMap.find(imgname);
 	bool temp = (pos == imgMap.end());	//put check hear so we can unlock the mutex ASAP
 	imgMutex.unlock();
@@ -252,9 +267,10 @@ video::ITexture *DataManager::GetGlobalImg(string imgname, string configname, vi
 	if (temp)
 	//image Name not found in the map, load mesh from file
 	{
+		Metrics::incrementCounter("datamanager.image_misses");
 	
 		string completeImgPath = Helpers::workingDirectory + "\\StackEditor\\Images\\" + imgname;
-		Helpers::videoDriverMutex.lock();
+		Helpers::videoDriverMutex.lock(__FUNCTION__);
 		IImage *img = driver->createImageFromFile(completeImgPath.data());
 		Helpers::videoDriverMutex.unlock();
 		
@@ -263,7 +279,7 @@ video::ITexture *DataManager::GetGlobalImg(string imgname, string configname, vi
 		if (img != NULL)
 		//image loaded succesfully, enter in map and return pointer
 		{
-			Helpers::videoDriverMutex.lock();
+			Helpers::videoDriverMutex.lock(__FUNCTION__);
 			newTex = driver->addTexture("tbxtex", img);
 			img->drop();
 			Helpers::videoDriverMutex.unlock();
@@ -281,9 +297,10 @@ video::ITexture *DataManager::GetGlobalImg(string imgname, string configname, vi
 		if (newTex != NULL)
 		//register the texture in the data manager for future retrieval and return it
 		{
-			imgMutex.lock();
+			imgMutex.lock(__FUNCTION__);
 			imgMap[imgname] = newTex;
 			imgMutex.unlock();
+			Metrics::addToGauge("datamanager.resident_bytes", newTex->getPitch() * newTex->getSize().Height);
 			return newTex;
 		}
 		else
@@ -296,6 +313,7 @@ video::ITexture *DataManager::GetGlobalImg(string imgname, string configname, vi
 	else
 	//image found in map, return pointer
 	{
+		Metrics::incrementCounter("datamanager.image_hits");
 		return pos->second;
 	}
 
@@ -374,6 +392,37 @@ VesselData *DataManager::LoadVesselData(string configFileName, video::IVideoDriv
 				meshDefined = true;
 			}
 		}
+		//mass properties and the IMS figures that get summed up per stack. same keys the toolbox table shows
+		else if (tokens[0].compare("mass") == 0 && tokens.size() >= 2)
+		{
+			newVessel->massData.mass = Helpers::stringToDouble(tokens[1]);
+		}
+		else if (tokens[0].compare("maxfuel") == 0 && tokens.size() >= 2)
+		{
+			newVessel->massData.maxFuel = Helpers::stringToDouble(tokens[1]);
+		}
+		else if (tokens[0].compare("pmi") == 0 && tokens.size() >= 4)
+		{
+			newVessel->massData.pmi = core::vector3df((f32)Helpers::stringToDouble(tokens[1]),
+				(f32)Helpers::stringToDouble(tokens[2]), (f32)Helpers::stringToDouble(tokens[3]));
+			newVessel->massData.hasPmi = true;
+		}
+		else if (tokens[0].compare("powerinput") == 0 && tokens.size() >= 2)
+		{
+			newVessel->massData.powerInput += Helpers::stringToDouble(tokens[1]);
+		}
+		else if (tokens[0].compare("poweroutput") == 0 && tokens.size() >= 2)
+		{
+			newVessel->massData.powerOutput += Helpers::stringToDouble(tokens[1]);
+		}
+		else if (tokens[0].compare("thrust") == 0 && tokens.size() >= 2)
+		{
+			newVessel->massData.thrust += Helpers::stringToDouble(tokens[1]);
+		}
+		else if ((tokens[0].compare("capacity") == 0 || tokens[0].compare("crewnumber") == 0) && tokens.size() >= 2)
+		{
+			newVessel->massData.crewCapacity += Helpers::stringToInt(tokens[1]);
+		}
 
 		//clear tokens
 		tokens.clear();
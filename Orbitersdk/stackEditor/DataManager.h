@@ -3,12 +3,14 @@
 #pragma once
 
 #include <mutex>
+#include "ProfiledMutex.h"
 #include <thread>
 
 #include "Common.h"
 #include "SE_ImsData.h"
 #include "OrbiterMesh.h"
 #include "OrbiterDockingPort.h"
+#include "StackMassProperties.h"
 
 class SE_PhotoStudio;
 
@@ -27,6 +29,7 @@ struct VesselData
 	OrbiterMesh *vesselMesh;
 	vector<OrbiterDockingPort> dockingPorts;
 	ITexture *vesselImg;
+	VesselMassData massData;
 };
 
 
@@ -47,7 +50,7 @@ public:
 private:
 	VesselData* LoadVesselData(std::string configFileName, video::IVideoDriver* driver);
 
-	std::mutex meshMutex, configMutex, toolboxMutex, imgMutex;	//stores mutexes for safe multithreading
+	ProfiledMutex meshMutex, configMutex, toolboxMutex, imgMutex;	//stores mutexes for safe multithreading
 
 	std::map<std::string, OrbiterMesh*> meshMap;		//stores all loaded meshes
 	std::map<std::string, ToolboxData*> toolboxMap;	//stores all loaded toolbox data
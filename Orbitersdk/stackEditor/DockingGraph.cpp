@@ -0,0 +1,263 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "DockingGraph.h"
+#include "VesselSceneNode.h"
+#include "StackMassProperties.h"
+
+std::vector<VesselSceneNode*> DockingGraph::vessels;
+std::vector<std::vector<DockingEdge> > DockingGraph::edges;
+std::vector<unsigned int> DockingGraph::componentOf;
+std::vector<unsigned int> DockingGraph::slotInComponent;
+std::vector<std::vector<unsigned int> > DockingGraph::components;
+std::vector<unsigned int> DockingGraph::freeVessels;
+std::vector<unsigned int> DockingGraph::freeComponents;
+std::vector<unsigned char> DockingGraph::searchMarks;
+
+static bool sameEdge(const DockingEdge& a, const DockingEdge& b)
+{
+	return a.ourPort == b.ourPort && a.otherVessel == b.otherVessel && a.otherPort == b.otherPort;
+}
+
+unsigned int DockingGraph::addVessel(VesselSceneNode* vessel)
+{
+	unsigned int index;
+	if (freeVessels.size() > 0)
+	{
+		index = freeVessels.back();
+		freeVessels.pop_back();
+	}
+	else
+	{
+		index = vessels.size();
+		vessels.push_back(0);
+		edges.push_back(std::vector<DockingEdge>());
+		componentOf.push_back(0);
+		slotInComponent.push_back(0);
+	}
+	vessels[index] = vessel;
+	edges[index].clear();
+	//every vessel starts out alone
+	unsigned int component = createComponent();
+	componentOf[index] = component;
+	slotInComponent[index] = 0;
+	components[component].push_back(index);
+	StackMassProperties::vesselAdded(index, component, vessel);
+	return index;
+}
+
+void DockingGraph::removeVessel(VesselSceneNode* vessel)
+{
+	unsigned int index = vessel->getGraphIndex();
+	while (edges[index].size() > 0)
+		removeEdge(index, edges[index].back());
+
+	//alone in its component now
+	unsigned int component = componentOf[index];
+	StackMassProperties::vesselRemoved(index, component);
+	components[component].clear();
+	freeComponents.push_back(component);
+	vessels[index] = 0;
+	freeVessels.push_back(index);
+}
+
+void DockingGraph::updateVessel(VesselSceneNode* vessel)
+{
+	unsigned int index = vessel->getGraphIndex();
+	std::vector<DockingEdge> wanted;
+	for (unsigned int i = 0; i < vessel->dockingPorts.size(); i++)
+	{
+		const OrbiterDockingPort& port = vessel->dockingPorts[i];
+		if (!port.docked || !Helpers::isUIDRegistered(port.dockedTo.vesselUID))
+			continue;
+		VesselSceneNode* other = Helpers::getVesselByUID(port.dockedTo.vesselUID);
+		if (other == vessel || port.dockedTo.portID >= other->dockingPorts.size())
+			continue;
+		DockingEdge edge = { i, other->getGraphIndex(), port.dockedTo.portID };
+		wanted.push_back(edge);
+	}
+
+	//drop what isn't docked anymore. a copy, removing changes the list
+	std::vector<DockingEdge> current = edges[index];
+	for (unsigned int i = 0; i < current.size(); i++)
+	{
+		bool stillWanted = false;
+		for (unsigned int j = 0; j < wanted.size() && !stillWanted; j++)
+			stillWanted = sameEdge(current[i], wanted[j]);
+		if (!stillWanted)
+			removeEdge(index, current[i]);
+	}
+	for (unsigned int i = 0; i < wanted.size(); i++)
+	{
+		bool exists = false;
+		for (unsigned int j = 0; j < edges[index].size() && !exists; j++)
+			exists = sameEdge(edges[index][j], wanted[i]);
+		if (!exists)
+			addEdge(index, wanted[i]);
+	}
+}
+
+VesselSceneNode* DockingGraph::getVessel(unsigned int index)
+{
+	return index < vessels.size() ? vessels[index] : 0;
+}
+
+const std::vector<DockingEdge>& DockingGraph::getEdges(VesselSceneNode* vessel)
+{
+	return edges[vessel->getGraphIndex()];
+}
+
+const std::vector<unsigned int>& DockingGraph::getComponent(VesselSceneNode* vessel)
+{
+	return components[componentOf[vessel->getGraphIndex()]];
+}
+
+unsigned int DockingGraph::getComponentIndex(VesselSceneNode* vessel)
+{
+	return componentOf[vessel->getGraphIndex()];
+}
+
+bool DockingGraph::areConnected(VesselSceneNode* a, VesselSceneNode* b)
+{
+	return componentOf[a->getGraphIndex()] == componentOf[b->getGraphIndex()];
+}
+
+void DockingGraph::addEdge(unsigned int vessel, const DockingEdge& edge)
+{
+	edges[vessel].push_back(edge);
+	DockingEdge reverse = { edge.otherPort, vessel, edge.ourPort };
+	edges[edge.otherVessel].push_back(reverse);
+	if (componentOf[vessel] != componentOf[edge.otherVessel])
+		mergeComponents(vessel, edge.otherVessel);
+}
+
+void DockingGraph::removeEdge(unsigned int vessel, const DockingEdge& edge)
+{
+	DockingEdge reverse = { edge.otherPort, vessel, edge.ourPort };
+	eraseHalfEdge(vessel, edge);
+	eraseHalfEdge(edge.otherVessel, reverse);
+	splitComponent(vessel, edge.otherVessel);
+}
+
+bool DockingGraph::eraseHalfEdge(unsigned int vessel, const DockingEdge& edge)
+{
+	std::vector<DockingEdge>& vesselEdges = edges[vessel];
+	for (unsigned int i = 0; i < vesselEdges.size(); i++)
+	{
+		if (sameEdge(vesselEdges[i], edge))
+		{
+			vesselEdges[i] = vesselEdges.back();
+			vesselEdges.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+//moves every member of the smaller component into the bigger one
+void DockingGraph::mergeComponents(unsigned int a, unsigned int b)
+{
+	unsigned int componentA = componentOf[a];
+	unsigned int componentB = componentOf[b];
+	if (components[componentA].size() < components[componentB].size())
+		std::swap(componentA, componentB);
+	std::vector<unsigned int> moving;
+	moving.swap(components[componentB]);
+	for (unsigned int i = 0; i < moving.size(); i++)
+	{
+		componentOf[moving[i]] = componentA;
+		slotInComponent[moving[i]] = components[componentA].size();
+		components[componentA].push_back(moving[i]);
+	}
+	StackMassProperties::componentsMerged(componentA, componentB);
+	freeComponents.push_back(componentB);
+}
+
+//a and b just lost the edge between them. searches from both sides at once until either the two searches meet,
+//in which case nothing changes, or one side runs out of vessels, which is then split off into a new component.
+//that way only the smaller half ever gets walked completely
+void DockingGraph::splitComponent(unsigned int a, unsigned int b)
+{
+	if (a == b)
+		return;
+	if (searchMarks.size() < vessels.size())
+		searchMarks.resize(vessels.size(), 0);
+	std::vector<unsigned int> frontier[2], visited[2];
+	frontier[0].push_back(a);
+	frontier[1].push_back(b);
+	visited[0].push_back(a);
+	visited[1].push_back(b);
+	searchMarks[a] = 1;			//bit 0 seen from a, bit 1 seen from b
+	searchMarks[b] = 2;
+
+	int isolatedSide = -1;
+	bool connected = false;
+	while (!connected && isolatedSide == -1)
+	{
+		for (int side = 0; side < 2 && !connected && isolatedSide == -1; side++)
+		{
+			//one step of the search on this side
+			unsigned int current = frontier[side].back();
+			frontier[side].pop_back();
+			for (unsigned int i = 0; i < edges[current].size(); i++)
+			{
+				unsigned int next = edges[current][i].otherVessel;
+				if (searchMarks[next] & (1 << side))
+					continue;
+				if (searchMarks[next] != 0)
+				//the other search already got here, still connected
+				{
+					connected = true;
+					break;
+				}
+				searchMarks[next] = 1 << side;
+				frontier[side].push_back(next);
+				visited[side].push_back(next);
+			}
+			if (!connected && frontier[side].size() == 0)
+				isolatedSide = side;
+		}
+	}
+
+	//the marks are shared between searches, only clear what we touched
+	for (int side = 0; side < 2; side++)
+	{
+		for (unsigned int i = 0; i < visited[side].size(); i++)
+			searchMarks[visited[side][i]] = 0;
+	}
+	if (isolatedSide != -1)
+	{
+		//this side is everything that is left on it, give it its own component
+		unsigned int component = createComponent();
+		for (unsigned int i = 0; i < visited[isolatedSide].size(); i++)
+			moveToComponent(visited[isolatedSide][i], component);
+	}
+}
+
+unsigned int DockingGraph::createComponent()
+{
+	if (freeComponents.size() > 0)
+	{
+		unsigned int component = freeComponents.back();
+		freeComponents.pop_back();
+		StackMassProperties::componentCreated(component);
+		return component;
+	}
+	components.push_back(std::vector<unsigned int>());
+	StackMassProperties::componentCreated(components.size() - 1);
+	return components.size() - 1;
+}
+
+void DockingGraph::moveToComponent(unsigned int vessel, unsigned int component)
+{
+	//take it out of the old component by moving the last member into its slot
+	std::vector<unsigned int>& oldMembers = components[componentOf[vessel]];
+	unsigned int slot = slotInComponent[vessel];
+	oldMembers[slot] = oldMembers.back();
+	slotInComponent[oldMembers[slot]] = slot;
+	oldMembers.pop_back();
+
+	StackMassProperties::vesselMovedToComponent(vessel, componentOf[vessel], component);
+	componentOf[vessel] = component;
+	slotInComponent[vessel] = components[component].size();
+	components[component].push_back(vessel);
+}
@@ -0,0 +1,59 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+
+using namespace irr;
+
+class VesselSceneNode;
+
+//one docking connection, seen from one of the two vessels
+struct DockingEdge
+{
+	unsigned int ourPort;
+	unsigned int otherVessel;			//graph index of the vessel we're docked to
+	unsigned int otherPort;
+};
+
+//which vessel is docked to which, with a dense index per vessel and the connected components kept up to date.
+//mirrors the docked flags of the docking ports, vessels resync their edges whenever one of their ports changes.
+//docking merges the smaller component into the bigger one, undocking only walks the smaller of the two halves,
+//so finding everything in a stack costs the size of the stack, not the size of the scene
+class DockingGraph
+{
+public:
+	//returns the graph index of the new vessel
+	static unsigned int addVessel(VesselSceneNode* vessel);
+	static void removeVessel(VesselSceneNode* vessel);
+	//brings the edges of the vessel in line with the docked flags of its ports.
+	//ports docked to a vessel that doesn't exist yet are picked up once the other vessel syncs
+	static void updateVessel(VesselSceneNode* vessel);
+
+	static VesselSceneNode* getVessel(unsigned int index);
+	static const std::vector<DockingEdge>& getEdges(VesselSceneNode* vessel);
+	//all vessels connected to the passed one, including itself
+	static const std::vector<unsigned int>& getComponent(VesselSceneNode* vessel);
+	//stays the same until the vessel docks or undocks
+	static unsigned int getComponentIndex(VesselSceneNode* vessel);
+	static bool areConnected(VesselSceneNode* a, VesselSceneNode* b);
+
+private:
+	static void addEdge(unsigned int vessel, const DockingEdge& edge);
+	static void removeEdge(unsigned int vessel, const DockingEdge& edge);
+	static bool eraseHalfEdge(unsigned int vessel, const DockingEdge& edge);
+	static void mergeComponents(unsigned int a, unsigned int b);
+	static void splitComponent(unsigned int a, unsigned int b);
+	static unsigned int createComponent();
+	static void moveToComponent(unsigned int vessel, unsigned int component);
+
+	static std::vector<VesselSceneNode*> vessels;				//0 for free indices
+	static std::vector<std::vector<DockingEdge> > edges;
+	static std::vector<unsigned int> componentOf;
+	static std::vector<unsigned int> slotInComponent;			//position of the vessel in its component's member list
+	static std::vector<std::vector<unsigned int> > components;
+	static std::vector<unsigned int> freeVessels;
+	static std::vector<unsigned int> freeComponents;
+	static std::vector<unsigned char> searchMarks;				//scratch space of splitComponent, all 0 between calls
+};
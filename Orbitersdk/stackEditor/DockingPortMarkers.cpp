@@ -0,0 +1,171 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "DockingPortMarkers.h"
+#include "VesselSceneNode.h"
+
+#include <cmath>
+
+std::map<scene::ISceneManager*, DockingPortMarkerRenderer*> DockingPortMarkerRenderer::renderers;
+const f32 DockingPortMarkerRenderer::markerRadius = 1.1f;
+
+DockingPortMarkerRenderer* DockingPortMarkerRenderer::getRenderer(scene::ISceneManager* mgr)
+{
+	std::map<scene::ISceneManager*, DockingPortMarkerRenderer*>::iterator pos = renderers.find(mgr);
+	if (pos != renderers.end())
+		return pos->second;
+
+	DockingPortMarkerRenderer* renderer = new DockingPortMarkerRenderer(mgr->getRootSceneNode(), mgr);
+	//the root node holds the renderer from now on
+	renderer->drop();
+	return renderer;
+}
+
+DockingPortMarkerRenderer::DockingPortMarkerRenderer(scene::ISceneNode* parent, scene::ISceneManager* mgr)
+	: scene::ISceneNode(parent, mgr, 0), shownMarkers(0)
+{
+	setAutomaticCulling(scene::EAC_OFF);
+	renderers[mgr] = this;
+
+	//keep a copy of a single sphere, the batch gets rebuilt from it every frame
+	scene::IMesh* sphere = mgr->getGeometryCreator()->createSphereMesh(markerRadius, 16, 16);
+	scene::IMeshBuffer* sphereBuffer = sphere->getMeshBuffer(0);
+	video::S3DVertex* vertices = (video::S3DVertex*)sphereBuffer->getVertices();
+	for (u32 i = 0; i < sphereBuffer->getVertexCount(); i++)
+	{
+		video::S3DVertex vertex = vertices[i];
+		//we don't have lighting, so the vertex color is all there is
+		vertex.Color = video::SColor(255, 13, 161, 247);
+		markerVertices.push_back(vertex);
+	}
+	for (u32 i = 0; i < sphereBuffer->getIndexCount(); i++)
+		markerIndices.push_back(sphereBuffer->getIndices()[i]);
+	sphere->drop();
+
+	batch = new scene::CDynamicMeshBuffer(video::EVT_STANDARD, video::EIT_32BIT);
+	//rebuilt every frame, so there's no point in uploading it
+	batch->setHardwareMappingHint(scene::EHM_NEVER);
+
+	//deactivate lighting so we don't get reflections on the markers and make them transparent
+	material.Lighting = false;
+	material.MaterialType = video::EMT_TRANSPARENT_ADD_COLOR;
+}
+
+DockingPortMarkerRenderer::~DockingPortMarkerRenderer()
+{
+	batch->drop();
+	renderers.erase(SceneManager);
+}
+
+void DockingPortMarkerRenderer::addVessel(VesselSceneNode* vessel)
+{
+	for (unsigned int i = 0; i < vessel->dockingPorts.size(); i++)
+	{
+		DockingPortMarker marker;
+		marker.vessel = vessel;
+		marker.portID = i;
+		marker.flags = 0;
+		vessel->dockingPorts[i].markerIndex = markers.size();
+		markers.push_back(marker);
+	}
+}
+
+void DockingPortMarkerRenderer::removeVessel(VesselSceneNode* vessel)
+{
+	for (unsigned int i = 0; i < vessel->dockingPorts.size(); i++)
+	{
+		int index = vessel->dockingPorts[i].markerIndex;
+		if (index < 0 || index >= (int)markers.size())
+			continue;
+		setFlags(index, 0);
+		//move the last marker into the hole, so the array stays packed
+		markers[index] = markers.back();
+		markers[index].vessel->dockingPorts[markers[index].portID].markerIndex = index;
+		markers.pop_back();
+		vessel->dockingPorts[i].markerIndex = -1;
+	}
+}
+
+void DockingPortMarkerRenderer::setFlags(int markerIndex, u32 flags)
+{
+	if (markerIndex < 0 || markerIndex >= (int)markers.size())
+		return;
+	DockingPortMarker& marker = markers[markerIndex];
+	if (marker.flags == 0 && flags != 0)
+		shownMarkers++;
+	else if (marker.flags != 0 && flags == 0)
+		shownMarkers--;
+	marker.flags = flags;
+}
+
+void DockingPortMarkerRenderer::updatePositions()
+{
+	for (u32 i = 0; i < markers.size(); i++)
+	{
+		if (markers[i].flags != 0)
+			markers[i].position = markers[i].vessel->getDockingPortAbsolutePosition(markers[i].portID);
+	}
+}
+
+u32 DockingPortMarkerRenderer::getFlags(int markerIndex)
+{
+	if (markerIndex < 0 || markerIndex >= (int)markers.size())
+		return 0;
+	return markers[markerIndex].flags;
+}
+
+void DockingPortMarkerRenderer::OnRegisterSceneNode()
+{
+	//the markers don't write depth, so they go after the vessels, which render in the transparent pass
+	if (IsVisible && shownMarkers > 0)
+		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void DockingPortMarkerRenderer::render()
+{
+	updatePositions();
+
+	//copy the marker geometry into the batch once for every shown marker
+	batch->getVertexBuffer().set_used(0);
+	batch->getIndexBuffer().set_used(0);
+	batch->getVertexBuffer().reallocate(shownMarkers * markerVertices.size());
+	batch->getIndexBuffer().reallocate(shownMarkers * markerIndices.size());
+	for (u32 i = 0; i < markers.size(); i++)
+	{
+		if (markers[i].flags == 0)
+			continue;
+		u32 firstVertex = batch->getVertexBuffer().size();
+		for (u32 j = 0; j < markerVertices.size(); j++)
+		{
+			video::S3DVertex vertex = markerVertices[j];
+			vertex.Pos += markers[i].position;
+			batch->getVertexBuffer().push_back(vertex);
+		}
+		for (u32 j = 0; j < markerIndices.size(); j++)
+			batch->getIndexBuffer().push_back(firstVertex + markerIndices[j]);
+	}
+	if (batch->getIndexBuffer().size() == 0)
+		return;
+
+	video::IVideoDriver* driver = SceneManager->getVideoDriver();
+	driver->setTransform(video::ETS_WORLD, core::IdentityMatrix);
+	driver->setMaterial(material);
+	driver->drawMeshBuffer(batch);
+	VesselRenderQueue::renderStats.drawCalls++;
+	VesselRenderQueue::renderStats.triangles += batch->getIndexCount() / 3;
+}
+
+const core::aabbox3d<f32>& DockingPortMarkerRenderer::getBoundingBox() const
+{
+	return box;
+}
+
+u32 DockingPortMarkerRenderer::getMaterialCount() const
+{
+	return 1;
+}
+
+video::SMaterial& DockingPortMarkerRenderer::getMaterial(u32 i)
+{
+	return material;
+}
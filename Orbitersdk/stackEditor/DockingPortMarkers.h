@@ -0,0 +1,67 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+
+#include "resource.h"
+
+using namespace irr;
+
+class VesselSceneNode;
+struct OrbiterDockingPort;
+
+//one entry per docking port in the scene
+struct DockingPortMarker
+{
+	VesselSceneNode* vessel;
+	unsigned int portID;
+	core::vector3df position;		//absolute position, refreshed before drawing
+	u32 flags;						//DOCKPORT_ID and/or HELPER_ID if the marker is shown as such
+};
+
+//draws the markers of all docking ports in a scene manager in one go.
+//replaces the two sphere scene nodes every port used to have.
+//a marker is shown as a port marker (DOCKPORT_ID) or a helper marker (HELPER_ID). both look the same,
+//but picking (see ScenePickingTree) only considers markers shown with the requested flag, the same way scene node ids used to work
+class DockingPortMarkerRenderer : public scene::ISceneNode
+{
+public:
+	//returns the renderer of the passed scene manager, creating it if it doesn't exist yet
+	static DockingPortMarkerRenderer* getRenderer(scene::ISceneManager* mgr);
+
+	~DockingPortMarkerRenderer();
+
+	//adds markers for all ports of the vessel and stores their indices in the ports
+	void addVessel(VesselSceneNode* vessel);
+	//removes the markers of all ports of the vessel
+	void removeVessel(VesselSceneNode* vessel);
+	void setFlags(int markerIndex, u32 flags);
+	u32 getFlags(int markerIndex);
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+	virtual const core::aabbox3d<f32>& getBoundingBox() const;
+	virtual u32 getMaterialCount() const;
+	virtual video::SMaterial& getMaterial(u32 i);
+
+	static const f32 markerRadius;
+
+private:
+	DockingPortMarkerRenderer(scene::ISceneNode* parent, scene::ISceneManager* mgr);
+	void updatePositions();
+
+	std::vector<DockingPortMarker> markers;
+	u32 shownMarkers;							//number of markers with any flag set, nothing to do if 0
+
+	//geometry of a single marker around the origin, copied into the batch for every shown marker
+	std::vector<video::S3DVertex> markerVertices;
+	std::vector<u32> markerIndices;
+	scene::CDynamicMeshBuffer* batch;
+	video::SMaterial material;
+	core::aabbox3d<f32> box;
+
+	static std::map<scene::ISceneManager*, DockingPortMarkerRenderer*> renderers;
+};
@@ -0,0 +1,229 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "DockingSolver.h"
+#include "Metrics.h"
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+//half a turn around y. turns a port frame around so it faces the port it docks to, with the same up direction
+static const core::quaternion facingTurn(0, 1, 0, 0);
+
+//builds the quaternion of the rotation that takes the unit axes to x, y and z, which have to be orthonormal
+static core::quaternion quaternionFromAxes(const core::vector3df& x, const core::vector3df& y, const core::vector3df& z)
+{
+	f32 trace = x.X + y.Y + z.Z;
+	if (trace > 0)
+	{
+		f32 s = 0.5f / sqrtf(trace + 1.0f);
+		return core::quaternion((y.Z - z.Y) * s, (z.X - x.Z) * s, (x.Y - y.X) * s, 0.25f / s);
+	}
+	if (x.X > y.Y && x.X > z.Z)
+	{
+		f32 s = 2.0f * sqrtf(1.0f + x.X - y.Y - z.Z);
+		return core::quaternion(0.25f * s, (y.X + x.Y) / s, (z.X + x.Z) / s, (y.Z - z.Y) / s);
+	}
+	if (y.Y > z.Z)
+	{
+		f32 s = 2.0f * sqrtf(1.0f + y.Y - x.X - z.Z);
+		return core::quaternion((y.X + x.Y) / s, 0.25f * s, (z.Y + y.Z) / s, (z.X - x.Z) / s);
+	}
+	f32 s = 2.0f * sqrtf(1.0f + z.Z - x.X - y.Y);
+	return core::quaternion((z.X + x.Z) / s, (z.Y + y.Z) / s, 0.25f * s, (x.Y - y.X) / s);
+}
+
+DockingSolver::DockingSolver()
+{
+}
+
+RigidTransform DockingSolver::getPortFrame(const core::vector3df& position, const core::vector3df& approachDirection, const core::vector3df& referenceDirection)
+{
+	//same axes as the camera look at matrix the ports are set up with
+	core::vector3df z = approachDirection;
+	z.normalize();
+	core::vector3df x = referenceDirection.crossProduct(z);
+	x.normalize();
+	core::vector3df y = z.crossProduct(x);
+	return RigidTransform(quaternionFromAxes(x, y, z), position);
+}
+
+RigidTransform DockingSolver::snap(const RigidTransform& theirVessel, const RigidTransform& theirPort, const RigidTransform& ourPort)
+{
+	//their port in the world, turned around to face it
+	RigidTransform target = combine(theirVessel, theirPort);
+	target.rotation = multiply(target.rotation, facingTurn);
+
+	//take our port to the target, and the vessel along with it
+	RigidTransform result;
+	result.rotation = multiply(target.rotation, conjugate(ourPort.rotation));
+	result.position = target.position - rotate(result.rotation, ourPort.position);
+	return result;
+}
+
+core::quaternion DockingSolver::multiply(const core::quaternion& a, const core::quaternion& b)
+{
+	return core::quaternion(
+		a.W * b.X + a.X * b.W + a.Y * b.Z - a.Z * b.Y,
+		a.W * b.Y - a.X * b.Z + a.Y * b.W + a.Z * b.X,
+		a.W * b.Z + a.X * b.Y - a.Y * b.X + a.Z * b.W,
+		a.W * b.W - a.X * b.X - a.Y * b.Y - a.Z * b.Z);
+}
+
+core::quaternion DockingSolver::conjugate(const core::quaternion& q)
+{
+	return core::quaternion(-q.X, -q.Y, -q.Z, q.W);
+}
+
+core::vector3df DockingSolver::rotate(const core::quaternion& q, const core::vector3df& v)
+{
+	core::vector3df axis(q.X, q.Y, q.Z);
+	core::vector3df t = axis.crossProduct(v) * 2.0f;
+	return v + t * q.W + axis.crossProduct(t);
+}
+
+RigidTransform DockingSolver::combine(const RigidTransform& a, const RigidTransform& b)
+{
+	return RigidTransform(multiply(a.rotation, b.rotation), a.position + rotate(a.rotation, b.position));
+}
+
+RigidTransform DockingSolver::fromMatrix(const core::matrix4& matrix)
+{
+	core::vector3df x(1, 0, 0), y(0, 1, 0), z(0, 0, 1);
+	matrix.rotateVect(x);
+	matrix.rotateVect(y);
+	matrix.rotateVect(z);
+	x.normalize();
+	y.normalize();
+	z.normalize();
+	core::quaternion rotation = quaternionFromAxes(x, y, z);
+	rotation.normalize();
+	return RigidTransform(rotation, matrix.getTranslation());
+}
+
+core::matrix4 DockingSolver::toMatrix(const RigidTransform& transform)
+{
+	core::vector3df x = rotate(transform.rotation, core::vector3df(1, 0, 0));
+	core::vector3df y = rotate(transform.rotation, core::vector3df(0, 1, 0));
+	core::vector3df z = rotate(transform.rotation, core::vector3df(0, 0, 1));
+	core::matrix4 matrix;
+	matrix[0] = x.X; matrix[1] = x.Y; matrix[2] = x.Z;
+	matrix[4] = y.X; matrix[5] = y.Y; matrix[6] = y.Z;
+	matrix[8] = z.X; matrix[9] = z.Y; matrix[10] = z.Z;
+	matrix.setTranslation(transform.position);
+	return matrix;
+}
+
+unsigned int DockingSolver::addVessel(const std::vector<RigidTransform>* frames)
+{
+	portFrames.push_back(frames);
+	edges.push_back(std::vector<DockingSolverEdge>());
+	transforms.push_back(RigidTransform());
+	solved.push_back(0);
+	return portFrames.size() - 1;
+}
+
+void DockingSolver::addDocking(unsigned int vessel, unsigned int port, unsigned int otherVessel, unsigned int otherPort)
+{
+	DockingSolverEdge edge;
+	edge.port = port;
+	edge.otherVessel = otherVessel;
+	edge.otherPort = otherPort;
+	edges[vessel].push_back(edge);
+
+	edge.port = otherPort;
+	edge.otherVessel = vessel;
+	edge.otherPort = port;
+	edges[otherVessel].push_back(edge);
+}
+
+unsigned int DockingSolver::solve(unsigned int root, const RigidTransform& rootTransform)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	transforms[root] = rootTransform;
+	solved[root] = 1;
+	unsigned int placed = 1;
+
+	std::vector<unsigned int> current(1, root);
+	std::vector<FrontierEntry> frontier;
+	while (current.size() > 0)
+	{
+		//collecting the next frontier is cheap, it only has to be careful not to pick up a vessel twice
+		frontier.clear();
+		for (unsigned int i = 0; i < current.size(); ++i)
+		{
+			const std::vector<DockingSolverEdge>& vesselEdges = edges[current[i]];
+			for (unsigned int j = 0; j < vesselEdges.size(); ++j)
+			{
+				if (solved[vesselEdges[j].otherVessel])
+					continue;
+				solved[vesselEdges[j].otherVessel] = 1;
+				FrontierEntry entry;
+				entry.vessel = vesselEdges[j].otherVessel;
+				entry.parent = current[i];
+				entry.edge = vesselEdges[j];
+				frontier.push_back(entry);
+			}
+		}
+
+		//placing the vessels of the frontier only reads the previous one, so they can all go at the same time
+		unsigned int threads = std::min<unsigned int>(std::thread::hardware_concurrency(), frontier.size() / parallelFrontier);
+		if (threads < 2)
+			solveFrontier(frontier, 0, frontier.size());
+		else
+		{
+			std::vector<std::thread> workers;
+			unsigned int chunk = (frontier.size() + threads - 1) / threads;
+			for (unsigned int t = 1; t < threads; ++t)
+				workers.push_back(std::thread(&DockingSolver::solveFrontier, this, std::cref(frontier),
+					t * chunk, std::min<unsigned int>((t + 1) * chunk, frontier.size())));
+			solveFrontier(frontier, 0, chunk);
+			for (unsigned int t = 0; t < workers.size(); ++t)
+				workers[t].join();
+		}
+
+		placed += frontier.size();
+		current.clear();
+		for (unsigned int i = 0; i < frontier.size(); ++i)
+			current.push_back(frontier[i].vessel);
+	}
+
+	Metrics::recordSample("docking_solver.solve_us",
+		std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+	Metrics::recordSample("docking_solver.vessels", placed);
+	return placed;
+}
+
+void DockingSolver::solveFrontier(const std::vector<FrontierEntry>& frontier, unsigned int begin, unsigned int end)
+{
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		const FrontierEntry& entry = frontier[i];
+		transforms[entry.vessel] = snap(transforms[entry.parent],
+			(*portFrames[entry.parent])[entry.edge.port], (*portFrames[entry.vessel])[entry.edge.otherPort]);
+	}
+}
+
+bool DockingSolver::isSolved(unsigned int vessel)
+{
+	return solved[vessel] != 0;
+}
+
+const RigidTransform& DockingSolver::getTransform(unsigned int vessel)
+{
+	return transforms[vessel];
+}
+
+unsigned int DockingSolver::getVesselCount()
+{
+	return portFrames.size();
+}
+
+void DockingSolver::clear()
+{
+	portFrames.clear();
+	edges.clear();
+	transforms.clear();
+	solved.clear();
+}
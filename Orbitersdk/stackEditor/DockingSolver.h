@@ -0,0 +1,78 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+
+using namespace irr;
+
+//position and orientation without scale. the rotation is applied first, then the translation
+struct RigidTransform
+{
+	RigidTransform() : rotation(0, 0, 0, 1) {}
+	RigidTransform(const core::quaternion& rot, const core::vector3df& pos) : rotation(rot), position(pos) {}
+	core::quaternion rotation;
+	core::vector3df position;
+};
+
+//one docking connection inside the solver, seen from vessel
+struct DockingSolverEdge
+{
+	unsigned int port;
+	unsigned int otherVessel;
+	unsigned int otherPort;
+};
+
+//places docked vessels so their ports touch, using nothing but vector and quaternion math.
+//doesn't know about scene nodes at all: vessels are plain indices, each one points at the port frames of its class.
+//the quaternions are plain Hamilton quaternions, composed with multiply(), not with the irrlicht operators.
+//solve() walks breadth first from a root that stays put. every vessel of a frontier only depends on the frontier
+//before it, so big frontiers get spread over a few threads. nothing gets written anywhere, the caller picks up the results
+class DockingSolver
+{
+public:
+	DockingSolver();
+
+	//frame of a docking port relative to its vessel, the same one as OrbiterDockingPort::relativeTransform:
+	//+z points along the approach direction, +y along the reference direction
+	static RigidTransform getPortFrame(const core::vector3df& position, const core::vector3df& approachDirection, const core::vector3df& referenceDirection);
+	//the transformation a vessel needs for ourPort to sit on theirPort, facing it. port frames are relative to their vessels
+	static RigidTransform snap(const RigidTransform& theirVessel, const RigidTransform& theirPort, const RigidTransform& ourPort);
+
+	//a applied after b
+	static core::quaternion multiply(const core::quaternion& a, const core::quaternion& b);
+	static core::quaternion conjugate(const core::quaternion& q);
+	static core::vector3df rotate(const core::quaternion& q, const core::vector3df& v);
+	static RigidTransform combine(const RigidTransform& a, const RigidTransform& b);
+	//conversions from and to the irrlicht matrices. the matrix must not be scaled
+	static RigidTransform fromMatrix(const core::matrix4& matrix);
+	static core::matrix4 toMatrix(const RigidTransform& transform);
+
+	//returns the solver index of the new vessel. portFrames has to stay alive as long as the solver is used
+	unsigned int addVessel(const std::vector<RigidTransform>* portFrames);
+	void addDocking(unsigned int vessel, unsigned int port, unsigned int otherVessel, unsigned int otherPort);
+	//places everything connected to root, starting out from rootTransform. returns the number of vessels placed, root included
+	unsigned int solve(unsigned int root, const RigidTransform& rootTransform);
+	bool isSolved(unsigned int vessel);
+	const RigidTransform& getTransform(unsigned int vessel);
+	unsigned int getVesselCount();
+	void clear();
+
+	static const unsigned int parallelFrontier = 512;		//frontiers smaller than this aren't worth starting threads for
+
+private:
+	//a vessel about to be placed, and the already placed vessel it's docked to
+	struct FrontierEntry
+	{
+		unsigned int vessel;
+		unsigned int parent;
+		DockingSolverEdge edge;				//seen from the parent
+	};
+	void solveFrontier(const std::vector<FrontierEntry>& frontier, unsigned int begin, unsigned int end);
+
+	std::vector<const std::vector<RigidTransform>*> portFrames;
+	std::vector<std::vector<DockingSolverEdge> > edges;
+	std::vector<RigidTransform> transforms;
+	std::vector<unsigned char> solved;
+};
@@ -0,0 +1,113 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "FrameScheduler.h"
+#include "windows.h"
+
+std::atomic<bool> FrameScheduler::dirty(true);
+void* FrameScheduler::wakeEvent = NULL;
+
+static u64 fileTimeToU64(const FILETIME& time)
+{
+	return ((u64)time.dwHighDateTime << 32) | time.dwLowDateTime;
+}
+
+FrameScheduler::FrameScheduler(u32 idleFps)
+	: idleFrameTime(idleFps > 0 ? 10000000 / idleFps : 0), lastFrameTime(0), iterationActive(false),
+	activeCpu(0), activeWall(0), idleCpu(0), idleWall(0), activeFrames(0), idleFrames(0)
+{
+	//auto-reset event, so a single markDirty() wakes the loop exactly once
+	wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	dirty = true;
+	iterationStartCpu = getThreadCpuTime();
+	iterationStartWall = getWallTime();
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	if (wakeEvent)
+	{
+		CloseHandle((HANDLE)wakeEvent);
+		wakeEvent = NULL;
+	}
+}
+
+void FrameScheduler::markDirty()
+{
+	dirty = true;
+	if (wakeEvent)
+		SetEvent((HANDLE)wakeEvent);
+}
+
+bool FrameScheduler::beginIteration()
+{
+	accountIteration();
+
+	u64 now = getWallTime();
+	bool wasDirty = dirty.exchange(false);
+	iterationActive = wasDirty || idleFrameTime == 0;
+	if (iterationActive || now - lastFrameTime >= idleFrameTime)
+	{
+		lastFrameTime = now;
+		if (iterationActive)
+			activeFrames++;
+		else
+			idleFrames++;
+		return true;
+	}
+	return false;
+}
+
+void FrameScheduler::waitForWork()
+{
+	if (idleFrameTime == 0 || dirty)
+		return;
+	u64 now = getWallTime();
+	u64 nextFrame = lastFrameTime + idleFrameTime;
+	if (nextFrame <= now)
+		return;
+	DWORD timeout = (DWORD)((nextFrame - now) / 10000);
+	//returns as soon as there's anything in the message queue for device->run() to process
+	MsgWaitForMultipleObjects(1, (HANDLE*)&wakeEvent, FALSE, timeout, QS_ALLINPUT);
+}
+
+void FrameScheduler::accountIteration()
+{
+	u64 cpu = getThreadCpuTime();
+	u64 wall = getWallTime();
+	if (iterationActive)
+	{
+		activeCpu += cpu - iterationStartCpu;
+		activeWall += wall - iterationStartWall;
+	}
+	else
+	{
+		idleCpu += cpu - iterationStartCpu;
+		idleWall += wall - iterationStartWall;
+	}
+	iterationStartCpu = cpu;
+	iterationStartWall = wall;
+}
+
+void FrameScheduler::logSummary()
+{
+	accountIteration();
+	Log::writeToLog(Log::INFO, "Main loop while active: ", activeFrames, " frames in ", activeWall / 10000000.0, "s, ",
+		activeWall > 0 ? activeCpu * 100.0 / activeWall : 0.0, "% cpu");
+	Log::writeToLog(Log::INFO, "Main loop while idle: ", idleFrames, " frames in ", idleWall / 10000000.0, "s, ",
+		idleWall > 0 ? idleCpu * 100.0 / idleWall : 0.0, "% cpu");
+}
+
+u64 FrameScheduler::getThreadCpuTime()
+{
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+	return fileTimeToU64(kernel) + fileTimeToU64(user);
+}
+
+u64 FrameScheduler::getWallTime()
+{
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return fileTimeToU64(now);
+}
@@ -0,0 +1,49 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <atomic>
+
+#include "Log.h"
+
+using namespace irr;
+
+//decides when the main loop actually has to draw. anything that changes what's on screen marks the frame dirty,
+//otherwise the loop sleeps until a window message arrives or the next idle frame is due.
+//also keeps track of how much cpu time the loop thread uses while drawing on demand and while idling
+class FrameScheduler
+{
+public:
+	//idleFps is the rate at which the scene is still redrawn when nothing changes. 0 redraws every iteration
+	FrameScheduler(u32 idleFps);
+	~FrameScheduler();
+
+	//requests a redraw. safe to call from any thread, wakes up the main loop if it's waiting
+	static void markDirty();
+
+	//returns true if a frame should be drawn this iteration. call once per loop iteration
+	bool beginIteration();
+	//blocks until a window message arrives, markDirty() gets called or the next idle frame is due
+	void waitForWork();
+	//writes the cpu utilization of the loop thread while active and idle to the log
+	void logSummary();
+
+private:
+	void accountIteration();
+	static u64 getThreadCpuTime();				//in 100ns units
+	static u64 getWallTime();					//in 100ns units
+
+	static std::atomic<bool> dirty;
+	static void* wakeEvent;
+
+	u64 idleFrameTime;							//in 100ns units, 0 if idling is switched off
+	u64 lastFrameTime;
+
+	//cpu accounting. an iteration counts as active if it drew because something changed
+	bool iterationActive;
+	u64 iterationStartCpu;
+	u64 iterationStartWall;
+	u64 activeCpu, activeWall, idleCpu, idleWall;
+	u32 activeFrames, idleFrames;
+};
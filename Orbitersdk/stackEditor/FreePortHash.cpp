@@ -0,0 +1,219 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "FreePortHash.h"
+#include "VesselSceneNode.h"
+
+#include <algorithm>
+#include <set>
+#include <cmath>
+#include <cstdlib>
+
+FreePortHash::FreePortHash(f32 _cellSize) : cellSize(_cellSize), portCount(0)
+{}
+
+FreePortHash::CellKey FreePortHash::getCell(const core::vector3df& position)
+{
+	CellKey key;
+	key.x = (int)floor(position.X / cellSize);
+	key.y = (int)floor(position.Y / cellSize);
+	key.z = (int)floor(position.Z / cellSize);
+	return key;
+}
+
+void FreePortHash::updateVessel(VesselSceneNode* vessel)
+{
+	removeVessel(vessel);
+	std::vector<CellKey>& occupiedCells = vesselCells[vessel];
+	for (UINT i = 0; i < vessel->dockingPorts.size(); i++)
+	{
+		if (vessel->dockingPorts[i].docked)
+			continue;
+		Entry entry;
+		entry.port = &vessel->dockingPorts[i];
+		entry.position = vessel->getDockingPortAbsolutePosition(i);
+		entry.distanceSQ = 0;
+		CellKey key = getCell(entry.position);
+		cells[key].push_back(entry);
+		if (std::find(occupiedCells.begin(), occupiedCells.end(), key) == occupiedCells.end())
+			occupiedCells.push_back(key);
+		portCount++;
+	}
+	if (occupiedCells.size() == 0)
+		vesselCells.erase(vessel);
+}
+
+void FreePortHash::removeVessel(VesselSceneNode* vessel)
+{
+	std::map<VesselSceneNode*, std::vector<CellKey> >::iterator pos = vesselCells.find(vessel);
+	if (pos == vesselCells.end())
+		return;
+	for (UINT i = 0; i < pos->second.size(); i++)
+	{
+		auto cell = cells.find(pos->second[i]);
+		if (cell == cells.end())
+			continue;
+		std::vector<Entry>& entries = cell->second;
+		for (UINT j = 0; j < entries.size();)
+		{
+			if (entries[j].port->parent == vessel)
+			{
+				//order inside a cell doesn't matter
+				entries[j] = entries.back();
+				entries.pop_back();
+				portCount--;
+			}
+			else
+				j++;
+		}
+		if (entries.size() == 0)
+			cells.erase(cell);
+	}
+	vesselCells.erase(pos);
+}
+
+void FreePortHash::collectCell(const CellKey& key, const core::vector3df& position,
+	const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<Entry>& candidates)
+{
+	auto cell = cells.find(key);
+	if (cell == cells.end())
+		return;
+	for (UINT i = 0; i < cell->second.size(); i++)
+	{
+		Entry entry = cell->second[i];
+		if (!filter(entry.port))
+			continue;
+		entry.distanceSQ = entry.position.getDistanceFromSQ(position);
+		candidates.push_back(entry);
+	}
+}
+
+//visits the cells around position in growing shells, until the nearest count ports are known to be found.
+//once the shells would contain more cells than actually exist, it just goes through all existing cells
+void FreePortHash::findNearest(const core::vector3df& position, u32 count,
+	const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<OrbiterDockingPort*>& results)
+{
+	results.clear();
+	if (count == 0 || portCount == 0)
+		return;
+
+	std::vector<Entry> candidates;
+	CellKey center = getCell(position);
+	bool fullScan = false;
+	for (int ring = 0;; ring++)
+	{
+		u64 visitedCells = (u64)(2 * ring + 1) * (2 * ring + 1) * (2 * ring + 1);
+		if (visitedCells > cells.size())
+		{
+			fullScan = true;
+			break;
+		}
+		for (int x = -ring; x <= ring; x++)
+		{
+			for (int y = -ring; y <= ring; y++)
+			{
+				for (int z = -ring; z <= ring; z++)
+				{
+					//only the shell, the inside was visited by the previous rings
+					if (abs(x) != ring && abs(y) != ring && abs(z) != ring)
+						continue;
+					CellKey key = { center.x + x, center.y + y, center.z + z };
+					collectCell(key, position, filter, candidates);
+				}
+			}
+		}
+		if (candidates.size() >= count)
+		{
+			//everything outside this shell is at least ring cells away
+			std::nth_element(candidates.begin(), candidates.begin() + (count - 1), candidates.end(),
+				[](const Entry& a, const Entry& b) { return a.distanceSQ < b.distanceSQ; });
+			f32 reach = ring * cellSize;
+			if (candidates[count - 1].distanceSQ <= reach * reach)
+				break;
+		}
+	}
+
+	if (fullScan)
+	{
+		candidates.clear();
+		for (auto cell = cells.begin(); cell != cells.end(); ++cell)
+			collectCell(cell->first, position, filter, candidates);
+	}
+
+	u32 resultCount = std::min(count, (u32)candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end(),
+		[](const Entry& a, const Entry& b) { return a.distanceSQ < b.distanceSQ; });
+	for (u32 i = 0; i < resultCount; i++)
+		results.push_back(candidates[i].port);
+}
+
+//every port only has to be compared with the ports in its own and the neighbouring cells,
+//so this stays linear in the number of free ports as long as they don't all pile up in one place
+void FreePortHash::findCoincidentPairs(f32 maxDistance, const std::function<bool(OrbiterDockingPort*, OrbiterDockingPort*)>& filter,
+	std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> >& pairs)
+{
+	pairs.clear();
+	struct CandidatePair
+	{
+		OrbiterDockingPort* first;
+		OrbiterDockingPort* second;
+		f32 distanceSQ;
+	};
+	std::vector<CandidatePair> candidates;
+	f32 maxDistanceSQ = maxDistance * maxDistance;
+
+	for (auto cell = cells.begin(); cell != cells.end(); ++cell)
+	{
+		const std::vector<Entry>& entries = cell->second;
+		for (int x = -1; x <= 1; x++)
+		{
+			for (int y = -1; y <= 1; y++)
+			{
+				for (int z = -1; z <= 1; z++)
+				{
+					CellKey key = { cell->first.x + x, cell->first.y + y, cell->first.z + z };
+					auto neighbour = cells.find(key);
+					if (neighbour == cells.end())
+						continue;
+					const std::vector<Entry>& others = neighbour->second;
+					for (UINT i = 0; i < entries.size(); i++)
+					{
+						for (UINT j = 0; j < others.size(); j++)
+						{
+							//every pair is seen from both sides, only keep one of them
+							if (entries[i].port >= others[j].port || entries[i].port->parent == others[j].port->parent)
+								continue;
+							f32 distanceSQ = entries[i].position.getDistanceFromSQ(others[j].position);
+							if (distanceSQ > maxDistanceSQ || !filter(entries[i].port, others[j].port))
+								continue;
+							CandidatePair candidate = { entries[i].port, others[j].port, distanceSQ };
+							candidates.push_back(candidate);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//closest pairs first, a port that is already taken can't be used again
+	std::sort(candidates.begin(), candidates.end(),
+		[](const CandidatePair& a, const CandidatePair& b) { return a.distanceSQ < b.distanceSQ; });
+	std::set<OrbiterDockingPort*> usedPorts;
+	for (UINT i = 0; i < candidates.size(); i++)
+	{
+		if (usedPorts.count(candidates[i].first) || usedPorts.count(candidates[i].second))
+			continue;
+		usedPorts.insert(candidates[i].first);
+		usedPorts.insert(candidates[i].second);
+		pairs.push_back(std::make_pair(candidates[i].first, candidates[i].second));
+	}
+}
+
+f32 FreePortHash::getCellSize()
+{
+	return cellSize;
+}
+
+u32 FreePortHash::getPortCount()
+{
+	return portCount;
+}
@@ -0,0 +1,69 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+
+using namespace irr;
+
+class VesselSceneNode;
+struct OrbiterDockingPort;
+
+//world space grid of all docking ports that are not docked, used to find snapping candidates
+//without going through every port of every vessel.
+//only cells that contain ports exist, so far apart vessels cost nothing
+class FreePortHash
+{
+public:
+	FreePortHash(f32 cellSize = 20.0f);
+
+	//removes the old entries of the vessel and inserts its free ports at their current absolute positions.
+	//call whenever the vessel moved or one of its ports got docked or undocked
+	void updateVessel(VesselSceneNode* vessel);
+	void removeVessel(VesselSceneNode* vessel);
+
+	//fills results with up to count ports accepted by filter, closest to position first
+	void findNearest(const core::vector3df& position, u32 count,
+		const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<OrbiterDockingPort*>& results);
+
+	//fills pairs with free ports of different vessels that sit within maxDistance of each other and are accepted by filter.
+	//every port ends up in at most one pair, the closest one. maxDistance must not be larger than the cell size
+	void findCoincidentPairs(f32 maxDistance, const std::function<bool(OrbiterDockingPort*, OrbiterDockingPort*)>& filter,
+		std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> >& pairs);
+
+	u32 getPortCount();
+	f32 getCellSize();
+
+private:
+	struct Entry
+	{
+		OrbiterDockingPort* port;
+		core::vector3df position;
+		f32 distanceSQ;				//scratch value for queries
+	};
+	struct CellKey
+	{
+		int x, y, z;
+		bool operator==(const CellKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+	struct CellKeyHash
+	{
+		size_t operator()(const CellKey& key) const
+		{
+			return (size_t)(key.x * 73856093) ^ (size_t)(key.y * 19349663) ^ (size_t)(key.z * 83492791);
+		}
+	};
+
+	CellKey getCell(const core::vector3df& position);
+	void collectCell(const CellKey& key, const core::vector3df& position,
+		const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<Entry>& candidates);
+
+	f32 cellSize;
+	u32 portCount;
+	std::unordered_map<CellKey, std::vector<Entry>, CellKeyHash> cells;
+	std::map<VesselSceneNode*, std::vector<CellKey> > vesselCells;		//cells each vessel has ports in
+};
@@ -1,13 +1,14 @@
 //Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
 //The MIT License - See ../../LICENSE for more info
 #include "Helpers.h"
+#include <stdexcept>
 
-std::map<unsigned int, VesselSceneNode*>* Helpers::vesselMap = 0;
+VesselRegistry* Helpers::vesselMap = 0;
 
 std::string Helpers::workingDirectory = "";
 StackEditor* Helpers::mainStackEditor = 0;
 IrrlichtDevice *Helpers::irrdevice = NULL;
-std::mutex Helpers::videoDriverMutex;
+ProfiledMutex Helpers::videoDriverMutex("videoDriverMutex");
 bool Helpers::readLine(ifstream& file, std::vector<std::string>& tokens, const std::string &delimiters)
 {
 	std::string line;
@@ -58,7 +59,7 @@ double Helpers::stringToDouble(const std::string& inputString)
 video::ITexture* Helpers::readDDS(std::string path, std::string name, video::IVideoDriver* driver)
 {
 
-	videoDriverMutex.lock();
+	videoDriverMutex.lock(__FUNCTION__);
 	//get the DDS
 	irrutils::DdsImage ddsImage = irrutils::DdsImage(path.c_str(), driver);
 	video::IImage* image = ddsImage.getImage();
@@ -97,6 +98,13 @@ CONFIGPARAMS Helpers::loadConfigParams()
 	CONFIGPARAMS params;
 	params.windowres = core::dimension2d<u32>(0, 0);
 	params.toolboxset = "default";
+	params.staticbake = false;
+	params.occlusionculling = false;
+	params.idlefps = 10;
+	params.autodocktolerance = 0.01f;
+	params.undodepth = 1000;
+	params.undomemory = 64;
+	params.binarysessions = false;
 	std::string cfgPath("./StackEditor/StackEditor.cfg");
 	ifstream configFile = ifstream(cfgPath.c_str());
 
@@ -133,6 +141,47 @@ CONFIGPARAMS Helpers::loadConfigParams()
 				}
 			}
 
+			if (tokens[0].compare("staticbake") == 0 && tokens.size() >= 2)
+			{
+				std::string value = tokens[1];
+				std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+				params.staticbake = value.compare("true") == 0 || value.compare("1") == 0;
+			}
+
+			if (tokens[0].compare("occlusionculling") == 0 && tokens.size() >= 2)
+			{
+				std::string value = tokens[1];
+				std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+				params.occlusionculling = value.compare("true") == 0 || value.compare("1") == 0;
+			}
+
+			if (tokens[0].compare("idlefps") == 0 && tokens.size() >= 2)
+			{
+				params.idlefps = (unsigned int)std::max(0, Helpers::stringToInt(tokens[1]));
+			}
+
+			if (tokens[0].compare("autodocktolerance") == 0 && tokens.size() >= 2)
+			{
+				params.autodocktolerance = (float)std::max(0.0, Helpers::stringToDouble(tokens[1]));
+			}
+
+			if (tokens[0].compare("undodepth") == 0 && tokens.size() >= 2)
+			{
+				params.undodepth = (unsigned int)std::max(0, Helpers::stringToInt(tokens[1]));
+			}
+
+			if (tokens[0].compare("undomemory") == 0 && tokens.size() >= 2)
+			{
+				params.undomemory = (unsigned int)std::max(0, Helpers::stringToInt(tokens[1]));
+			}
+
+			if (tokens[0].compare("sessionformat") == 0 && tokens.size() >= 2)
+			{
+				std::string value = tokens[1];
+				std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+				params.binarysessions = value.compare("binary") == 0;
+			}
+
             if (tokens[0].compare("loglevel") == 0)
             {
                 if (tokens.size() < 2)
@@ -194,7 +243,7 @@ void Helpers::slashreplace(std::string &str)
 	str += tokens[tokens.size() - 1];
 }
 
-void Helpers::setVesselMap(std::map<unsigned int, VesselSceneNode*>* _vesselMap)
+void Helpers::setVesselMap(VesselRegistry* _vesselMap)
 {
     vesselMap = _vesselMap;
 }
@@ -203,7 +252,7 @@ void Helpers::registerVessel(unsigned int uid, VesselSceneNode* vessel)
 {
     if (vesselMap != 0)
     {
-        (*vesselMap)[uid] = vessel;
+        vesselMap->add(uid, vessel);
     }
 }
 
@@ -211,7 +260,7 @@ void Helpers::unregisterVessel(unsigned int uid)
 {
     if (vesselMap != 0)
     {
-        vesselMap->erase(uid);
+        vesselMap->remove(uid);
     }
 }
 
@@ -219,7 +268,11 @@ VesselSceneNode* Helpers::getVesselByUID(unsigned int uid)
 {
     if (vesselMap != 0)
     {
-        return vesselMap->at(uid);
+        VesselSceneNode* vessel = vesselMap->get(uid);
+        //same as the map lookup this replaced, undo and redo rely on the exception
+        if (vessel == 0)
+            throw std::out_of_range("no vessel with this uid");
+        return vessel;
     }
     return 0;
 }
@@ -228,14 +281,34 @@ bool Helpers::isUIDRegistered(unsigned int uid)
 {
     if (vesselMap != 0)
     {
-        return vesselMap->count(uid) != 0;
+        return vesselMap->contains(uid);
     }
     return false;
 }
 
 unsigned int Helpers::findFreeUID(unsigned int startNum)
 {
-    while (isUIDRegistered(startNum))
-        ++startNum;
+    if (vesselMap != 0)
+    {
+        return vesselMap->findFreeUID(startNum);
+    }
     return startNum;
 }
+
+VesselHandle Helpers::getVesselHandle(unsigned int uid)
+{
+    if (vesselMap != 0)
+    {
+        return vesselMap->getHandle(uid);
+    }
+    return VesselHandle();
+}
+
+VesselSceneNode* Helpers::getVesselByHandle(const VesselHandle& handle)
+{
+    if (vesselMap != 0)
+    {
+        return vesselMap->get(handle);
+    }
+    return 0;
+}
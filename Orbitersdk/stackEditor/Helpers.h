@@ -11,6 +11,7 @@
 #include <vector>
 #include <map>
 #include <mutex>
+#include "ProfiledMutex.h"
 #include <algorithm>
 #include <irrlicht.h>
 #include <sstream>
@@ -18,6 +19,7 @@
 #include "Version.h"
 #include "DdsImage.h"
 #include "Common.h"
+#include "VesselRegistry.h"
 
 
 //using namespace std;
@@ -30,6 +32,13 @@ struct CONFIGPARAMS
 {
 	std::string toolboxset;
 	core::dimension2d<u32> windowres;
+	bool staticbake;
+	bool occlusionculling;
+	unsigned int idlefps;
+	float autodocktolerance;
+	unsigned int undodepth;
+	unsigned int undomemory;		//in megabytes
+	bool binarysessions;			//save sessions as VERSION 2 instead of text, off unless sessionformat = binary
 };
 
 class Helpers
@@ -45,7 +54,7 @@ public:
 	static video::ITexture* readDDS(std::string path, std::string name, video::IVideoDriver* driver);
 	static bool BothAreSpaces(char lhs, char rhs) { return (lhs == rhs) && (lhs == ' '); }
 	static void removeExtraSpaces(std::string& str);
-	static std::mutex videoDriverMutex;
+	static ProfiledMutex videoDriverMutex;
 //	static double min(double v1, double v2);
 //	static double max(double v1, double v2);
 	static std::string meshNameToImageName(std::string meshname);
@@ -53,13 +62,16 @@ public:
 	static CONFIGPARAMS loadConfigParams();
 	static void resetDirectory();
 
-    static void setVesselMap(std::map<unsigned int, VesselSceneNode*>* _vesselMap);
+    static void setVesselMap(VesselRegistry* _vesselMap);
     static void registerVessel(unsigned int uid, VesselSceneNode* vessel);
     static void unregisterVessel(unsigned int uid);
     static VesselSceneNode* getVesselByUID(unsigned int uid);
     static bool isUIDRegistered(unsigned int uid);
     static unsigned int findFreeUID(unsigned int startNum);
+    //handles stay valid across frames only as long as the vessel they were taken from exists, returns 0 afterwards
+    static VesselHandle getVesselHandle(unsigned int uid);
+    static VesselSceneNode* getVesselByHandle(const VesselHandle& handle);
 
 private:
-    static std::map<unsigned int, VesselSceneNode*>* vesselMap;
+    static VesselRegistry* vesselMap;
 };
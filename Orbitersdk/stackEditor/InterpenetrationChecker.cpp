@@ -0,0 +1,190 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "InterpenetrationChecker.h"
+#include "VesselSceneNode.h"
+#include "Metrics.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+
+static bool pairOrder(const VesselPair& a, const VesselPair& b)
+{
+	return a.first.uid != b.first.uid ? a.first.uid < b.first.uid : a.second.uid < b.second.uid;
+}
+
+InterpenetrationChecker::InterpenetrationChecker(scene::ISceneManager* mgr)
+	: smgr(mgr), requestedInternal(false), requestPending(false), running(false), reportPass(false), nextPair(0), currentQuery(0)
+{}
+
+InterpenetrationChecker::~InterpenetrationChecker()
+{
+	delete currentQuery;
+}
+
+void InterpenetrationChecker::start(const std::vector<VesselSceneNode*>& vessels, bool includeInternal)
+{
+	requestedVessels.clear();
+	for (UINT i = 0; i < vessels.size(); i++)
+		requestedVessels.push_back(Helpers::getVesselHandle(vessels[i]->getUID()));
+	requestedInternal = includeInternal;
+	requestPending = true;
+	if (!running)
+		beginPass();
+}
+
+void InterpenetrationChecker::clear()
+{
+	delete currentQuery;
+	currentQuery = 0;
+	running = false;
+	requestPending = false;
+	pendingPairs.clear();
+	foundPairs.clear();
+	overlappingPairs.clear();
+}
+
+bool InterpenetrationChecker::isRunning()
+{
+	return running;
+}
+
+const std::vector<VesselPair>& InterpenetrationChecker::getOverlappingPairs()
+{
+	return overlappingPairs;
+}
+
+//broad phase. collects all pairs of vessels whose boxes overlap, only the triangle tests are spread over frames
+void InterpenetrationChecker::beginPass()
+{
+	//vessels deleted since the request are left out
+	std::vector<VesselSceneNode*> checkedVessels;
+	std::vector<unsigned int> checkedUIDs;
+	for (UINT i = 0; i < requestedVessels.size(); i++)
+	{
+		VesselSceneNode* vessel = Helpers::getVesselByHandle(requestedVessels[i]);
+		if (vessel == 0)
+			continue;
+		checkedVessels.push_back(vessel);
+		checkedUIDs.push_back(vessel->getUID());
+	}
+	std::sort(checkedUIDs.begin(), checkedUIDs.end());
+	//checks including the internal pairs are the ones the user asked for
+	reportPass = requestedInternal;
+	requestPending = false;
+	running = true;
+	pendingPairs.clear();
+	foundPairs.clear();
+	nextPair = 0;
+
+	ScenePickingTree* tree = ScenePickingTree::getTree(smgr);
+	std::vector<VesselSceneNode*> neighbours;
+	for (UINT i = 0; i < checkedVessels.size(); i++)
+	{
+		VesselSceneNode* vessel = checkedVessels[i];
+		tree->queryVessels(vessel->getTransformedBoundingBox(), neighbours);
+		for (UINT j = 0; j < neighbours.size(); j++)
+		{
+			unsigned int otherUID = neighbours[j]->getUID();
+			if (otherUID == vessel->getUID())
+				continue;
+			bool otherChecked = std::binary_search(checkedUIDs.begin(), checkedUIDs.end(), otherUID);
+			//vessels moving together can't get into each other
+			if (otherChecked && !requestedInternal)
+				continue;
+			//pairs of two checked vessels are found from both sides
+			if (otherChecked && otherUID < vessel->getUID())
+				continue;
+			VesselPair pair;
+			pair.first = Helpers::getVesselHandle(std::min(vessel->getUID(), otherUID));
+			pair.second = Helpers::getVesselHandle(std::max(vessel->getUID(), otherUID));
+			pendingPairs.push_back(pair);
+		}
+	}
+	Metrics::setGauge("interpenetration.candidate_pairs", (double)pendingPairs.size());
+}
+
+void InterpenetrationChecker::finishPass()
+{
+	running = false;
+	std::sort(foundPairs.begin(), foundPairs.end(), pairOrder);
+	if (reportPass)
+	{
+		Log::writeToLog(Log::INFO, "Interpenetration check found ", foundPairs.size(), " overlapping vessel pairs");
+		for (UINT i = 0; i < foundPairs.size(); i++)
+			Log::writeToLog(Log::INFO, "Vessel ", foundPairs[i].first.uid, " overlaps vessel ", foundPairs[i].second.uid);
+	}
+	overlappingPairs = foundPairs;
+	Metrics::setGauge("interpenetration.overlapping_pairs", (double)overlappingPairs.size());
+	if (requestPending)
+		beginPass();
+}
+
+//continues the triangle test of the current pair. returns true once the pair is done
+bool InterpenetrationChecker::testNextPair()
+{
+	const VesselPair& pair = pendingPairs[nextPair];
+	if (currentQuery == 0)
+	{
+		//one of them may have been deleted since the pass began
+		VesselSceneNode* a = Helpers::getVesselByHandle(pair.first);
+		VesselSceneNode* b = Helpers::getVesselByHandle(pair.second);
+		if (a == 0 || b == 0)
+			return true;
+		MeshBVH* treeA = a->returnVesselData()->vesselMesh->getPickingBVH();
+		MeshBVH* treeB = b->returnVesselData()->vesselMesh->getPickingBVH();
+		if (treeA == 0 || treeB == 0)
+			return true;
+		core::matrix4 bToA = core::matrix4(a->getAbsoluteTransformation(), core::matrix4::EM4CONST_INVERSE) * b->getAbsoluteTransformation();
+		currentQuery = new MeshBVHOverlapQuery(treeA, treeB, bToA);
+	}
+	if (!currentQuery->step(nodePairsPerStep))
+		return false;
+	if (currentQuery->intersects())
+		foundPairs.push_back(pair);
+	delete currentQuery;
+	currentQuery = 0;
+	return true;
+}
+
+bool InterpenetrationChecker::update(double budgetMicroseconds)
+{
+	if (!running)
+		return false;
+	std::chrono::high_resolution_clock::time_point updateStart = std::chrono::high_resolution_clock::now();
+	double elapsed = 0;
+	while (nextPair < pendingPairs.size() && elapsed < budgetMicroseconds)
+	{
+		if (testNextPair())
+			nextPair++;
+		elapsed = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - updateStart).count();
+	}
+	Metrics::recordSample("interpenetration.update_us", elapsed);
+
+	if (nextPair < pendingPairs.size())
+		return false;
+	std::vector<VesselPair> previousPairs = overlappingPairs;
+	finishPass();
+	return !(previousPairs == overlappingPairs);
+}
+
+void InterpenetrationChecker::draw(video::IVideoDriver* driver)
+{
+	if (overlappingPairs.size() == 0)
+		return;
+	video::SMaterial material;
+	material.Lighting = false;
+	material.ZBuffer = video::ECFN_ALWAYS;			//the overlap is hidden inside the meshes, draw on top of them
+	driver->setMaterial(material);
+	driver->setTransform(video::ETS_WORLD, core::IdentityMatrix);
+	for (UINT i = 0; i < overlappingPairs.size(); i++)
+	{
+		VesselSceneNode* a = Helpers::getVesselByHandle(overlappingPairs[i].first);
+		VesselSceneNode* b = Helpers::getVesselByHandle(overlappingPairs[i].second);
+		if (a == 0 || b == 0)
+			continue;
+		driver->draw3DBox(a->getTransformedBoundingBox(), video::SColor(255, 255, 40, 40));
+		driver->draw3DBox(b->getTransformedBoundingBox(), video::SColor(255, 255, 40, 40));
+		driver->draw3DLine(a->getAbsolutePosition(), b->getAbsolutePosition(), video::SColor(255, 255, 160, 0));
+	}
+}
@@ -0,0 +1,73 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+
+#include "MeshBVH.h"
+#include "VesselRegistry.h"
+
+using namespace irr;
+
+class VesselSceneNode;
+
+//two vessels, by handle so the pair survives one of them being deleted, and doesn't pick up a new vessel
+//that gets its uid afterwards. first is always the one with the smaller uid
+struct VesselPair
+{
+	VesselHandle first, second;
+	bool operator==(const VesselPair& other) const
+	{
+		return first.uid == other.first.uid && first.generation == other.first.generation &&
+			second.uid == other.second.uid && second.generation == other.second.generation;
+	}
+};
+
+//finds vessels whose meshes intersect each other. the picking tree finds vessels with overlapping boxes,
+//then the triangle trees of their meshes are tested against each other.
+//the work is spread over frames and limited to a time budget per frame, so checking a big station doesn't stall the editor
+class InterpenetrationChecker
+{
+public:
+	InterpenetrationChecker(scene::ISceneManager* mgr);
+	~InterpenetrationChecker();
+
+	//checks the passed vessels against every other vessel near them. if includeInternal is true,
+	//the passed vessels are checked against each other as well. if a check is still running,
+	//the new one starts as soon as it is done, so the highlights keep up while dragging
+	void start(const std::vector<VesselSceneNode*>& vessels, bool includeInternal);
+	//continues the running check for about budgetMicroseconds. returns true if the highlighted pairs changed
+	bool update(double budgetMicroseconds);
+	//stops checking and removes all highlights
+	void clear();
+	bool isRunning();
+
+	//draws the boxes of all overlapping pairs, call between drawAll and endScene
+	void draw(video::IVideoDriver* driver);
+	const std::vector<VesselPair>& getOverlappingPairs();
+
+	static const u32 nodePairsPerStep = 256;		//tree node pairs tested between two looks at the clock
+
+private:
+	void beginPass();
+	void finishPass();
+	bool testNextPair();
+
+	scene::ISceneManager* smgr;
+
+	//requested check, copied into the pass when it begins
+	std::vector<VesselHandle> requestedVessels;
+	bool requestedInternal;
+	bool requestPending;
+
+	//running pass
+	bool running;
+	bool reportPass;								//log the result, for checks the user asked for
+	std::vector<VesselPair> pendingPairs;			//vessels with overlapping boxes, waiting for the triangle test
+	unsigned int nextPair;
+	MeshBVHOverlapQuery* currentQuery;
+	std::vector<VesselPair> foundPairs;
+
+	std::vector<VesselPair> overlappingPairs;		//result of the last finished pass, these get highlighted
+};
@@ -2,7 +2,7 @@
 //The MIT License - See ../../LICENSE for more info
 #include "Log.h"
 
-std::mutex Log::writeMutex;
+ProfiledMutex Log::writeMutex("Log::writeMutex");
 
 Log::LogLevel Log::logLevel = Log::LogLevel::WARN;
 const char *  Log::levelStrings[] = { "[ALL]", "[DEBUG]", "[INFO]", "[WARN]", "[ERROR]", "[FATAL]", "[OFF]" };
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <mutex>
+#include "ProfiledMutex.h"
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -23,7 +24,7 @@ public:
     template<typename ... Types>
     static void writeToLog(Types ... rest)
     {
-        writeMutex.lock();
+        writeMutex.lock("Log::writeToLog");
         writeToLogThreadUnsafe(rest...);
         writeMutex.unlock();
     }
@@ -57,7 +58,7 @@ public:
 
     static void writeVectorToLog(const std::string& vectorName, irr::core::vector3df vec, LogLevel messageLevel);
 private:
-    static std::mutex writeMutex;
+    static ProfiledMutex writeMutex;
     static const char* levelStrings[];
     static bool shouldLog(LogLevel level);
     static LogLevel logLevel;
@@ -0,0 +1,387 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "MeshBVH.h"
+#include "OrbiterMesh.h"
+#include "Metrics.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+
+static f32 boxArea(const core::aabbox3d<f32>& box)
+{
+	core::vector3df extent = box.getExtent();
+	return 2.0f * (extent.X * extent.Y + extent.Y * extent.Z + extent.Z * extent.X);
+}
+
+static f32 axisValue(const core::vector3df& vec, int axis)
+{
+	return axis == 0 ? vec.X : (axis == 1 ? vec.Y : vec.Z);
+}
+
+MeshBVH::MeshBVH() : depth(0)
+{}
+
+void MeshBVH::build(OrbiterMesh* mesh)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	nodes.clear();
+	triangles.clear();
+	sourceTriangles.clear();
+	depth = 0;
+
+	//collect the triangles of all groups. groups with more than 65536 vertices use 32 bit indices
+	for (UINT i = 0; i < mesh->meshGroups.size(); i++)
+	{
+		const scene::IMeshBuffer* buffer = mesh->meshGroups[i].meshBuffer;
+		if (buffer == 0 || buffer->getVertexType() != video::EVT_STANDARD)
+			continue;
+		const video::S3DVertex* vertices = (const video::S3DVertex*)buffer->getVertices();
+		const u16* smallIndices = buffer->getIndexType() == video::EIT_16BIT ? buffer->getIndices() : 0;
+		const u32* largeIndices = buffer->getIndexType() == video::EIT_32BIT ? (const u32*)buffer->getIndices() : 0;
+		for (u32 j = 0; j + 2 < buffer->getIndexCount(); j += 3)
+		{
+			u32 a = smallIndices ? smallIndices[j] : largeIndices[j];
+			u32 b = smallIndices ? smallIndices[j + 1] : largeIndices[j + 1];
+			u32 c = smallIndices ? smallIndices[j + 2] : largeIndices[j + 2];
+			MeshBVHTriangle triangle;
+			triangle.v0 = vertices[a].Pos;
+			triangle.edge1 = vertices[b].Pos - vertices[a].Pos;
+			triangle.edge2 = vertices[c].Pos - vertices[a].Pos;
+			sourceTriangles.push_back(triangle);
+		}
+	}
+
+	std::vector<BuildTriangle> buildTriangles(sourceTriangles.size());
+	for (u32 i = 0; i < sourceTriangles.size(); i++)
+	{
+		const MeshBVHTriangle& triangle = sourceTriangles[i];
+		buildTriangles[i].box.reset(triangle.v0);
+		buildTriangles[i].box.addInternalPoint(triangle.v0 + triangle.edge1);
+		buildTriangles[i].box.addInternalPoint(triangle.v0 + triangle.edge2);
+		buildTriangles[i].centroid = buildTriangles[i].box.getCenter();
+		buildTriangles[i].index = i;
+	}
+
+	if (buildTriangles.size() > 0)
+	{
+		//a binary tree with at least one triangle per leaf never has more than 2n - 1 nodes
+		nodes.reserve(buildTriangles.size() * 2);
+		triangles.reserve(buildTriangles.size());
+		buildNode(buildTriangles, 0, buildTriangles.size(), 0);
+	}
+	std::vector<MeshBVHTriangle>().swap(sourceTriangles);
+	//reserve was generous, give back what we don't use
+	std::vector<MeshBVHNode>(nodes).swap(nodes);
+
+	double buildMicroseconds = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::high_resolution_clock::now() - startTime).count();
+	Metrics::recordSample("picking.bvh_build_us", buildMicroseconds);
+	Metrics::recordSample("picking.bvh_bytes", getMemorySize());
+	Metrics::addToGauge("picking.bvh_total_bytes", getMemorySize());
+	Log::writeToLog(Log::INFO, "Built picking BVH: ", triangles.size(), " triangles, ", nodes.size(), " nodes, ",
+		getMemorySize(), " bytes in ", buildMicroseconds, " us");
+}
+
+//recursively builds the subtree over buildTriangles[first, first + count) and returns its node index
+u32 MeshBVH::buildNode(std::vector<BuildTriangle>& buildTriangles, u32 first, u32 count, u32 level)
+{
+	u32 nodeIndex = nodes.size();
+	nodes.push_back(MeshBVHNode());
+	depth = std::max(depth, level);
+
+	core::aabbox3d<f32> box = buildTriangles[first].box;
+	core::aabbox3d<f32> centroidBox(buildTriangles[first].centroid);
+	for (u32 i = first + 1; i < first + count; i++)
+	{
+		box.addInternalBox(buildTriangles[i].box);
+		centroidBox.addInternalPoint(buildTriangles[i].centroid);
+	}
+	nodes[nodeIndex].boxMin = box.MinEdge;
+	nodes[nodeIndex].boxMax = box.MaxEdge;
+
+	//split along the axis the centroids spread out the most
+	core::vector3df centroidExtent = centroidBox.getExtent();
+	int axis = 0;
+	if (centroidExtent.Y > centroidExtent.X)
+		axis = 1;
+	if (centroidExtent.Z > axisValue(centroidExtent, axis))
+		axis = 2;
+	f32 axisMin = axisValue(centroidBox.MinEdge, axis);
+	f32 axisExtent = axisValue(centroidExtent, axis);
+
+	int bestSplit = -1;
+	if (count > maxLeafTriangles && axisExtent > 0)
+	{
+		//sort the triangles into bins by centroid and evaluate the cost of splitting after every bin
+		core::aabbox3d<f32> binBoxes[binCount];
+		u32 binCounts[binCount] = { 0 };
+		f32 binScale = binCount / axisExtent;
+		for (u32 i = first; i < first + count; i++)
+		{
+			u32 bin = std::min(binCount - 1, (u32)((axisValue(buildTriangles[i].centroid, axis) - axisMin) * binScale));
+			if (binCounts[bin] == 0)
+				binBoxes[bin] = buildTriangles[i].box;
+			else
+				binBoxes[bin].addInternalBox(buildTriangles[i].box);
+			binCounts[bin]++;
+		}
+
+		//area and count of everything right of each split, sweeping from the right
+		f32 rightAreas[binCount];
+		u32 rightCounts[binCount];
+		core::aabbox3d<f32> sweepBox;
+		u32 sweepCount = 0;
+		for (int i = binCount - 1; i > 0; i--)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (sweepCount == 0)
+					sweepBox = binBoxes[i];
+				else
+					sweepBox.addInternalBox(binBoxes[i]);
+				sweepCount += binCounts[i];
+			}
+			rightAreas[i] = sweepCount > 0 ? boxArea(sweepBox) : 0;
+			rightCounts[i] = sweepCount;
+		}
+
+		//leaf cost is one triangle test per triangle, traversal is assumed to cost about the same
+		f32 bestCost = count * boxArea(box);
+		sweepCount = 0;
+		for (u32 i = 0; i + 1 < binCount; i++)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (sweepCount == 0)
+					sweepBox = binBoxes[i];
+				else
+					sweepBox.addInternalBox(binBoxes[i]);
+				sweepCount += binCounts[i];
+			}
+			if (sweepCount == 0 || rightCounts[i + 1] == 0)
+				continue;
+			f32 cost = boxArea(box) + sweepCount * boxArea(sweepBox) + rightCounts[i + 1] * rightAreas[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+	}
+
+	if (bestSplit == -1)
+	//not worth splitting, make a leaf
+	{
+		nodes[nodeIndex].offset = triangles.size();
+		nodes[nodeIndex].triangleCount = count;
+		for (u32 i = first; i < first + count; i++)
+			triangles.push_back(sourceTriangles[buildTriangles[i].index]);
+		return nodeIndex;
+	}
+
+	f32 splitPosition = axisMin + (bestSplit + 1) / (f32)binCount * axisExtent;
+	BuildTriangle* middle = std::partition(&buildTriangles[first], &buildTriangles[first] + count,
+		[&](const BuildTriangle& triangle) { return axisValue(triangle.centroid, axis) < splitPosition; });
+	u32 leftCount = middle - &buildTriangles[first];
+	//rounding can put everything on one side, fall back to a median split
+	if (leftCount == 0 || leftCount == count)
+		leftCount = count / 2;
+
+	buildNode(buildTriangles, first, leftCount, level + 1);
+	u32 rightChild = buildNode(buildTriangles, first + leftCount, count - leftCount, level + 1);
+	nodes[nodeIndex].offset = rightChild;
+	nodes[nodeIndex].triangleCount = 0;
+	return nodeIndex;
+}
+
+bool MeshBVH::intersectBox(const MeshBVHNode& node, const core::vector3df& start, const core::vector3df& inverseDirection, f32 maxT)
+{
+	f32 tx1 = (node.boxMin.X - start.X) * inverseDirection.X;
+	f32 tx2 = (node.boxMax.X - start.X) * inverseDirection.X;
+	f32 tMin = std::min(tx1, tx2);
+	f32 tMax = std::max(tx1, tx2);
+	f32 ty1 = (node.boxMin.Y - start.Y) * inverseDirection.Y;
+	f32 ty2 = (node.boxMax.Y - start.Y) * inverseDirection.Y;
+	tMin = std::max(tMin, std::min(ty1, ty2));
+	tMax = std::min(tMax, std::max(ty1, ty2));
+	f32 tz1 = (node.boxMin.Z - start.Z) * inverseDirection.Z;
+	f32 tz2 = (node.boxMax.Z - start.Z) * inverseDirection.Z;
+	tMin = std::max(tMin, std::min(tz1, tz2));
+	tMax = std::min(tMax, std::max(tz1, tz2));
+	return tMax >= std::max(tMin, 0.0f) && tMin <= maxT;
+}
+
+bool MeshBVH::intersectRay(const core::vector3df& start, const core::vector3df& direction, f32 maxT, f32& hitT) const
+{
+	if (nodes.size() == 0)
+		return false;
+	//a zero component gives an infinite inverse, which the slab test handles correctly
+	core::vector3df inverseDirection(
+		direction.X != 0 ? 1.0f / direction.X : FLT_MAX,
+		direction.Y != 0 ? 1.0f / direction.Y : FLT_MAX,
+		direction.Z != 0 ? 1.0f / direction.Z : FLT_MAX);
+
+	bool hit = false;
+	//the binned splits don't limit how deep the tree gets, but going down one level leaves
+	//at most one node behind on the stack, so it never holds more than depth + 1 nodes
+	std::vector<u32> stack;
+	stack.reserve(depth + 1);
+	stack.push_back(0);
+	while (stack.size() > 0)
+	{
+		const MeshBVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!intersectBox(node, start, inverseDirection, maxT))
+			continue;
+		if (node.triangleCount == 0)
+		{
+			//both children are visited, the left child sits directly after its parent
+			stack.push_back(node.offset);
+			stack.push_back(&node - &nodes[0] + 1);
+			continue;
+		}
+		for (u32 i = node.offset; i < node.offset + node.triangleCount; i++)
+		{
+			//moeller-trumbore, both sides of the triangle count
+			const MeshBVHTriangle& triangle = triangles[i];
+			core::vector3df p = direction.crossProduct(triangle.edge2);
+			f32 determinant = triangle.edge1.dotProduct(p);
+			if (fabs(determinant) < 1e-12f)
+				continue;
+			f32 inverseDeterminant = 1.0f / determinant;
+			core::vector3df s = start - triangle.v0;
+			f32 u = s.dotProduct(p) * inverseDeterminant;
+			if (u < 0 || u > 1)
+				continue;
+			core::vector3df q = s.crossProduct(triangle.edge1);
+			f32 v = direction.dotProduct(q) * inverseDeterminant;
+			if (v < 0 || u + v > 1)
+				continue;
+			f32 t = triangle.edge2.dotProduct(q) * inverseDeterminant;
+			if (t >= 0 && t <= maxT)
+			{
+				maxT = t;
+				hitT = t;
+				hit = true;
+			}
+		}
+	}
+	return hit;
+}
+
+u32 MeshBVH::getMemorySize() const
+{
+	return nodes.capacity() * sizeof(MeshBVHNode) + triangles.capacity() * sizeof(MeshBVHTriangle);
+}
+
+u32 MeshBVH::getTriangleCount() const
+{
+	return triangles.size();
+}
+
+MeshBVHOverlapQuery::MeshBVHOverlapQuery(const MeshBVH* a, const MeshBVH* b, const core::matrix4& _bToA)
+	: treeA(a), treeB(b), bToA(_bToA), hit(false)
+{
+	if (treeA->nodes.size() > 0 && treeB->nodes.size() > 0)
+		stack.push_back(std::make_pair(0u, 0u));
+}
+
+bool MeshBVHOverlapQuery::step(u32 maxNodePairs)
+{
+	for (u32 tested = 0; tested < maxNodePairs && stack.size() > 0 && !hit; tested++)
+	{
+		u32 indexA = stack.back().first;
+		u32 indexB = stack.back().second;
+		stack.pop_back();
+		const MeshBVHNode& nodeA = treeA->nodes[indexA];
+		const MeshBVHNode& nodeB = treeB->nodes[indexB];
+
+		//the box of b gets bigger in a's coordinates, but it still contains everything below it
+		core::aabbox3d<f32> boxB(nodeB.boxMin, nodeB.boxMax);
+		bToA.transformBoxEx(boxB);
+		if (!boxB.intersectsWithBox(core::aabbox3d<f32>(nodeA.boxMin, nodeA.boxMax)))
+			continue;
+
+		if (nodeA.triangleCount > 0 && nodeB.triangleCount > 0)
+		{
+			for (u32 j = nodeB.offset; j < nodeB.offset + nodeB.triangleCount && !hit; j++)
+			{
+				//bring the triangle of b over once, then test it against all triangles of a
+				MeshBVHTriangle triangleB;
+				triangleB.v0 = treeB->triangles[j].v0;
+				bToA.transformVect(triangleB.v0);
+				triangleB.edge1 = treeB->triangles[j].edge1;
+				triangleB.edge2 = treeB->triangles[j].edge2;
+				bToA.rotateVect(triangleB.edge1);
+				bToA.rotateVect(triangleB.edge2);
+				for (u32 i = nodeA.offset; i < nodeA.offset + nodeA.triangleCount; i++)
+				{
+					if (trianglesIntersect(treeA->triangles[i], triangleB))
+					{
+						hit = true;
+						break;
+					}
+				}
+			}
+			continue;
+		}
+
+		//descend into the inner node, or the bigger one if both are inner nodes
+		bool descendA = nodeB.triangleCount > 0 ||
+			(nodeA.triangleCount == 0 && (nodeA.boxMax - nodeA.boxMin).getLengthSQ() >= (nodeB.boxMax - nodeB.boxMin).getLengthSQ());
+		if (descendA)
+		{
+			stack.push_back(std::make_pair(nodeA.offset, indexB));
+			stack.push_back(std::make_pair(indexA + 1, indexB));
+		}
+		else
+		{
+			stack.push_back(std::make_pair(indexA, nodeB.offset));
+			stack.push_back(std::make_pair(indexA, indexB + 1));
+		}
+	}
+	return isFinished();
+}
+
+bool MeshBVHOverlapQuery::isFinished() const
+{
+	return hit || stack.size() == 0;
+}
+
+bool MeshBVHOverlapQuery::intersects() const
+{
+	return hit;
+}
+
+//two triangles that aren't coplanar intersect exactly if an edge of one of them goes through the other.
+//coplanar triangles, like two flanges touching, don't count as interpenetrating
+bool MeshBVHOverlapQuery::trianglesIntersect(const MeshBVHTriangle& a, const MeshBVHTriangle& b) const
+{
+	core::vector3df a1 = a.v0 + a.edge1, a2 = a.v0 + a.edge2;
+	core::vector3df b1 = b.v0 + b.edge1, b2 = b.v0 + b.edge2;
+	return segmentHitsTriangle(a.v0, a1, b) || segmentHitsTriangle(a1, a2, b) || segmentHitsTriangle(a2, a.v0, b) ||
+		segmentHitsTriangle(b.v0, b1, a) || segmentHitsTriangle(b1, b2, a) || segmentHitsTriangle(b2, b.v0, a);
+}
+
+bool MeshBVHOverlapQuery::segmentHitsTriangle(const core::vector3df& start, const core::vector3df& end, const MeshBVHTriangle& triangle)
+{
+	core::vector3df direction = end - start;
+	core::vector3df p = direction.crossProduct(triangle.edge2);
+	f32 determinant = triangle.edge1.dotProduct(p);
+	if (fabs(determinant) < 1e-12f)
+		return false;
+	f32 inverseDeterminant = 1.0f / determinant;
+	core::vector3df s = start - triangle.v0;
+	f32 u = s.dotProduct(p) * inverseDeterminant;
+	if (u < 0 || u > 1)
+		return false;
+	core::vector3df q = s.crossProduct(triangle.edge1);
+	f32 v = direction.dotProduct(q) * inverseDeterminant;
+	if (v < 0 || u + v > 1)
+		return false;
+	f32 t = triangle.edge2.dotProduct(q) * inverseDeterminant;
+	return t >= 0 && t <= 1;
+}
@@ -0,0 +1,87 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+
+using namespace irr;
+
+class OrbiterMesh;
+
+//one node of the flattened tree. the left child of an inner node directly follows it in the array,
+//so only the right child needs an index
+struct MeshBVHNode
+{
+	core::vector3df boxMin, boxMax;
+	u32 offset;					//first triangle for leaves, right child for inner nodes
+	u32 triangleCount;			//0 for inner nodes
+};
+
+//triangle stored as one corner and two edges, which is what the ray test needs
+struct MeshBVHTriangle
+{
+	core::vector3df v0, edge1, edge2;
+};
+
+//bounding volume hierarchy over all triangles of a mesh, in mesh coordinates.
+//built with binned surface area heuristic, used to find the exact point where the mouse ray hits a vessel
+class MeshBVH
+{
+public:
+	MeshBVH();
+
+	//builds the tree from the mesh buffers of all groups of the mesh
+	void build(OrbiterMesh* mesh);
+	//looks for the nearest triangle hit by start + t * direction with t in [0, maxT].
+	//returns true and sets hitT if there is one
+	bool intersectRay(const core::vector3df& start, const core::vector3df& direction, f32 maxT, f32& hitT) const;
+
+	u32 getMemorySize() const;
+	u32 getTriangleCount() const;
+
+	static const u32 binCount = 12;
+	static const u32 maxLeafTriangles = 4;
+
+private:
+	friend class MeshBVHOverlapQuery;
+
+	struct BuildTriangle
+	{
+		core::aabbox3d<f32> box;
+		core::vector3df centroid;
+		u32 index;
+	};
+	u32 buildNode(std::vector<BuildTriangle>& buildTriangles, u32 first, u32 count, u32 level);
+	static bool intersectBox(const MeshBVHNode& node, const core::vector3df& start, const core::vector3df& inverseDirection, f32 maxT);
+
+	std::vector<MeshBVHNode> nodes;
+	std::vector<MeshBVHTriangle> triangles;
+	std::vector<MeshBVHTriangle> sourceTriangles;		//only used during the build
+	u32 depth;											//level of the deepest leaf, the root is level 0. sizes the traversal stack
+};
+
+//test whether the triangles of two meshes intersect, done in small steps so it can be spread over several frames.
+//both trees have to stay alive until the query is done
+class MeshBVHOverlapQuery
+{
+public:
+	//bToA places mesh b in the coordinates of mesh a
+	MeshBVHOverlapQuery(const MeshBVH* a, const MeshBVH* b, const core::matrix4& bToA);
+
+	//tests at most maxNodePairs pairs of tree nodes. returns true once the query is finished
+	bool step(u32 maxNodePairs);
+	bool isFinished() const;
+	//only meaningful once the query is finished
+	bool intersects() const;
+
+private:
+	bool trianglesIntersect(const MeshBVHTriangle& a, const MeshBVHTriangle& b) const;
+	static bool segmentHitsTriangle(const core::vector3df& start, const core::vector3df& end, const MeshBVHTriangle& triangle);
+
+	const MeshBVH* treeA;
+	const MeshBVH* treeB;
+	core::matrix4 bToA;
+	std::vector<std::pair<u32, u32> > stack;		//node pairs still to test
+	bool hit;
+};
@@ -0,0 +1,120 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "Metrics.h"
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+std::mutex Metrics::metricsMutex;
+std::map<std::string, double> Metrics::counters;
+std::map<std::string, double> Metrics::gauges;
+std::map<std::string, MetricHistogram> Metrics::histograms;
+
+MetricHistogram::MetricHistogram() : count(0), sum(0), min(0), max(0), last(0)
+{
+	std::fill(buckets, buckets + bucketCount, 0);
+}
+
+void MetricHistogram::add(double value)
+{
+	int bucket = 0;
+	if (value > 0)
+		bucket = std::min(bucketCount - 1, std::max(0, (int)floor(log(value) / log(2.0)) + bucketOffset + 1));
+	buckets[bucket]++;
+
+	if (count == 0 || value < min)
+		min = value;
+	if (count == 0 || value > max)
+		max = value;
+	count++;
+	sum += value;
+	last = value;
+}
+
+//returns the upper bound of the bucket the requested fraction of samples falls into
+double MetricHistogram::percentile(double fraction) const
+{
+	if (count == 0)
+		return 0;
+	unsigned int target = (unsigned int)ceil(fraction * count);
+	unsigned int seen = 0;
+	for (int i = 0; i < bucketCount; i++)
+	{
+		seen += buckets[i];
+		if (seen >= target)
+			return std::min(max, pow(2.0, i - bucketOffset));
+	}
+	return max;
+}
+
+double MetricHistogram::mean() const
+{
+	return count > 0 ? sum / count : 0;
+}
+
+void Metrics::incrementCounter(const std::string& name, double amount)
+{
+	std::lock_guard<std::mutex> lock(metricsMutex);
+	counters[name] += amount;
+}
+
+void Metrics::setGauge(const std::string& name, double value)
+{
+	std::lock_guard<std::mutex> lock(metricsMutex);
+	gauges[name] = value;
+}
+
+void Metrics::addToGauge(const std::string& name, double delta)
+{
+	std::lock_guard<std::mutex> lock(metricsMutex);
+	gauges[name] += delta;
+}
+
+void Metrics::recordSample(const std::string& name, double value)
+{
+	std::lock_guard<std::mutex> lock(metricsMutex);
+	histograms[name].add(value);
+}
+
+std::wstring Metrics::getOverlayText()
+{
+	std::ostringstream text;
+	text.precision(4);
+	{
+		std::lock_guard<std::mutex> lock(metricsMutex);
+		for (std::map<std::string, MetricHistogram>::const_iterator it = histograms.begin(); it != histograms.end(); ++it)
+		{
+			text << it->first << ": " << it->second.last << " (mean " << it->second.mean() << ", p95 "
+				<< it->second.percentile(0.95) << ", max " << it->second.max << ")\n";
+		}
+		for (std::map<std::string, double>::const_iterator it = gauges.begin(); it != gauges.end(); ++it)
+			text << it->first << ": " << it->second << "\n";
+		for (std::map<std::string, double>::const_iterator it = counters.begin(); it != counters.end(); ++it)
+			text << it->first << ": " << it->second << "\n";
+	}
+	std::string output = text.str();
+	return std::wstring(output.begin(), output.end());
+}
+
+bool Metrics::writeCSV(const std::string& fileName)
+{
+	std::ofstream file(fileName.c_str(), std::ios::out);
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(metricsMutex);
+	file << "name,type,value,count,sum,min,max,mean,p50,p95,p99\n";
+	for (std::map<std::string, double>::const_iterator it = counters.begin(); it != counters.end(); ++it)
+		file << it->first << ",counter," << it->second << ",,,,,,,,\n";
+	for (std::map<std::string, double>::const_iterator it = gauges.begin(); it != gauges.end(); ++it)
+		file << it->first << ",gauge," << it->second << ",,,,,,,,\n";
+	for (std::map<std::string, MetricHistogram>::const_iterator it = histograms.begin(); it != histograms.end(); ++it)
+	{
+		const MetricHistogram& h = it->second;
+		file << it->first << ",histogram," << h.last << "," << h.count << "," << h.sum << "," << h.min << "," << h.max << ","
+			<< h.mean() << "," << h.percentile(0.5) << "," << h.percentile(0.95) << "," << h.percentile(0.99) << "\n";
+	}
+	return true;
+}
@@ -0,0 +1,45 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <map>
+
+//distribution of recorded samples. buckets are powers of two, so percentiles are estimates
+struct MetricHistogram
+{
+	MetricHistogram();
+	void add(double value);
+	double percentile(double fraction) const;
+	double mean() const;
+
+	static const int bucketCount = 40;
+	static const int bucketOffset = 10;			//bucket 0 holds everything below 2^-10
+	unsigned int buckets[bucketCount];
+	unsigned int count;
+	double sum, min, max, last;
+};
+
+//global registry that any subsystem can publish numbers to. thread safe.
+//counters only ever go up, gauges hold the current value of something, histograms collect samples.
+//names are grouped by their prefix, e.g. "render.draw_calls" or "datamanager.mesh_hits"
+class Metrics
+{
+public:
+	static void incrementCounter(const std::string& name, double amount = 1);
+	static void setGauge(const std::string& name, double value);
+	static void addToGauge(const std::string& name, double delta);
+	static void recordSample(const std::string& name, double value);
+
+	//one line per metric, for the overlay
+	static std::wstring getOverlayText();
+	//writes all metrics to a csv file. returns false if the file couldn't be written
+	static bool writeCSV(const std::string& fileName);
+
+private:
+	static std::mutex metricsMutex;			//deliberately not a ProfiledMutex, the lock profiler publishes its results here
+	static std::map<std::string, double> counters;
+	static std::map<std::string, double> gauges;
+	static std::map<std::string, MetricHistogram> histograms;
+};
@@ -21,15 +21,15 @@ struct DockingPortStatus
 struct OrbiterDockingPort
 {
 	OrbiterDockingPort(core::vector3d<f32> pos, core::vector3d<f32> appDir, core::vector3d<f32> refDir)
-	: position(pos), approachDirection(appDir), referenceDirection(refDir) {}
+	: markerIndex(-1), position(pos), approachDirection(appDir), referenceDirection(refDir) {}
 	VesselSceneNode* parent;
     DockingIdentifier dockedTo;
 
     DockingPortStatus returnStatus();
 
     unsigned int portID;
-	scene::IMeshSceneNode* portNode;
-	scene::IMeshSceneNode* helperNode;
+	int markerIndex;						//index in the DockingPortMarkerRenderer of the scene, -1 if none
+	core::matrix4 relativeTransform;		//position and orientation of the port relative to its vessel
 	int index;
 	bool docked;
 	core::vector3d<f32> position;
@@ -2,14 +2,54 @@
 //The MIT License - See ../../LICENSE for more info
 #include "OrbiterMesh.h"
 
-OrbiterMesh::OrbiterMesh()
+OrbiterMesh::OrbiterMesh() : mesh(0), pickingBVH(0)
 {}
 
-OrbiterMesh::OrbiterMesh(string meshFilename, video::IVideoDriver* driver, scene::ISceneManager* smgr)
+OrbiterMesh::OrbiterMesh(string meshFilename, video::IVideoDriver* driver, scene::ISceneManager* smgr) : mesh(0), pickingBVH(0)
 {
 	setupMesh(meshFilename, driver);
 }
 
+OrbiterMesh::~OrbiterMesh()
+{
+	//the mesh drops its mesh buffers. Irrlicht releases the hardware buffers together with the driver
+	if (mesh)
+		mesh->drop();
+	delete pickingBVH;
+}
+
+u32 OrbiterMesh::getResidentBytes()
+{
+	u32 bytes = 0;
+	for (UINT i = 0; i < meshGroups.size(); i++)
+	{
+		const scene::IMeshBuffer* buffer = meshGroups[i].meshBuffer;
+		if (buffer == 0)
+			continue;
+		bytes += buffer->getVertexCount() * sizeof(video::S3DVertex);
+		bytes += buffer->getIndexCount() * (buffer->getIndexType() == video::EIT_32BIT ? 4 : 2);
+	}
+	for (UINT i = 0; i < textures.size(); i++)
+	{
+		if (textures[i] != 0)
+			bytes += textures[i]->getPitch() * textures[i]->getSize().Height;
+	}
+	if (pickingBVH != 0)
+		bytes += pickingBVH->getMemorySize();
+	return bytes;
+}
+
+MeshBVH* OrbiterMesh::getPickingBVH()
+{
+	//most meshes never get clicked, so the tree is only built when a pick actually reaches this mesh
+	if (pickingBVH == 0 && mesh != 0)
+	{
+		pickingBVH = new MeshBVH();
+		pickingBVH->build(this);
+	}
+	return pickingBVH;
+}
+
 bool OrbiterMesh::setupMesh(string meshFilename, video::IVideoDriver* driver)
 {
 	ifstream meshFile = ifstream(meshFilename.c_str());
@@ -28,7 +68,7 @@ bool OrbiterMesh::setupMesh(string meshFilename, video::IVideoDriver* driver)
 	//push the default material
 	materials.push_back(video::SMaterial());
 	//push the default texture
-	Helpers::videoDriverMutex.lock();
+	Helpers::videoDriverMutex.lock(__FUNCTION__);
 	textures.push_back(driver->addTexture(core::dimension2d<u32>(1, 1),"empty_texture"));
 	Helpers::videoDriverMutex.unlock();
 
@@ -51,6 +91,9 @@ bool OrbiterMesh::setupMesh(string meshFilename, video::IVideoDriver* driver)
 					//set default
 					meshGroups[i].materialIndex = 0;
 					meshGroups[i].textureIndex = 0;
+					meshGroups[i].meshBuffer = 0;
+					meshGroups[i].renderMaterialIndex = -1;
+					meshGroups[i].triangleCount = 0;
 				}
 				break;
 			}
@@ -247,9 +290,100 @@ bool OrbiterMesh::setupMesh(string meshFilename, video::IVideoDriver* driver)
 		for (UINT j = 0; j < meshGroups[i].vertices.size(); j++)
 			boundingBox.addInternalPoint(meshGroups[i].vertices[j].Pos);
 	}
+	setupMeshBuffers();
+	setupRenderMaterials();
 	return true;
 }
 
+//builds the final material of every mesh group once, so rendering only has to bind it.
+//groups using the same material and texture share one entry, which lets the renderer skip redundant material switches
+void OrbiterMesh::setupRenderMaterials()
+{
+	map<pair<int, int>, int> usedCombinations;
+	for (UINT i = 0; i < meshGroups.size(); i++)
+	{
+		OrbiterMeshGroup &group = meshGroups[i];
+		if (group.materialIndex < 0 || group.materialIndex >= (int)materials.size())
+		{
+			group.renderMaterialIndex = -1;
+			continue;
+		}
+		//a texture index that isn't defined in the mesh is treated like no texture at all
+		int textureIndex = group.textureIndex;
+		if (textureIndex < 0 || textureIndex >= (int)textures.size())
+			textureIndex = 0;
+
+		pair<int, int> combination(group.materialIndex, textureIndex);
+		map<pair<int, int>, int>::iterator pos = usedCombinations.find(combination);
+		if (pos != usedCombinations.end())
+		{
+			group.renderMaterialIndex = pos->second;
+			continue;
+		}
+
+		video::SMaterial material = materials[group.materialIndex];
+		material.setTexture(0, textureIndex == 0 ? 0 : textures[textureIndex]);
+		renderMaterials.push_back(material);
+
+		material.Lighting = false;
+		material.MaterialType = video::EMT_TRANSPARENT_ADD_COLOR;
+		transparentRenderMaterials.push_back(material);
+
+		group.renderMaterialIndex = renderMaterials.size() - 1;
+		usedCombinations[combination] = group.renderMaterialIndex;
+	}
+}
+
+//moves the geometry of every mesh group into a mesh buffer flagged as static,
+//so the driver can keep it in video memory instead of streaming it every frame
+void OrbiterMesh::setupMeshBuffers()
+{
+	mesh = new scene::SMesh();
+	for (UINT i = 0; i < meshGroups.size(); i++)
+	{
+		OrbiterMeshGroup &group = meshGroups[i];
+		scene::IMeshBuffer *buffer;
+		if (group.vertices.size() <= 65536)
+		//16 bit indices are enough, use a plain SMeshBuffer
+		{
+			scene::SMeshBuffer *smallBuffer = new scene::SMeshBuffer();
+			smallBuffer->Vertices.reallocate(group.vertices.size());
+			for (UINT j = 0; j < group.vertices.size(); j++)
+				smallBuffer->Vertices.push_back(group.vertices[j]);
+			smallBuffer->Indices.reallocate(group.triangleList.size());
+			for (UINT j = 0; j < group.triangleList.size(); j++)
+				smallBuffer->Indices.push_back((u16)group.triangleList[j]);
+			buffer = smallBuffer;
+		}
+		else
+		//too many vertices for 16 bit indices, fall back to a 32 bit index buffer
+		{
+			scene::CDynamicMeshBuffer *largeBuffer = new scene::CDynamicMeshBuffer(video::EVT_STANDARD, video::EIT_32BIT);
+			largeBuffer->getVertexBuffer().reallocate(group.vertices.size());
+			for (UINT j = 0; j < group.vertices.size(); j++)
+				largeBuffer->getVertexBuffer().push_back(group.vertices[j]);
+			largeBuffer->getIndexBuffer().reallocate(group.triangleList.size());
+			for (UINT j = 0; j < group.triangleList.size(); j++)
+				largeBuffer->getIndexBuffer().push_back((u32)group.triangleList[j]);
+			buffer = largeBuffer;
+		}
+		buffer->recalculateBoundingBox();
+		buffer->setHardwareMappingHint(scene::EHM_STATIC);
+		group.boundingBox = buffer->getBoundingBox();
+		group.triangleCount = group.triangleList.size() / 3;
+		mesh->addMeshBuffer(buffer);
+		//the mesh grabbed the buffer, so we can let go of ours
+		buffer->drop();
+		group.meshBuffer = buffer;
+
+		//release the parsing copies, the mesh buffer holds the geometry from now on
+		vector<video::S3DVertex>().swap(group.vertices);
+		vector<int>().swap(group.triangleList);
+	}
+	mesh->recalculateBoundingBox();
+	mesh->setHardwareMappingHint(scene::EHM_STATIC);
+}
+
 void OrbiterMesh::setupNormals(int meshGroup)
 {
 	//reset all normals in this mesh group just in case
@@ -4,12 +4,14 @@
 
 #include <irrlicht.h>
 #include <vector>
+#include <map>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
 
 #include "OrbiterMeshGroup.h"
+#include "MeshBVH.h"
 
 using namespace irr;
 using namespace std;
@@ -19,13 +21,22 @@ class OrbiterMesh
 public:
 	OrbiterMesh();
 	OrbiterMesh(std::string meshFilename, video::IVideoDriver* driver, scene::ISceneManager* smgr);
+	~OrbiterMesh();
 	bool setupMesh(std::string meshFilename, video::IVideoDriver* driver);
 	core::aabbox3d<f32> boundingBox;
 	vector<video::SMaterial> materials;
 	vector<video::ITexture*> textures;
 	vector<OrbiterMeshGroup> meshGroups;
+	vector<video::SMaterial> renderMaterials;				//final materials with textures applied, one per used material/texture pair
+	vector<video::SMaterial> transparentRenderMaterials;	//same as renderMaterials, but set up for drawing the vessel transparent
+	scene::SMesh *mesh;					//holds one static mesh buffer per mesh group
 	void getOuterDimensions(core::vector3df &max, core::vector3df &min);
+	u32 getResidentBytes();				//approximate memory held by geometry and textures
+	MeshBVH* getPickingBVH();			//triangle tree for exact picking, built on first use
 
 private:
+	MeshBVH* pickingBVH;
 	void setupNormals(int meshGroup);
+	void setupMeshBuffers();
+	void setupRenderMaterials();
 };
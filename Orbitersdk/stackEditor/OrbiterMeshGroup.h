@@ -11,8 +11,14 @@ using namespace irr;
 
 struct OrbiterMeshGroup
 {
+	//vertices and triangleList are only filled while the mesh file is parsed.
+	//once loading is done they are moved into meshBuffer and released
 	std::vector<video::S3DVertex> vertices;
 	std::vector<int> triangleList;
 	int materialIndex;
 	int textureIndex;
+	scene::IMeshBuffer *meshBuffer;			//owned by OrbiterMesh::mesh, shared by all vessels using this mesh
+	int renderMaterialIndex;				//index into OrbiterMesh::renderMaterials, -1 if the group has no valid material
+	core::aabbox3d<f32> boundingBox;		//in mesh coordinates, used to cull single groups
+	u32 triangleCount;
 };
@@ -0,0 +1,166 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "ProfiledMutex.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "windows.h"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+ProfiledMutex::ProfiledMutex(const char* lockName) : name(lockName), holderSite(0), heldSince(0)
+{
+	std::lock_guard<std::mutex> guard(registryMutex());
+	registry().push_back(this);
+}
+
+ProfiledMutex::~ProfiledMutex()
+{
+	std::lock_guard<std::mutex> guard(registryMutex());
+	std::vector<ProfiledMutex*>& mutexes = registry();
+	mutexes.erase(std::remove(mutexes.begin(), mutexes.end(), this), mutexes.end());
+}
+
+void ProfiledMutex::lock(const char* callSite)
+{
+	//only time the wait if there actually is one
+	if (mutex.try_lock())
+	{
+		acquired(callSite, 0, false);
+		return;
+	}
+	long long waitStart = now();
+	mutex.lock();
+	acquired(callSite, now() - waitStart, true);
+}
+
+bool ProfiledMutex::try_lock(const char* callSite)
+{
+	if (!mutex.try_lock())
+		return false;
+	acquired(callSite, 0, false);
+	return true;
+}
+
+void ProfiledMutex::unlock()
+{
+	long long held = now() - heldSince;
+	LockSiteStats& site = sites[holderSite];
+	site.holdTicks += held;
+	site.maxHoldTicks = std::max(site.maxHoldTicks, held);
+	mutex.unlock();
+}
+
+void ProfiledMutex::acquired(const char* callSite, long long waitTicks, bool contended)
+{
+	LockSiteStats& site = sites[callSite];
+	site.acquisitions++;
+	if (contended)
+		site.contended++;
+	site.waitTicks += waitTicks;
+	site.maxWaitTicks = std::max(site.maxWaitTicks, waitTicks);
+	holderSite = callSite;
+	heldSince = now();
+}
+
+//copies the timings, merging call sites with the same name
+std::map<std::string, LockSiteStats> ProfiledMutex::snapshot()
+{
+	std::map<std::string, LockSiteStats> result;
+	//don't count our own look at the numbers
+	std::lock_guard<std::mutex> guard(mutex);
+	for (std::map<const char*, LockSiteStats>::const_iterator it = sites.begin(); it != sites.end(); ++it)
+	{
+		LockSiteStats& merged = result[it->first];
+		merged.acquisitions += it->second.acquisitions;
+		merged.contended += it->second.contended;
+		merged.waitTicks += it->second.waitTicks;
+		merged.maxWaitTicks = std::max(merged.maxWaitTicks, it->second.maxWaitTicks);
+		merged.holdTicks += it->second.holdTicks;
+		merged.maxHoldTicks = std::max(merged.maxHoldTicks, it->second.maxHoldTicks);
+	}
+	return result;
+}
+
+void ProfiledMutex::logSummary()
+{
+	std::vector<std::string> lines;
+	{
+		std::lock_guard<std::mutex> guard(registryMutex());
+		std::vector<ProfiledMutex*>& mutexes = registry();
+		std::ostringstream header;
+		header << std::left << std::setw(24) << "lock" << std::setw(36) << "call site" << std::right
+			<< std::setw(10) << "count" << std::setw(10) << "contended" << std::setw(12) << "wait ms"
+			<< std::setw(12) << "max wait" << std::setw(12) << "hold ms" << std::setw(12) << "max hold";
+		lines.push_back(header.str());
+		for (size_t i = 0; i < mutexes.size(); i++)
+		{
+			std::map<std::string, LockSiteStats> sites = mutexes[i]->snapshot();
+			for (std::map<std::string, LockSiteStats>::const_iterator it = sites.begin(); it != sites.end(); ++it)
+			{
+				std::ostringstream line;
+				line << std::fixed << std::setprecision(3);
+				line << std::left << std::setw(24) << mutexes[i]->name << std::setw(36) << it->first << std::right
+					<< std::setw(10) << it->second.acquisitions << std::setw(10) << it->second.contended
+					<< std::setw(12) << ticksToMs(it->second.waitTicks) << std::setw(12) << ticksToMs(it->second.maxWaitTicks)
+					<< std::setw(12) << ticksToMs(it->second.holdTicks) << std::setw(12) << ticksToMs(it->second.maxHoldTicks);
+				lines.push_back(line.str());
+			}
+		}
+	}
+	//logging locks Log::writeMutex, so only start once we let go of everything
+	Log::writeToLog(Log::INFO, "Lock contention summary:");
+	for (size_t i = 0; i < lines.size(); i++)
+		Log::writeToLog(Log::INFO, lines[i]);
+}
+
+void ProfiledMutex::publishMetrics()
+{
+	std::lock_guard<std::mutex> guard(registryMutex());
+	std::vector<ProfiledMutex*>& mutexes = registry();
+	for (size_t i = 0; i < mutexes.size(); i++)
+	{
+		std::map<std::string, LockSiteStats> sites = mutexes[i]->snapshot();
+		LockSiteStats total;
+		for (std::map<std::string, LockSiteStats>::const_iterator it = sites.begin(); it != sites.end(); ++it)
+		{
+			total.acquisitions += it->second.acquisitions;
+			total.contended += it->second.contended;
+			total.waitTicks += it->second.waitTicks;
+			total.holdTicks += it->second.holdTicks;
+		}
+		std::string prefix = std::string("lock.") + mutexes[i]->name;
+		Metrics::setGauge(prefix + ".acquisitions", total.acquisitions);
+		Metrics::setGauge(prefix + ".contended", total.contended);
+		Metrics::setGauge(prefix + ".wait_ms", ticksToMs(total.waitTicks));
+		Metrics::setGauge(prefix + ".hold_ms", ticksToMs(total.holdTicks));
+	}
+}
+
+long long ProfiledMutex::now()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+double ProfiledMutex::ticksToMs(long long ticks)
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	return ticks * 1000.0 / frequency.QuadPart;
+}
+
+std::vector<ProfiledMutex*>& ProfiledMutex::registry()
+{
+	static std::vector<ProfiledMutex*> mutexes;
+	return mutexes;
+}
+
+std::mutex& ProfiledMutex::registryMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
@@ -0,0 +1,56 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <mutex>
+#include <map>
+#include <vector>
+#include <string>
+
+//timings of one call site of a ProfiledMutex
+struct LockSiteStats
+{
+	LockSiteStats() : acquisitions(0), contended(0), waitTicks(0), maxWaitTicks(0), holdTicks(0), maxHoldTicks(0) {}
+	unsigned int acquisitions;
+	unsigned int contended;				//acquisitions that had to wait for another thread
+	long long waitTicks, maxWaitTicks;
+	long long holdTicks, maxHoldTicks;
+};
+
+//drop-in replacement for std::mutex that records how long threads wait for it and how long they hold it,
+//per lock and per call site. call sites are plain strings, usually __FUNCTION__.
+//the timings of a lock are only ever written while holding that lock, so they need no extra locking
+class ProfiledMutex
+{
+public:
+	ProfiledMutex(const char* lockName);
+	~ProfiledMutex();
+
+	void lock(const char* callSite = "unknown");
+	bool try_lock(const char* callSite = "unknown");
+	void unlock();
+
+	//writes a table of all locks and call sites to the log
+	static void logSummary();
+	//publishes the totals of every lock to the metrics registry
+	static void publishMetrics();
+
+private:
+	ProfiledMutex(const ProfiledMutex&);
+	ProfiledMutex& operator=(const ProfiledMutex&);
+
+	void acquired(const char* callSite, long long waitTicks, bool contended);
+	std::map<std::string, LockSiteStats> snapshot();
+
+	std::mutex mutex;
+	const char* name;
+	std::map<const char*, LockSiteStats> sites;
+	const char* holderSite;
+	long long heldSince;
+
+	static long long now();
+	static double ticksToMs(long long ticks);
+	//all existing profiled mutexes. guarded by a plain mutex, profiling the registry would recurse
+	static std::vector<ProfiledMutex*>& registry();
+	static std::mutex& registryMutex();
+};
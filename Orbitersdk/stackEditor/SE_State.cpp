@@ -1,107 +1,747 @@
 //Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
 //The MIT License - See ../../LICENSE for more info
 #include "SE_State.h"
+#include "Metrics.h"
+#include "VesselNodePool.h"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
 
-SE_GlobalState::SE_GlobalState(const std::map<UINT, VesselSceneNode*>& vessels)
+//grabbing a stack and dropping it where it was still does some math on the transformations
+static const f32 positionTolerance = 1e-4f;
+static const f32 rotationTolerance = 1e-5f;
+
+static bool samePosition(const core::vector3df& a, const core::vector3df& b)
 {
-    for (auto it = vessels.begin(); it != vessels.end(); ++it)
-        state[it->first] = it->second->saveState();
+    return a.equals(b, positionTolerance);
+}
+
+//the same rotation can come in different euler angles, compare the matrices instead
+static bool sameRotation(const core::vector3df& a, const core::vector3df& b)
+{
+    core::matrix4 matrixA, matrixB;
+    matrixA.setRotationDegrees(a);
+    matrixB.setRotationDegrees(b);
+    return matrixA.equals(matrixB, rotationTolerance);
+}
+
+static bool sameStatus(const DockingPortStatus& a, const DockingPortStatus& b)
+{
+    if (a.docked != b.docked)
+        return false;
+    return !a.docked || (a.dockedTo.vesselUID == b.dockedTo.vesselUID && a.dockedTo.portID == b.dockedTo.portID);
+}
+
+void SE_Action::undo(scene::ISceneManager* mgr)
+{
+    apply(mgr, true);
+}
+
+void SE_Action::redo(scene::ISceneManager* mgr)
+{
+    apply(mgr, false);
 }
 
-void SE_GlobalState::apply(scene::ISceneManager* mgr)
+void SE_Action::apply(scene::ISceneManager* mgr, bool backwards)
 {
-    core::list<ISceneNode*> allNodes = mgr->getRootSceneNode()->getChildren();
-    //clear all old vessels
-    std::vector<ISceneNode*> childrenToDelete;
-    for (auto it = allNodes.begin(); it != allNodes.end(); ++it)
+    //create vessels first, so docking to them works
+    for (UINT i = 0; i < vessels.size(); ++i)
     {
-        if ((*it)->getID() == VESSEL_ID)
-            childrenToDelete.push_back(*it);
+        if ((vessels[i].type == VesselOperation::DELETE) == backwards)
+        {
+            Log::writeToLog(Log::L_DEBUG, "Action: creating vessel, uid: ", vessels[i].state.uid);
+            VesselNodePool::getPool(mgr)->acquire(vessels[i].state, mgr->getRootSceneNode(), VESSEL_ID);
+        }
     }
-    for (UINT i = 0; i < childrenToDelete.size(); ++i)
+
+    for (UINT i = 0; i < transforms.size(); ++i)
     {
-        mgr->getRootSceneNode()->removeChild(childrenToDelete[i]);
+        const TransformOperation& operation = transforms[i];
+        VesselSceneNode* vessel = Helpers::getVesselByUID(operation.uid);
+        vessel->setPosition(backwards ? operation.oldPos : operation.newPos);
+        if (operation.type == TransformOperation::ROTATE)
+            vessel->setRotation(backwards ? operation.oldRot : operation.newRot);
+        vessel->updateAbsolutePosition();
     }
 
-    //create new vessels
-    for (auto it = state.begin(); it != state.end(); ++it)
-        VesselSceneNode* newVessel = new VesselSceneNode(it->second, mgr->getRootSceneNode(), mgr, VESSEL_ID);
+    //set all the ports before telling anyone, both ends of a docking have to agree
+    std::vector<VesselSceneNode*> changed;
+    for (UINT i = 0; i < ports.size(); ++i)
+    {
+        const PortOperation& operation = ports[i];
+        VesselSceneNode* vessel = Helpers::getVesselByUID(operation.uid);
+        const DockingPortStatus& status = backwards ? operation.oldStatus : operation.newStatus;
+        vessel->dockingPorts.at(operation.port).docked = status.docked;
+        vessel->dockingPorts.at(operation.port).dockedTo = status.dockedTo;
+        changed.push_back(vessel);
+    }
+    for (UINT i = 0; i < changed.size(); ++i)
+        changed[i]->dockingStatusChanged();
+
+    //delete vessels last, nothing is docked to them anymore by now
+    for (UINT i = 0; i < vessels.size(); ++i)
+    {
+        if ((vessels[i].type == VesselOperation::ADD) == backwards)
+        {
+            Log::writeToLog(Log::L_DEBUG, "Action: deleting vessel, uid: ", vessels[i].state.uid);
+            VesselNodePool::getPool(mgr)->release(Helpers::getVesselByUID(vessels[i].state.uid));
+        }
+    }
+}
+
+bool SE_Action::isEmpty() const
+{
+    return getOperationCount() == 0;
+}
+
+size_t SE_Action::getOperationCount() const
+{
+    return transforms.size() + ports.size() + vessels.size();
+}
+
+size_t SE_Action::getMemorySize() const
+{
+    size_t bytes = sizeof(*this);
+    bytes += transforms.capacity() * sizeof(TransformOperation);
+    bytes += ports.capacity() * sizeof(PortOperation);
+    bytes += vessels.capacity() * sizeof(VesselOperation);
+    for (UINT i = 0; i < vessels.size(); ++i)
+    {
+        bytes += vessels[i].state.dockingStatus.capacity() * sizeof(DockingPortStatus);
+        bytes += vessels[i].state.orbiterName.capacity();
+    }
+    return bytes;
+}
+
+//the packed form. counts and uids are varints, uids as the difference to the one before.
+//new positions and rotations are stored as the bits that differ from the old ones, so axes that didn't change
+//cost a single byte. nothing is rounded, unpacking gives back exactly the same action
+static void writeVarint(std::vector<unsigned char>& out, unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static void writeSigned(std::vector<unsigned char>& out, int value)
+{
+    //zigzag, so small negative differences stay small
+    writeVarint(out, ((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+static unsigned int floatBits(f32 value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static void writeVector(std::vector<unsigned char>& out, const core::vector3df& value)
+{
+    const f32 components[3] = { value.X, value.Y, value.Z };
+    for (int i = 0; i < 3; i++)
+    {
+        unsigned int bits = floatBits(components[i]);
+        for (int b = 0; b < 4; b++)
+            out.push_back((unsigned char)(bits >> (b * 8)));
+    }
+}
+
+static void writeVectorChange(std::vector<unsigned char>& out, const core::vector3df& oldValue, const core::vector3df& newValue)
+{
+    writeVarint(out, floatBits(oldValue.X) ^ floatBits(newValue.X));
+    writeVarint(out, floatBits(oldValue.Y) ^ floatBits(newValue.Y));
+    writeVarint(out, floatBits(oldValue.Z) ^ floatBits(newValue.Z));
+}
+
+static void writeStatus(std::vector<unsigned char>& out, const DockingPortStatus& status)
+{
+    if (!status.docked)
+        return;
+    writeVarint(out, status.dockedTo.vesselUID);
+    writeVarint(out, status.dockedTo.portID);
 }
 
-SE_DiffState::SE_DiffState(const SE_GlobalState& oldState, const SE_GlobalState& newState)
+class PackedReader
 {
-    //check through every vessel in old state
-    for (auto it = oldState.state.begin(); it != oldState.state.end(); ++it)
+public:
+    PackedReader(const std::vector<unsigned char>& _data) : data(_data), position(0) {}
+
+    unsigned char readByte()
+    {
+        if (position >= data.size())
+            throw std::runtime_error("Packed undo step ends early");
+        return data[position++];
+    }
+
+    unsigned int readVarint()
     {
-        VesselDiffState currentVesselDiffState;
-        //if this vessel UID exists in the new state, this is an update
-        if (newState.state.count(it->first))
+        unsigned int value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
         {
-            currentVesselDiffState.diffType = VesselDiffState::DiffType::UPDATE;
-            currentVesselDiffState.state = newState.state.at(it->first);
+            unsigned char byte = readByte();
+            value |= (unsigned int)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
         }
-        else
+        throw std::runtime_error("Bad varint in packed undo step");
+    }
+
+    int readSigned()
+    {
+        unsigned int value = readVarint();
+        return (int)(value >> 1) ^ -(int)(value & 1);
+    }
+
+    core::vector3df readVector()
+    {
+        f32 components[3];
+        for (int i = 0; i < 3; i++)
         {
-            //otherwise this is a delete operation
-            currentVesselDiffState.diffType = VesselDiffState::DiffType::DELETE;
+            unsigned int bits = 0;
+            for (int b = 0; b < 4; b++)
+                bits |= (unsigned int)readByte() << (b * 8);
+            memcpy(&components[i], &bits, sizeof(bits));
         }
-        state[it->first] = currentVesselDiffState;
+        return core::vector3df(components[0], components[1], components[2]);
+    }
+
+    core::vector3df readVectorChange(const core::vector3df& oldValue)
+    {
+        unsigned int bits[3] = { floatBits(oldValue.X) ^ readVarint(), floatBits(oldValue.Y) ^ readVarint(), floatBits(oldValue.Z) ^ readVarint() };
+        f32 components[3];
+        memcpy(components, bits, sizeof(components));
+        return core::vector3df(components[0], components[1], components[2]);
+    }
+
+    DockingPortStatus readStatus(bool docked)
+    {
+        DockingPortStatus status;
+        status.docked = docked;
+        status.dockedTo.vesselUID = docked ? readVarint() : 0;
+        status.dockedTo.portID = docked ? readVarint() : 0;
+        return status;
     }
 
-    //now check for new vessels in newState, those which aren't in oldState
-    for (auto it = newState.state.begin(); it != newState.state.end(); ++it)
+    void readBytes(void* target, size_t count)
     {
-        if (!oldState.state.count(it->first))
+        if (count > data.size() - position)
+            throw std::runtime_error("Packed undo step ends early");
+        memcpy(target, &data[position], count);
+        position += count;
+    }
+
+    bool atEnd() const { return position == data.size(); }
+
+private:
+    const std::vector<unsigned char>& data;
+    size_t position;
+};
+
+void SE_Action::pack(std::vector<unsigned char>& out) const
+{
+    out.clear();
+    writeVarint(out, transforms.size());
+    writeVarint(out, ports.size());
+    writeVarint(out, vessels.size());
+
+    UINT lastUID = 0;
+    for (UINT i = 0; i < transforms.size(); ++i)
+    {
+        const TransformOperation& operation = transforms[i];
+        out.push_back((unsigned char)operation.type);
+        writeSigned(out, (int)(operation.uid - lastUID));
+        lastUID = operation.uid;
+        writeVector(out, operation.oldPos);
+        writeVectorChange(out, operation.oldPos, operation.newPos);
+        if (operation.type == TransformOperation::ROTATE)
         {
-            //old state does not contain this vessel, so add operation
-            VesselDiffState currentVesselDiffState;
-            currentVesselDiffState.diffType = VesselDiffState::DiffType::ADD;
-            currentVesselDiffState.state = it->second;
-            state[it->first] = currentVesselDiffState;
+            writeVector(out, operation.oldRot);
+            writeVectorChange(out, operation.oldRot, operation.newRot);
+        }
+    }
+
+    lastUID = 0;
+    for (UINT i = 0; i < ports.size(); ++i)
+    {
+        const PortOperation& operation = ports[i];
+        writeSigned(out, (int)(operation.uid - lastUID));
+        lastUID = operation.uid;
+        writeVarint(out, operation.port);
+        out.push_back((unsigned char)((operation.type == PortOperation::DOCK ? 1 : 0) |
+            (operation.oldStatus.docked ? 2 : 0) | (operation.newStatus.docked ? 4 : 0)));
+        writeStatus(out, operation.oldStatus);
+        writeStatus(out, operation.newStatus);
+    }
+
+    for (UINT i = 0; i < vessels.size(); ++i)
+    {
+        const VesselSceneNodeState& state = vessels[i].state;
+        out.push_back((unsigned char)vessels[i].type);
+        const unsigned char* data = (const unsigned char*)&state.vesData;
+        out.insert(out.end(), data, data + sizeof(state.vesData));
+        writeVarint(out, state.uid);
+        writeVector(out, state.pos);
+        writeVector(out, state.rot);
+        writeVarint(out, state.orbiterName.size());
+        out.insert(out.end(), state.orbiterName.begin(), state.orbiterName.end());
+        writeVarint(out, state.dockingStatus.size());
+        for (UINT j = 0; j < state.dockingStatus.size(); ++j)
+        {
+            out.push_back(state.dockingStatus[j].docked ? 1 : 0);
+            writeStatus(out, state.dockingStatus[j]);
         }
     }
 }
 
-void SE_DiffState::apply(scene::ISceneManager* mgr)
+SE_Action SE_Action::unpack(const std::vector<unsigned char>& data)
 {
-    Log::writeToLog(Log::INFO, "Applying diff state");
-    //go through internal state, switching on diff type
+    PackedReader reader(data);
+    SE_Action action;
+    //every operation takes at least a few bytes, damaged counts shouldn't make us allocate gigabytes
+    UINT transformCount = reader.readVarint();
+    UINT portCount = reader.readVarint();
+    UINT vesselCount = reader.readVarint();
+    if (transformCount + portCount + vesselCount > data.size())
+        throw std::runtime_error("Bad operation count in packed undo step");
 
-    //do ADD and DELETE operations first, so updates with docking work
-    for (auto it = state.begin(); it != state.end(); ++it)
+    action.transforms.resize(transformCount);
+    UINT lastUID = 0;
+    for (UINT i = 0; i < transformCount; ++i)
     {
-        switch (it->second.diffType)
+        TransformOperation& operation = action.transforms[i];
+        operation.type = reader.readByte() == TransformOperation::ROTATE ? TransformOperation::ROTATE : TransformOperation::MOVE;
+        operation.uid = lastUID + reader.readSigned();
+        lastUID = operation.uid;
+        operation.oldPos = reader.readVector();
+        operation.newPos = reader.readVectorChange(operation.oldPos);
+        if (operation.type == TransformOperation::ROTATE)
         {
-        case VesselDiffState::DiffType::ADD:
+            operation.oldRot = reader.readVector();
+            operation.newRot = reader.readVectorChange(operation.oldRot);
+        }
+    }
+
+    action.ports.resize(portCount);
+    lastUID = 0;
+    for (UINT i = 0; i < portCount; ++i)
+    {
+        PortOperation& operation = action.ports[i];
+        operation.uid = lastUID + reader.readSigned();
+        lastUID = operation.uid;
+        operation.port = reader.readVarint();
+        unsigned char flags = reader.readByte();
+        operation.type = (flags & 1) ? PortOperation::DOCK : PortOperation::UNDOCK;
+        operation.oldStatus = reader.readStatus((flags & 2) != 0);
+        operation.newStatus = reader.readStatus((flags & 4) != 0);
+    }
+
+    action.vessels.resize(vesselCount);
+    for (UINT i = 0; i < vesselCount; ++i)
+    {
+        VesselSceneNodeState& state = action.vessels[i].state;
+        action.vessels[i].type = reader.readByte() == VesselOperation::DELETE ? VesselOperation::DELETE : VesselOperation::ADD;
+        reader.readBytes(&state.vesData, sizeof(state.vesData));
+        state.uid = reader.readVarint();
+        state.pos = reader.readVector();
+        state.rot = reader.readVector();
+        UINT nameLength = reader.readVarint();
+        if (nameLength > data.size())
+            throw std::runtime_error("Bad name length in packed undo step");
+        state.orbiterName.resize(nameLength);
+        if (nameLength > 0)
+            reader.readBytes(&state.orbiterName[0], nameLength);
+        UINT statusCount = reader.readVarint();
+        if (statusCount > data.size())
+            throw std::runtime_error("Bad port count in packed undo step");
+        state.dockingStatus.resize(statusCount);
+        for (UINT j = 0; j < statusCount; ++j)
+            state.dockingStatus[j] = reader.readStatus(reader.readByte() != 0);
+    }
+
+    if (!reader.atEnd())
+        throw std::runtime_error("Packed undo step is longer than its operations");
+    return action;
+}
+
+size_t SE_StoredAction::getMemorySize() const
+{
+    size_t bytes = sizeof(*this) - sizeof(SE_Action);
+    if (storage == LIVE)
+        bytes += action.getMemorySize();
+    return bytes + packed.capacity();
+}
+
+SE_UndoHistory::SE_UndoHistory() : memorySize(0), maxDepth(0), memoryBudget(0),
+    spillFile(NULL), spillEnd(0), spilledSteps(0), spilledBytes(0), spillFailed(false)
+{
+}
+
+SE_UndoHistory::~SE_UndoHistory()
+{
+    closeSpillFile();
+}
+
+void SE_UndoHistory::setLimits(size_t _maxDepth, size_t _memoryBudget)
+{
+    maxDepth = _maxDepth;
+    memoryBudget = _memoryBudget;
+    Log::writeToLog(Log::INFO, "Undo history: keeping ", maxDepth, " steps, ", memoryBudget, " bytes in memory (0 is unlimited)");
+    enforceLimits();
+    reportMetrics();
+}
+
+void SE_UndoHistory::vesselChanging(VesselSceneNode* vessel)
+{
+    //what the vessel looked like before is in the scene state already
+    touched.insert(vessel->getUID());
+}
+
+void SE_UndoHistory::updateScene()
+{
+    for (auto it = touched.begin(); it != touched.end(); ++it)
+    {
+        if (Helpers::isUIDRegistered(*it))
+            scene.set(*it, std::make_shared<const VesselSceneNodeState>(Helpers::getVesselByUID(*it)->saveState()));
+        else
+            scene.erase(*it);
+    }
+    touched.clear();
+}
+
+bool SE_UndoHistory::commit()
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    SceneState before = scene;
+    updateScene();
+    //only walks the parts of the scene state that got copied for the touched vessels
+    std::vector<SceneStateChange> changes;
+    before.diff(scene, changes);
+
+    SE_Action action;
+    for (UINT c = 0; c < changes.size(); ++c)
+    {
+        const SceneStateChange& change = changes[c];
+        if (!change.before)
         {
-            //simply create new vessel
-            VesselSceneNode* newVessel = new VesselSceneNode(it->second.state, mgr->getRootSceneNode(), mgr, VESSEL_ID);
-            break;
+            VesselOperation operation;
+            operation.type = VesselOperation::ADD;
+            operation.state = *change.after;
+            action.vessels.push_back(operation);
+            continue;
         }
-        case VesselDiffState::DiffType::DELETE:
+        if (!change.after)
         {
-            VesselSceneNode* vessel = Helpers::getVesselByUID(it->first);
-            vessel->removeAll(); //removeAll only drops children, not the node itself
-            vessel->remove(); //remove from scene graph
-            vessel->drop(); //We need the extra drop because we called VesselSceneNode, which returns a pointer
-            break;
+            VesselOperation operation;
+            operation.type = VesselOperation::DELETE;
+            operation.state = *change.before;
+            action.vessels.push_back(operation);
+            continue;
         }
-        default:
-            break;
+
+        const VesselSceneNodeState& oldState = *change.before;
+        const VesselSceneNodeState& newState = *change.after;
+        bool moved = !samePosition(oldState.pos, newState.pos);
+        bool rotated = !sameRotation(oldState.rot, newState.rot);
+        if (moved || rotated)
+        {
+            TransformOperation operation;
+            operation.type = rotated ? TransformOperation::ROTATE : TransformOperation::MOVE;
+            operation.uid = change.uid;
+            operation.oldPos = oldState.pos;
+            operation.newPos = newState.pos;
+            operation.oldRot = oldState.rot;
+            operation.newRot = newState.rot;
+            action.transforms.push_back(operation);
+        }
+        for (UINT i = 0; i < newState.dockingStatus.size() && i < oldState.dockingStatus.size(); ++i)
+        {
+            if (sameStatus(oldState.dockingStatus[i], newState.dockingStatus[i]))
+                continue;
+            PortOperation operation;
+            operation.type = newState.dockingStatus[i].docked ? PortOperation::DOCK : PortOperation::UNDOCK;
+            operation.uid = change.uid;
+            operation.port = i;
+            operation.oldStatus = oldState.dockingStatus[i];
+            operation.newStatus = newState.dockingStatus[i];
+            action.ports.push_back(operation);
         }
     }
-    for (auto it = state.begin(); it != state.end(); ++it)
+
+    Metrics::recordSample("undo.commit_us",
+        std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    if (action.isEmpty())
+    //clicked and dropped without changing anything, that's not worth an undo step
     {
-        switch (it->second.diffType)
+        Metrics::incrementCounter("undo.dropped_noops");
+        return false;
+    }
+
+    Log::writeToLog(Log::INFO, "Recorded undo step: ", action.transforms.size(), " transforms, ", action.ports.size(),
+        " port changes, ", action.vessels.size(), " vessels added or deleted, ", action.getMemorySize(), " bytes");
+    Metrics::recordSample("undo.action_ops", (double)action.getOperationCount());
+    Metrics::recordSample("undo.action_bytes", (double)action.getMemorySize());
+    push(undoSteps, action);
+
+    //doing something new destroys redo
+    dropSteps(redoSteps, redoSteps.size());
+    enforceLimits();
+    reportMetrics();
+    return true;
+}
+
+void SE_UndoHistory::discardPending()
+{
+    updateScene();
+}
+
+bool SE_UndoHistory::undo(scene::ISceneManager* mgr)
+{
+    //whatever wasn't committed yet would get mixed up with the undo
+    commit();
+    if (undoSteps.size() == 0)
+        return false;
+    SE_Action action = pop(undoSteps);
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    //the vessels report what the action does to them as usual, that only has to end up in the scene state
+    action.undo(mgr);
+    updateScene();
+    Metrics::recordSample("undo.apply_us",
+        std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    push(redoSteps, action);
+    enforceLimits();
+    reportMetrics();
+    return true;
+}
+
+bool SE_UndoHistory::redo(scene::ISceneManager* mgr)
+{
+    //if something actually changed since the undo, there's nothing left to redo
+    commit();
+    if (redoSteps.size() == 0)
+        return false;
+    SE_Action action = pop(redoSteps);
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    //the vessels report what the action does to them as usual, that only has to end up in the scene state
+    action.redo(mgr);
+    updateScene();
+    Metrics::recordSample("undo.apply_us",
+        std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    push(undoSteps, action);
+    enforceLimits();
+    reportMetrics();
+    return true;
+}
+
+void SE_UndoHistory::clear(const VesselRegistry& vessels)
+{
+    touched.clear();
+    scene = SceneState();
+    for (auto it = vessels.begin(); it != vessels.end(); ++it)
+    {
+        //the photo studio vessels aren't part of the scene
+        if (it->second->getID() == VESSEL_ID)
+            scene.set(it->first, std::make_shared<const VesselSceneNodeState>(it->second->saveState()));
+    }
+    undoSteps.clear();
+    redoSteps.clear();
+    memorySize = 0;
+    closeSpillFile();
+    spillFailed = false;
+    reportMetrics();
+}
+
+const SceneState& SE_UndoHistory::getScene() const
+{
+    return scene;
+}
+
+bool SE_UndoHistory::differsFrom(const SceneState& snapshot) const
+{
+    if (scene.isSameAs(snapshot))
+        return false;
+    std::vector<SceneStateChange> changes;
+    snapshot.diff(scene, changes);
+    for (UINT i = 0; i < changes.size(); ++i)
+    {
+        const SceneStateChange& change = changes[i];
+        if (!change.before || !change.after)
+            return true;
+        if (!samePosition(change.before->pos, change.after->pos) || !sameRotation(change.before->rot, change.after->rot))
+            return true;
+        for (UINT j = 0; j < change.before->dockingStatus.size() && j < change.after->dockingStatus.size(); ++j)
         {
-        case VesselDiffState::DiffType::UPDATE:
-            Log::writeToLog(Log::L_DEBUG, "DiffState: Updating vessel, uid: ", it->first);
-            //find current existing vessel and update it
-            Helpers::getVesselByUID(it->first)->loadState(it->second.state);
+            if (!sameStatus(change.before->dockingStatus[j], change.after->dockingStatus[j]))
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t SE_UndoHistory::getUndoDepth() const
+{
+    return undoSteps.size();
+}
+
+size_t SE_UndoHistory::getMemorySize() const
+{
+    return memorySize;
+}
+
+void SE_UndoHistory::reportMetrics()
+{
+    Metrics::setGauge("undo.depth", (double)undoSteps.size());
+    Metrics::setGauge("undo.bytes", (double)memorySize);
+    Metrics::setGauge("undo.spilled_bytes", (double)spilledBytes);
+}
+
+void SE_UndoHistory::push(std::deque<SE_StoredAction>& steps, const SE_Action& action)
+{
+    steps.push_back(SE_StoredAction());
+    steps.back().action = action;
+    memorySize += steps.back().getMemorySize();
+}
+
+SE_Action SE_UndoHistory::pop(std::deque<SE_StoredAction>& steps)
+{
+    SE_StoredAction& entry = steps.back();
+    SE_Action action;
+    if (entry.storage == SE_StoredAction::LIVE)
+        action = entry.action;
+    else
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        if (entry.storage == SE_StoredAction::SPILLED)
+        {
+            std::vector<unsigned char> data(entry.spillSize);
+            if (fseek(spillFile, entry.spillOffset, SEEK_SET) != 0 || fread(data.data(), 1, data.size(), spillFile) != data.size())
+                throw std::runtime_error("Couldn't read undo step back from the spill file");
+            action = SE_Action::unpack(data);
+        }
+        else
+            action = SE_Action::unpack(entry.packed);
+        Metrics::recordSample("undo.reload_us",
+            std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    memorySize -= entry.getMemorySize();
+    if (entry.storage == SE_StoredAction::SPILLED)
+    {
+        spilledSteps--;
+        spilledBytes -= entry.spillSize;
+    }
+    steps.pop_back();
+    if (spilledSteps == 0)
+        spillEnd = 0;
+    return action;
+}
+
+//drops the oldest steps
+void SE_UndoHistory::dropSteps(std::deque<SE_StoredAction>& steps, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SE_StoredAction& entry = steps.front();
+        memorySize -= entry.getMemorySize();
+        if (entry.storage == SE_StoredAction::SPILLED)
+        {
+            spilledSteps--;
+            spilledBytes -= entry.spillSize;
+        }
+        steps.pop_front();
+    }
+    if (spilledSteps == 0)
+        spillEnd = 0;
+}
+
+void SE_UndoHistory::enforceLimits()
+{
+    if (maxDepth > 0 && undoSteps.size() > maxDepth)
+    {
+        Metrics::incrementCounter("undo.dropped_steps", (double)(undoSteps.size() - maxDepth));
+        dropSteps(undoSteps, undoSteps.size() - maxDepth);
+    }
+    packOlderSteps(undoSteps);
+    packOlderSteps(redoSteps);
+    //the undo steps furthest back go first, then the redo steps furthest ahead
+    while (memoryBudget > 0 && memorySize > memoryBudget)
+    {
+        if (!spillOldestStep(undoSteps) && !spillOldestStep(redoSteps))
             break;
-        default:
+    }
+}
+
+void SE_UndoHistory::packOlderSteps(std::deque<SE_StoredAction>& steps)
+{
+    if (steps.size() <= liveSteps)
+        return;
+    //the front is the oldest, everything up to the last liveSteps gets packed
+    for (size_t i = steps.size() - liveSteps; i-- > 0;)
+    {
+        SE_StoredAction& entry = steps[i];
+        if (entry.storage != SE_StoredAction::LIVE)
+            //older steps were packed before this one
             break;
+        size_t liveSize = entry.getMemorySize();
+        entry.action.pack(entry.packed);
+        entry.packed.shrink_to_fit();
+        Metrics::recordSample("undo.pack_ratio", (double)entry.packed.size() / (double)liveSize);
+        entry.action = SE_Action();
+        entry.storage = SE_StoredAction::PACKED;
+        memorySize = memorySize - liveSize + entry.getMemorySize();
+    }
+}
+
+bool SE_UndoHistory::spillOldestStep(std::deque<SE_StoredAction>& steps)
+{
+    if (spillFailed)
+        return false;
+    size_t i = 0;
+    while (i < steps.size() && steps[i].storage == SE_StoredAction::SPILLED)
+        ++i;
+    if (i == steps.size() || steps[i].storage != SE_StoredAction::PACKED)
+        //only live steps left, those stay in memory
+        return false;
+
+    if (spillFile == NULL)
+    {
+        //deleted by the system once it gets closed
+        spillFile = tmpfile();
+        if (spillFile == NULL)
+        {
+            Log::writeToLog(Log::WARN, "Couldn't create a temporary file for the undo history, keeping it in memory");
+            spillFailed = true;
+            return false;
         }
     }
 
+    SE_StoredAction& entry = steps[i];
+    if (fseek(spillFile, spillEnd, SEEK_SET) != 0 || fwrite(entry.packed.data(), 1, entry.packed.size(), spillFile) != entry.packed.size())
+    {
+        Log::writeToLog(Log::ERR, "Couldn't write to the undo history spill file, keeping the history in memory");
+        spillFailed = true;
+        return false;
+    }
+    size_t packedSize = entry.getMemorySize();
+    entry.spillOffset = spillEnd;
+    entry.spillSize = entry.packed.size();
+    entry.storage = SE_StoredAction::SPILLED;
+    std::vector<unsigned char>().swap(entry.packed);
+    memorySize = memorySize - packedSize + entry.getMemorySize();
+    spillEnd += entry.spillSize;
+    spilledSteps++;
+    spilledBytes += entry.spillSize;
+    return true;
+}
+
+void SE_UndoHistory::closeSpillFile()
+{
+    if (spillFile != NULL)
+        fclose(spillFile);
+    spillFile = NULL;
+    spillEnd = 0;
+    spilledSteps = 0;
+    spilledBytes = 0;
 }
@@ -2,36 +2,147 @@
 //The MIT License - See ../../LICENSE for more info
 #pragma once
 
-#include <map>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <unordered_set>
 #include <irrlicht.h>
 
 #include "Helpers.h"
 #include "VesselSceneNode.h"
+#include "VesselRegistry.h"
+#include "SceneState.h"
 
 #undef DELETE //because some random windows header defines this
 
-class SE_GlobalState
+//a vessel that moved. MOVE only changes the position, ROTATE the rotation and usually the position as well
+struct TransformOperation
 {
-public:
-    SE_GlobalState() {}
-    SE_GlobalState(const std::map<UINT, VesselSceneNode*>& vessels);
-    void apply(scene::ISceneManager* mgr);
-    std::map<UINT, VesselSceneNodeState> state;
+    enum OperationType { MOVE, ROTATE };
+    OperationType type;
+    UINT uid;
+    core::vector3df oldPos, newPos, oldRot, newRot;
+};
+
+//a single docking port that got docked or undocked. the port on the other end has an operation of its own
+struct PortOperation
+{
+    enum OperationType { DOCK, UNDOCK };
+    OperationType type;
+    UINT uid;
+    UINT port;
+    DockingPortStatus oldStatus, newStatus;
 };
 
-struct VesselDiffState
+//a vessel that was created or deleted. ADD keeps the state it was created with, DELETE the one it had before
+struct VesselOperation
 {
-    enum DiffType { ADD, UPDATE, DELETE };
-    DiffType diffType;
+    enum OperationType { ADD, DELETE };
+    OperationType type;
     VesselSceneNodeState state;
 };
 
-class SE_DiffState
+//everything that changed between two undo steps, only for the vessels that were actually touched
+class SE_Action
+{
+public:
+    void undo(scene::ISceneManager* mgr);
+    void redo(scene::ISceneManager* mgr);
+    bool isEmpty() const;
+    size_t getOperationCount() const;
+    size_t getMemorySize() const;          //approximate memory used by this action
+
+    //packs the action into a byte stream and back. the packed form is only meant for this session,
+    //it references vessel classes by their address in the DataManager. unpack throws if the data is damaged
+    void pack(std::vector<unsigned char>& out) const;
+    static SE_Action unpack(const std::vector<unsigned char>& data);
+
+    std::vector<TransformOperation> transforms;
+    std::vector<PortOperation> ports;
+    std::vector<VesselOperation> vessels;
+
+private:
+    void apply(scene::ISceneManager* mgr, bool backwards);
+};
+
+//an undo step as the history keeps it. recent steps stay LIVE, older ones get PACKED,
+//and when the history grows past its memory budget the oldest packed ones go to the spill file
+struct SE_StoredAction
+{
+    enum StorageType { LIVE, PACKED, SPILLED };
+    SE_StoredAction() : storage(LIVE), spillOffset(0), spillSize(0) {}
+    size_t getMemorySize() const;
+
+    StorageType storage;
+    SE_Action action;                       //only valid while LIVE
+    std::vector<unsigned char> packed;      //only valid while PACKED
+    long spillOffset;                       //only valid while SPILLED
+    unsigned int spillSize;
+};
+
+//records what happens to vessels between two calls to commit() and turns it into an SE_Action.
+//the history keeps the state of the scene as of the last commit in a SceneState. vessels report themselves before
+//they change, and commit only puts the new states of those vessels in and compares the parts of the SceneState that changed.
+//so the cost of an action depends on what it touched, not on the size of the scene, and a snapshot of the scene is free
+class SE_UndoHistory
 {
 public:
-    SE_DiffState(const SE_GlobalState& oldState, const SE_GlobalState& newState);
-    void apply(scene::ISceneManager* mgr);
+    SE_UndoHistory();
+    ~SE_UndoHistory();
+
+    //maxDepth is the number of undo steps kept, memoryBudget the bytes the history may take up before
+    //old steps get written to disk. 0 means no limit for both
+    void setLimits(size_t maxDepth, size_t memoryBudget);
+
+    //called by the vessels when they are created, and before they move, get deleted or change a docking port
+    void vesselChanging(VesselSceneNode* vessel);
+
+    //turns everything recorded since the last commit into an undo step. returns false if nothing actually changed
+    bool commit();
+    //takes what has been recorded since the last commit into the scene state, without making an undo step of it
+    void discardPending();
+    //these throw if the scene doesn't match the history anymore
+    bool undo(scene::ISceneManager* mgr);
+    bool redo(scene::ISceneManager* mgr);
+    //forgets all undo steps, and takes the scene state from the vessels as they are now
+    void clear(const VesselRegistry& vessels);
+
+    //the scene as of the last commit. keeping the copy around is all it takes to make a snapshot
+    const SceneState& getScene() const;
+    //compares the scene with an earlier snapshot, ignoring differences too small to be edits
+    bool differsFrom(const SceneState& snapshot) const;
+
+    size_t getUndoDepth() const;
+    size_t getMemorySize() const;           //bytes in memory, not counting what has been spilled
 
 private:
-    std::map <UINT, VesselDiffState> state;
+    //puts the current state of all touched vessels into the scene state
+    void updateScene();
+    void reportMetrics();
+    void push(std::deque<SE_StoredAction>& steps, const SE_Action& action);
+    //takes the newest step off, loading it back if it was packed or spilled
+    SE_Action pop(std::deque<SE_StoredAction>& steps);
+    void dropSteps(std::deque<SE_StoredAction>& steps, size_t count);
+    void enforceLimits();
+    void packOlderSteps(std::deque<SE_StoredAction>& steps);
+    bool spillOldestStep(std::deque<SE_StoredAction>& steps);
+    void closeSpillFile();
+
+    //this many of the newest undo and redo steps are never packed, so undoing and redoing them stays instant
+    static const size_t liveSteps = 16;
+
+    std::unordered_set<UINT> touched;
+    SceneState scene;
+    std::deque<SE_StoredAction> undoSteps;
+    std::deque<SE_StoredAction> redoSteps;
+    size_t memorySize;
+    size_t maxDepth;
+    size_t memoryBudget;
+
+    //spilled steps are only ever appended. once none of them are left, the file gets reused from the start
+    FILE* spillFile;
+    long spillEnd;
+    size_t spilledSteps;
+    size_t spilledBytes;
+    bool spillFailed;                        //so a missing temp directory only gets logged once
 };
@@ -0,0 +1,555 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "ScenePickingTree.h"
+#include "VesselSceneNode.h"
+#include "DockingPortMarkers.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+std::map<scene::ISceneManager*, ScenePickingTree*> ScenePickingTree::trees;
+const f32 ScenePickingTree::margin = 2.0f;
+
+static core::aabbox3d<f32> mergeBoxes(const core::aabbox3d<f32>& a, const core::aabbox3d<f32>& b)
+{
+	core::aabbox3d<f32> result = a;
+	result.addInternalBox(b);
+	return result;
+}
+
+//surface area, the cost used to decide where a leaf goes
+static f32 boxArea(const core::aabbox3d<f32>& box)
+{
+	core::vector3df extent = box.getExtent();
+	return 2.0f * (extent.X * extent.Y + extent.Y * extent.Z + extent.Z * extent.X);
+}
+
+static bool boxContains(const core::aabbox3d<f32>& outer, const core::aabbox3d<f32>& inner)
+{
+	return outer.isPointInside(inner.MinEdge) && outer.isPointInside(inner.MaxEdge);
+}
+
+ScenePickingTree* ScenePickingTree::getTree(scene::ISceneManager* mgr)
+{
+	std::map<scene::ISceneManager*, ScenePickingTree*>::iterator pos = trees.find(mgr);
+	if (pos != trees.end())
+		return pos->second;
+
+	ScenePickingTree* tree = new ScenePickingTree(mgr->getRootSceneNode(), mgr);
+	//the root node holds the tree from now on
+	tree->drop();
+	return tree;
+}
+
+//the id is 0, so id masked scene node picking never returns the tree
+ScenePickingTree::ScenePickingTree(scene::ISceneNode* parent, scene::ISceneManager* mgr)
+	: scene::ISceneNode(parent, mgr, 0), root(-1), freeList(-1)
+{
+	setAutomaticCulling(scene::EAC_OFF);
+	trees[mgr] = this;
+}
+
+ScenePickingTree::~ScenePickingTree()
+{
+	trees.erase(SceneManager);
+}
+
+void ScenePickingTree::addVessel(VesselSceneNode* vessel)
+{
+	std::vector<int>& vesselProxies = proxies[vessel];
+	vesselProxies.push_back(createProxy(vessel, -1));
+	for (UINT i = 0; i < vessel->dockingPorts.size(); i++)
+		vesselProxies.push_back(createProxy(vessel, i));
+	freePorts.updateVessel(vessel);
+}
+
+void ScenePickingTree::removeVessel(VesselSceneNode* vessel)
+{
+	std::map<VesselSceneNode*, std::vector<int> >::iterator pos = proxies.find(vessel);
+	if (pos == proxies.end())
+		return;
+	for (UINT i = 0; i < pos->second.size(); i++)
+		destroyProxy(pos->second[i]);
+	proxies.erase(pos);
+	freePorts.removeVessel(vessel);
+	movedVessels.erase(std::remove(movedVessels.begin(), movedVessels.end(), vessel), movedVessels.end());
+}
+
+void ScenePickingTree::markMoved(VesselSceneNode* vessel)
+{
+	if (std::find(movedVessels.begin(), movedVessels.end(), vessel) == movedVessels.end())
+		movedVessels.push_back(vessel);
+}
+
+void ScenePickingTree::refit()
+{
+	for (UINT i = 0; i < movedVessels.size(); i++)
+	{
+		std::map<VesselSceneNode*, std::vector<int> >::iterator pos = proxies.find(movedVessels[i]);
+		if (pos == proxies.end())
+			continue;
+		for (UINT j = 0; j < pos->second.size(); j++)
+			moveProxy(pos->second[j]);
+		freePorts.updateVessel(movedVessels[i]);
+	}
+	movedVessels.clear();
+}
+
+core::aabbox3d<f32> ScenePickingTree::getProxyBox(VesselSceneNode* vessel, int portID)
+{
+	if (portID == -1)
+		return vessel->getTransformedBoundingBox();
+	core::vector3df position = vessel->getDockingPortAbsolutePosition(portID);
+	core::vector3df radius(DockingPortMarkerRenderer::markerRadius);
+	return core::aabbox3d<f32>(position - radius, position + radius);
+}
+
+int ScenePickingTree::createProxy(VesselSceneNode* vessel, int portID)
+{
+	int proxy = allocateNode();
+	nodes[proxy].vessel = vessel;
+	nodes[proxy].portID = portID;
+	nodes[proxy].box = getProxyBox(vessel, portID);
+	nodes[proxy].box.MinEdge -= core::vector3df(margin);
+	nodes[proxy].box.MaxEdge += core::vector3df(margin);
+	nodes[proxy].height = 0;
+	insertLeaf(proxy);
+	return proxy;
+}
+
+void ScenePickingTree::destroyProxy(int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+}
+
+void ScenePickingTree::moveProxy(int proxy)
+{
+	core::aabbox3d<f32> tightBox = getProxyBox(nodes[proxy].vessel, nodes[proxy].portID);
+	//still inside the enlarged box, nothing to do
+	if (boxContains(nodes[proxy].box, tightBox))
+		return;
+	removeLeaf(proxy);
+	nodes[proxy].box = tightBox;
+	nodes[proxy].box.MinEdge -= core::vector3df(margin);
+	nodes[proxy].box.MaxEdge += core::vector3df(margin);
+	insertLeaf(proxy);
+}
+
+int ScenePickingTree::allocateNode()
+{
+	if (freeList == -1)
+	{
+		PickingTreeNode node;
+		node.parent = freeList;
+		node.height = -1;
+		nodes.push_back(node);
+		freeList = nodes.size() - 1;
+	}
+	int index = freeList;
+	freeList = nodes[index].parent;
+	nodes[index].parent = -1;
+	nodes[index].child1 = -1;
+	nodes[index].child2 = -1;
+	nodes[index].height = 0;
+	nodes[index].vessel = 0;
+	nodes[index].portID = -1;
+	return index;
+}
+
+void ScenePickingTree::freeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	nodes[node].vessel = 0;
+	freeList = node;
+}
+
+//walks down the tree to the sibling that increases the total surface area the least
+void ScenePickingTree::insertLeaf(int leaf)
+{
+	if (root == -1)
+	{
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	core::aabbox3d<f32> leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].isLeaf())
+	{
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		f32 area = boxArea(nodes[index].box);
+		f32 combinedArea = boxArea(mergeBoxes(nodes[index].box, leafBox));
+		//cost of making a new parent for this node and the leaf
+		f32 cost = 2.0f * combinedArea;
+		//the minimum cost of pushing the leaf further down
+		f32 inheritanceCost = 2.0f * (combinedArea - area);
+
+		f32 cost1 = boxArea(mergeBoxes(leafBox, nodes[child1].box)) + inheritanceCost;
+		if (!nodes[child1].isLeaf())
+			cost1 -= boxArea(nodes[child1].box);
+		f32 cost2 = boxArea(mergeBoxes(leafBox, nodes[child2].box)) + inheritanceCost;
+		if (!nodes[child2].isLeaf())
+			cost2 -= boxArea(nodes[child2].box);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = mergeBoxes(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != -1)
+	{
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else
+		root = newParent;
+
+	//fix heights and boxes on the way back up
+	index = nodes[leaf].parent;
+	while (index != -1)
+	{
+		index = balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = mergeBoxes(nodes[child1].box, nodes[child2].box);
+		index = nodes[index].parent;
+	}
+}
+
+void ScenePickingTree::removeLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != -1)
+	{
+		//the sibling takes the place of the parent
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		int index = grandParent;
+		while (index != -1)
+		{
+			index = balance(index);
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+			nodes[index].box = mergeBoxes(nodes[child1].box, nodes[child2].box);
+			nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+			index = nodes[index].parent;
+		}
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = -1;
+		freeNode(parent);
+	}
+	nodes[leaf].parent = -1;
+}
+
+//rotates the taller child up if the subtree under a is out of balance. returns the new root of the subtree
+int ScenePickingTree::balance(int a)
+{
+	PickingTreeNode& nodeA = nodes[a];
+	if (nodeA.isLeaf() || nodeA.height < 2)
+		return a;
+
+	int b = nodeA.child1;
+	int c = nodeA.child2;
+	PickingTreeNode& nodeB = nodes[b];
+	PickingTreeNode& nodeC = nodes[c];
+	int heightDifference = nodeC.height - nodeB.height;
+
+	if (heightDifference > 1)
+	//rotate c up
+	{
+		int f = nodeC.child1;
+		int g = nodeC.child2;
+		PickingTreeNode& nodeF = nodes[f];
+		PickingTreeNode& nodeG = nodes[g];
+
+		nodeC.child1 = a;
+		nodeC.parent = nodeA.parent;
+		nodeA.parent = c;
+		if (nodeC.parent != -1)
+		{
+			if (nodes[nodeC.parent].child1 == a)
+				nodes[nodeC.parent].child1 = c;
+			else
+				nodes[nodeC.parent].child2 = c;
+		}
+		else
+			root = c;
+
+		if (nodeF.height > nodeG.height)
+		{
+			nodeC.child2 = f;
+			nodeA.child2 = g;
+			nodeG.parent = a;
+			nodeA.box = mergeBoxes(nodeB.box, nodeG.box);
+			nodeC.box = mergeBoxes(nodeA.box, nodeF.box);
+			nodeA.height = 1 + std::max(nodeB.height, nodeG.height);
+			nodeC.height = 1 + std::max(nodeA.height, nodeF.height);
+		}
+		else
+		{
+			nodeC.child2 = g;
+			nodeA.child2 = f;
+			nodeF.parent = a;
+			nodeA.box = mergeBoxes(nodeB.box, nodeF.box);
+			nodeC.box = mergeBoxes(nodeA.box, nodeG.box);
+			nodeA.height = 1 + std::max(nodeB.height, nodeF.height);
+			nodeC.height = 1 + std::max(nodeA.height, nodeG.height);
+		}
+		return c;
+	}
+
+	if (heightDifference < -1)
+	//rotate b up
+	{
+		int d = nodeB.child1;
+		int e = nodeB.child2;
+		PickingTreeNode& nodeD = nodes[d];
+		PickingTreeNode& nodeE = nodes[e];
+
+		nodeB.child1 = a;
+		nodeB.parent = nodeA.parent;
+		nodeA.parent = b;
+		if (nodeB.parent != -1)
+		{
+			if (nodes[nodeB.parent].child1 == a)
+				nodes[nodeB.parent].child1 = b;
+			else
+				nodes[nodeB.parent].child2 = b;
+		}
+		else
+			root = b;
+
+		if (nodeD.height > nodeE.height)
+		{
+			nodeB.child2 = d;
+			nodeA.child1 = e;
+			nodeE.parent = a;
+			nodeA.box = mergeBoxes(nodeC.box, nodeE.box);
+			nodeB.box = mergeBoxes(nodeA.box, nodeD.box);
+			nodeA.height = 1 + std::max(nodeC.height, nodeE.height);
+			nodeB.height = 1 + std::max(nodeA.height, nodeD.height);
+		}
+		else
+		{
+			nodeB.child2 = e;
+			nodeA.child1 = d;
+			nodeD.parent = a;
+			nodeA.box = mergeBoxes(nodeC.box, nodeD.box);
+			nodeB.box = mergeBoxes(nodeA.box, nodeE.box);
+			nodeA.height = 1 + std::max(nodeC.height, nodeD.height);
+			nodeB.height = 1 + std::max(nodeA.height, nodeE.height);
+		}
+		return b;
+	}
+	return a;
+}
+
+//slab test. t is measured along direction, so 1 is the end of the ray
+bool ScenePickingTree::intersectRayBox(const core::vector3df& start, const core::vector3df& direction,
+	const core::aabbox3d<f32>& box, f32 maxT, f32& entryT)
+{
+	f32 tMin = 0;
+	f32 tMax = maxT;
+	const f32 origin[3] = { start.X, start.Y, start.Z };
+	const f32 dir[3] = { direction.X, direction.Y, direction.Z };
+	const f32 boxMin[3] = { box.MinEdge.X, box.MinEdge.Y, box.MinEdge.Z };
+	const f32 boxMax[3] = { box.MaxEdge.X, box.MaxEdge.Y, box.MaxEdge.Z };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (fabs(dir[axis]) < 1e-12f)
+		{
+			//parallel to the slab, has to start inside it
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+				return false;
+			continue;
+		}
+		f32 inverse = 1.0f / dir[axis];
+		f32 t1 = (boxMin[axis] - origin[axis]) * inverse;
+		f32 t2 = (boxMax[axis] - origin[axis]) * inverse;
+		if (t1 > t2)
+			std::swap(t1, t2);
+		tMin = std::max(tMin, t1);
+		tMax = std::min(tMax, t2);
+		if (tMin > tMax)
+			return false;
+	}
+	entryT = tMin;
+	return true;
+}
+
+VesselSceneNode* ScenePickingTree::pickVessel(const core::line3df& ray)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	refit();
+
+	VesselSceneNode* closest = 0;
+	//the tree only narrows down the candidates. the ray is brought into mesh coordinates and tested against
+	//the untransformed box first, then against the actual triangles, so overlapping boxes don't steal the pick
+	auto visitor = [&](const PickingTreeNode& leaf, f32& maxT)
+	{
+		if (leaf.portID != -1 || !leaf.vessel->isTrulyVisible())
+			return;
+		core::matrix4 inverse(leaf.vessel->getAbsoluteTransformation(), core::matrix4::EM4CONST_INVERSE);
+		core::vector3df localStart = ray.start;
+		core::vector3df localEnd = ray.end;
+		inverse.transformVect(localStart);
+		inverse.transformVect(localEnd);
+		core::vector3df localDirection = localEnd - localStart;
+		f32 entryT;
+		//t is the same in both spaces, the transformation is affine
+		if (!intersectRayBox(localStart, localDirection, leaf.vessel->getBoundingBox(), maxT, entryT))
+			return;
+		MeshBVH* meshBVH = leaf.vessel->returnVesselData()->vesselMesh->getPickingBVH();
+		if (meshBVH != 0 && meshBVH->getTriangleCount() > 0)
+		{
+			f32 hitT;
+			if (!meshBVH->intersectRay(localStart, localDirection, maxT, hitT))
+				return;
+			entryT = hitT;
+		}
+		maxT = entryT;
+		closest = leaf.vessel;
+	};
+	rayCast(ray.start, ray.getVector(), visitor);
+
+	Metrics::recordSample("picking.query_us", std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::high_resolution_clock::now() - startTime).count());
+	return closest;
+}
+
+OrbiterDockingPort* ScenePickingTree::pickDockingPort(const core::line3df& ray, u32 markerMask)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	refit();
+
+	core::vector3df direction = ray.getVector();
+	f32 rayLengthSQ = direction.getLengthSQ();
+	if (rayLengthSQ == 0)
+		return 0;
+	const f32 radius = DockingPortMarkerRenderer::markerRadius;
+	DockingPortMarkerRenderer* markers = DockingPortMarkerRenderer::getRenderer(SceneManager);
+
+	OrbiterDockingPort* closest = 0;
+	auto visitor = [&](const PickingTreeNode& leaf, f32& maxT)
+	{
+		if (leaf.portID == -1)
+			return;
+		OrbiterDockingPort* port = &leaf.vessel->dockingPorts[leaf.portID];
+		if ((markers->getFlags(port->markerIndex) & markerMask) == 0)
+			return;
+		//ray-sphere test, in units of the ray length so it compares with maxT
+		core::vector3df toCenter = leaf.vessel->getDockingPortAbsolutePosition(leaf.portID) - ray.start;
+		f32 along = toCenter.dotProduct(direction) / rayLengthSQ;
+		if (along < 0)
+			return;
+		f32 distSQ = (toCenter - direction * along).getLengthSQ();
+		if (distSQ > radius * radius)
+			return;
+		f32 entry = along - sqrtf((radius * radius - distSQ) / rayLengthSQ);
+		//the camera may sit inside the marker
+		if (entry < 0)
+			entry = 0;
+		if (entry < maxT)
+		{
+			maxT = entry;
+			closest = port;
+		}
+	};
+	rayCast(ray.start, direction, visitor);
+
+	Metrics::recordSample("picking.query_us", std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::high_resolution_clock::now() - startTime).count());
+	return closest;
+}
+
+void ScenePickingTree::queryVessels(const core::aabbox3d<f32>& queryBox, std::vector<VesselSceneNode*>& results)
+{
+	refit();
+	results.clear();
+	if (root == -1)
+		return;
+	std::vector<int> stack;
+	stack.push_back(root);
+	while (stack.size() > 0)
+	{
+		int index = stack.back();
+		stack.pop_back();
+		if (!nodes[index].box.intersectsWithBox(queryBox))
+			continue;
+		if (!nodes[index].isLeaf())
+		{
+			stack.push_back(nodes[index].child1);
+			stack.push_back(nodes[index].child2);
+		}
+		//leaf boxes are enlarged, check the actual box
+		else if (nodes[index].portID == -1 && nodes[index].vessel->getTransformedBoundingBox().intersectsWithBox(queryBox))
+			results.push_back(nodes[index].vessel);
+	}
+}
+
+void ScenePickingTree::findNearestFreePorts(const core::vector3df& position, u32 count,
+	const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<OrbiterDockingPort*>& results)
+{
+	refit();
+	freePorts.findNearest(position, count, filter, results);
+}
+
+void ScenePickingTree::findCoincidentFreePorts(f32 maxDistance, const std::function<bool(OrbiterDockingPort*, OrbiterDockingPort*)>& filter,
+	std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> >& pairs)
+{
+	refit();
+	freePorts.findCoincidentPairs(std::min(maxDistance, freePorts.getCellSize()), filter, pairs);
+}
+
+//the tree draws nothing, it is only a scene node so it lives and dies with the scene like the other helpers
+void ScenePickingTree::OnRegisterSceneNode()
+{
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void ScenePickingTree::render()
+{
+}
+
+const core::aabbox3d<f32>& ScenePickingTree::getBoundingBox() const
+{
+	return box;
+}
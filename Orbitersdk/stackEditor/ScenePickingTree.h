@@ -0,0 +1,120 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+
+#include "FreePortHash.h"
+
+using namespace irr;
+
+class VesselSceneNode;
+struct OrbiterDockingPort;
+
+//node of the picking tree. leaves hold either a vessel or one of its docking ports
+struct PickingTreeNode
+{
+	core::aabbox3d<f32> box;		//enlarged by the margin for leaves, so small moves don't need a reinsert
+	int parent;						//next free node while the node is unused
+	int child1, child2;
+	int height;						//0 for leaves, -1 for free nodes
+	VesselSceneNode* vessel;
+	int portID;						//-1 for the vessel itself
+
+	bool isLeaf() const { return child1 == -1; }
+};
+
+//dynamic bounding volume hierarchy over the world boxes of all vessels and docking ports of a scene manager.
+//vessels mark themselves as moved when their absolute transformation changes, the tree refits them
+//lazily before the next query. picking is a ray query against the tree followed by an exact test of the hit leaves,
+//down to the triangles of the vessel mesh
+class ScenePickingTree : public scene::ISceneNode
+{
+public:
+	//returns the tree of the passed scene manager, creating it if it doesn't exist yet
+	static ScenePickingTree* getTree(scene::ISceneManager* mgr);
+
+	~ScenePickingTree();
+
+	void addVessel(VesselSceneNode* vessel);
+	void removeVessel(VesselSceneNode* vessel);
+	//the vessel moved or one of its ports got docked or undocked, its proxies get refit before the next query
+	void markMoved(VesselSceneNode* vessel);
+
+	//returns the visible vessel whose mesh is hit first by the ray, or 0
+	VesselSceneNode* pickVessel(const core::line3df& ray);
+	//returns the port whose marker is shown with one of the flags in markerMask and is hit first by the ray, or 0
+	OrbiterDockingPort* pickDockingPort(const core::line3df& ray, u32 markerMask);
+	//fills results with all vessels whose world bounding box intersects the passed box
+	void queryVessels(const core::aabbox3d<f32>& queryBox, std::vector<VesselSceneNode*>& results);
+	//fills results with up to count free ports accepted by filter, closest to position in world space first
+	void findNearestFreePorts(const core::vector3df& position, u32 count,
+		const std::function<bool(OrbiterDockingPort*)>& filter, std::vector<OrbiterDockingPort*>& results);
+	//see FreePortHash::findCoincidentPairs
+	void findCoincidentFreePorts(f32 maxDistance, const std::function<bool(OrbiterDockingPort*, OrbiterDockingPort*)>& filter,
+		std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> >& pairs);
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+	virtual const core::aabbox3d<f32>& getBoundingBox() const;
+
+	static const f32 margin;
+
+private:
+	ScenePickingTree(scene::ISceneNode* parent, scene::ISceneManager* mgr);
+
+	void refit();
+	core::aabbox3d<f32> getProxyBox(VesselSceneNode* vessel, int portID);
+	int createProxy(VesselSceneNode* vessel, int portID);
+	void destroyProxy(int proxy);
+	void moveProxy(int proxy);
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+
+	//calls visitor(leaf, maxT) for every leaf whose box is hit by the ray before maxT. the visitor may lower maxT
+	template <class Visitor>
+	void rayCast(const core::vector3df& start, const core::vector3df& direction, Visitor& visitor);
+	static bool intersectRayBox(const core::vector3df& start, const core::vector3df& direction,
+		const core::aabbox3d<f32>& box, f32 maxT, f32& entryT);
+
+	std::vector<PickingTreeNode> nodes;
+	int root;
+	int freeList;
+	std::vector<VesselSceneNode*> movedVessels;
+	std::map<VesselSceneNode*, std::vector<int> > proxies;		//vessel proxy first, then one per port
+	FreePortHash freePorts;
+	core::aabbox3d<f32> box;
+
+	static std::map<scene::ISceneManager*, ScenePickingTree*> trees;
+};
+
+template <class Visitor>
+void ScenePickingTree::rayCast(const core::vector3df& start, const core::vector3df& direction, Visitor& visitor)
+{
+	if (root == -1)
+		return;
+	f32 maxT = 1.0f;
+	std::vector<int> stack;
+	stack.push_back(root);
+	while (stack.size() > 0)
+	{
+		int index = stack.back();
+		stack.pop_back();
+		f32 entryT;
+		if (!intersectRayBox(start, direction, nodes[index].box, maxT, entryT))
+			continue;
+		if (nodes[index].isLeaf())
+			visitor(nodes[index], maxT);
+		else
+		{
+			stack.push_back(nodes[index].child1);
+			stack.push_back(nodes[index].child2);
+		}
+	}
+}
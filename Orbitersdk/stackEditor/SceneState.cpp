@@ -0,0 +1,148 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "SceneState.h"
+#include <algorithm>
+
+SceneState::SceneState() : height(1), vesselCount(0)
+{
+}
+
+unsigned int SceneState::slotIndex(UINT uid, unsigned int level)
+{
+	return (uid >> (bitsPerLevel * (level - 1))) & (fanOut - 1);
+}
+
+VesselStatePtr SceneState::get(UINT uid) const
+{
+	if (bitsPerLevel * height < 32 && (uid >> (bitsPerLevel * height)) != 0)
+		return VesselStatePtr();
+	const Node* node = static_cast<const Node*>(root.get());
+	for (unsigned int level = height; node != 0 && level > 1; --level)
+		node = static_cast<const Node*>(node->slots[slotIndex(uid, level)].get());
+	if (node == 0)
+		return VesselStatePtr();
+	return std::static_pointer_cast<const VesselSceneNodeState>(node->slots[slotIndex(uid, 1)]);
+}
+
+void SceneState::set(UINT uid, const VesselStatePtr& state)
+{
+	//new vessels count their UIDs up, so the trie grows on top now and then
+	while (bitsPerLevel * height < 32 && (uid >> (bitsPerLevel * height)) != 0)
+	{
+		if (root)
+		{
+			std::shared_ptr<Node> newRoot = std::make_shared<Node>();
+			newRoot->slots[0] = root;
+			root = newRoot;
+		}
+		height++;
+	}
+
+	bool existed = get(uid) != 0;
+	root = setIn(root, height, uid, state);
+	if (existed && !state)
+		vesselCount--;
+	else if (!existed && state)
+		vesselCount++;
+}
+
+void SceneState::erase(UINT uid)
+{
+	if (get(uid))
+		set(uid, VesselStatePtr());
+}
+
+//copies the node and puts the state, or the copy of the next node down, in its place. returns an empty slot if nothing is left in it
+SceneState::Slot SceneState::setIn(const Slot& node, unsigned int level, UINT uid, const VesselStatePtr& state)
+{
+	std::shared_ptr<Node> copy = node ? std::make_shared<Node>(*static_cast<const Node*>(node.get())) : std::make_shared<Node>();
+	unsigned int slot = slotIndex(uid, level);
+	if (level == 1)
+		copy->slots[slot] = state;
+	else
+		copy->slots[slot] = setIn(copy->slots[slot], level - 1, uid, state);
+
+	for (unsigned int i = 0; i < fanOut; ++i)
+	{
+		if (copy->slots[i])
+			return copy;
+	}
+	return Slot();
+}
+
+size_t SceneState::size() const
+{
+	return vesselCount;
+}
+
+bool SceneState::isSameAs(const SceneState& other) const
+{
+	return root == other.root && height == other.height;
+}
+
+SceneState::Slot SceneState::liftedRoot(unsigned int toHeight) const
+{
+	Slot lifted = root;
+	for (unsigned int level = height; level < toHeight && lifted; ++level)
+	{
+		std::shared_ptr<Node> node = std::make_shared<Node>();
+		node->slots[0] = lifted;
+		lifted = node;
+	}
+	return lifted;
+}
+
+void SceneState::diff(const SceneState& other, std::vector<SceneStateChange>& changes) const
+{
+	unsigned int commonHeight = std::max(height, other.height);
+	diffNodes(liftedRoot(commonHeight), other.liftedRoot(commonHeight), commonHeight, 0, changes);
+}
+
+void SceneState::diffNodes(const Slot& ours, const Slot& theirs, unsigned int level, UINT firstUID, std::vector<SceneStateChange>& changes)
+{
+	//whatever the two share is the same on both sides, that's what makes this cheap
+	if (ours == theirs)
+		return;
+	const Node* ourNode = static_cast<const Node*>(ours.get());
+	const Node* theirNode = static_cast<const Node*>(theirs.get());
+	for (unsigned int i = 0; i < fanOut; ++i)
+	{
+		const Slot& ourSlot = ourNode ? ourNode->slots[i] : Slot();
+		const Slot& theirSlot = theirNode ? theirNode->slots[i] : Slot();
+		if (ourSlot == theirSlot)
+			continue;
+		UINT uid = firstUID | ((UINT)i << (bitsPerLevel * (level - 1)));
+		if (level > 1)
+		{
+			diffNodes(ourSlot, theirSlot, level - 1, uid, changes);
+			continue;
+		}
+		SceneStateChange change;
+		change.uid = uid;
+		change.before = std::static_pointer_cast<const VesselSceneNodeState>(ourSlot);
+		change.after = std::static_pointer_cast<const VesselSceneNodeState>(theirSlot);
+		changes.push_back(change);
+	}
+}
+
+void SceneState::getAll(std::vector<VesselStatePtr>& states) const
+{
+	states.reserve(states.size() + vesselCount);
+	collect(root, height, states);
+}
+
+void SceneState::collect(const Slot& node, unsigned int level, std::vector<VesselStatePtr>& states)
+{
+	if (!node)
+		return;
+	const Node* current = static_cast<const Node*>(node.get());
+	for (unsigned int i = 0; i < fanOut; ++i)
+	{
+		if (!current->slots[i])
+			continue;
+		if (level > 1)
+			collect(current->slots[i], level - 1, states);
+		else
+			states.push_back(std::static_pointer_cast<const VesselSceneNodeState>(current->slots[i]));
+	}
+}
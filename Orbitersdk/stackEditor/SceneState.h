@@ -0,0 +1,65 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "VesselSceneNode.h"
+
+typedef std::shared_ptr<const VesselSceneNodeState> VesselStatePtr;
+
+//a vessel whose state differs between two scene states. before or after is empty if the vessel didn't exist there
+struct SceneStateChange
+{
+	UINT uid;
+	VesselStatePtr before, after;
+};
+
+//the state of every vessel in the scene by UID, kept in a persistent trie. nodes never change once they are built,
+//an edit copies the few nodes on the path to the vessel and shares everything else with the state it started from.
+//that makes copying a SceneState a snapshot that costs next to nothing, and two states that came from each other
+//can be compared by only walking the nodes they don't share.
+//the layout only depends on the UIDs, so the same vessels end up in the same places no matter in which order they were added
+class SceneState
+{
+public:
+	SceneState();
+
+	//empty if there is no vessel with that UID
+	VesselStatePtr get(UINT uid) const;
+	//an empty state removes the vessel
+	void set(UINT uid, const VesselStatePtr& state);
+	void erase(UINT uid);
+	size_t size() const;
+
+	//true if the two share everything, without looking at a single vessel. false doesn't mean anything changed,
+	//editing a vessel and editing it back leaves two equal states that don't share the vessel anymore
+	bool isSameAs(const SceneState& other) const;
+	//appends every vessel whose state isn't shared between the two, in UID order. before is ours, after the other one's
+	void diff(const SceneState& other, std::vector<SceneStateChange>& changes) const;
+	//all vessels, in UID order
+	void getAll(std::vector<VesselStatePtr>& states) const;
+
+	static const unsigned int bitsPerLevel = 4;
+	static const unsigned int fanOut = 1 << bitsPerLevel;
+
+private:
+	//inner nodes point to nodes, the nodes on level 1 point to vessel states
+	struct Node
+	{
+		std::shared_ptr<const void> slots[fanOut];
+	};
+	typedef std::shared_ptr<const void> Slot;
+
+	static unsigned int slotIndex(UINT uid, unsigned int level);
+	static Slot setIn(const Slot& node, unsigned int level, UINT uid, const VesselStatePtr& state);
+	static void diffNodes(const Slot& ours, const Slot& theirs, unsigned int level, UINT firstUID, std::vector<SceneStateChange>& changes);
+	static void collect(const Slot& node, unsigned int level, std::vector<VesselStatePtr>& states);
+	//the root as it would look with more levels on top
+	Slot liftedRoot(unsigned int toHeight) const;
+
+	Slot root;
+	unsigned int height;			//number of levels, the trie holds UIDs up to fanOut^height - 1
+	size_t vesselCount;
+};
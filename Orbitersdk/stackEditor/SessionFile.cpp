@@ -0,0 +1,276 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "SessionFile.h"
+#include "VesselSceneNode.h"
+#include "windows.h"
+#include <cstring>
+#include <fstream>
+#include <map>
+
+static const char sessionMagic[4] = { 'S', 'E', 'S', 'B' };
+
+//read only view of a whole file, for as long as the object lives
+class MappedFile
+{
+public:
+	MappedFile(const std::string& path) : file(INVALID_HANDLE_VALUE), mapping(NULL), data(NULL), size(0)
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER fileSize;
+		//empty files can't be mapped, and nothing sensible is bigger than 4 GB
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || fileSize.HighPart != 0)
+			return;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return;
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data != NULL)
+			size = (size_t)fileSize.QuadPart;
+	}
+
+	~MappedFile()
+	{
+		if (data != NULL)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+
+	HANDLE file;
+	HANDLE mapping;
+	const unsigned char* data;
+	size_t size;
+};
+
+static void appendU32(std::vector<char>& buffer, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		buffer.push_back((char)(value >> (i * 8)));
+}
+
+static void appendVector(std::vector<char>& buffer, const core::vector3df& value)
+{
+	const f32 components[3] = { value.X, value.Y, value.Z };
+	for (int i = 0; i < 3; i++)
+	{
+		unsigned int bits;
+		memcpy(&bits, &components[i], sizeof(bits));
+		appendU32(buffer, bits);
+	}
+}
+
+static unsigned int readU32(const unsigned char* data)
+{
+	return (unsigned int)data[0] | ((unsigned int)data[1] << 8) | ((unsigned int)data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+static core::vector3df readVector(const unsigned char* data)
+{
+	f32 components[3];
+	for (int i = 0; i < 3; i++)
+	{
+		unsigned int bits = readU32(data + i * 4);
+		memcpy(&components[i], &bits, sizeof(bits));
+	}
+	return core::vector3df(components[0], components[1], components[2]);
+}
+
+bool SessionFile::isBinary(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	char magic[sizeof(sessionMagic)];
+	if (!file.read(magic, sizeof(magic)))
+		return false;
+	return memcmp(magic, sessionMagic, sizeof(magic)) == 0;
+}
+
+void SessionFile::gather(const VesselRegistry& vessels, SessionContents& contents)
+{
+	std::map<VesselData*, unsigned int> classIndices;
+	std::vector<VesselRegistryEntry> sorted;
+	vessels.getSorted(sorted);
+	contents.vessels.reserve(sorted.size());
+	for (UINT i = 0; i < sorted.size(); ++i)
+	{
+		VesselSceneNode* vessel = sorted[i].second;
+		//the photo studio vessels aren't part of the scene
+		if (vessel->getID() != VESSEL_ID)
+			continue;
+		VesselSceneNodeState state = vessel->saveState();
+		SessionVessel stored;
+		stored.uid = state.uid;
+		std::map<VesselData*, unsigned int>::iterator classIndex = classIndices.find(state.vesData);
+		if (classIndex == classIndices.end())
+		{
+			classIndex = classIndices.insert(std::make_pair(state.vesData, (unsigned int)contents.names.size())).first;
+			contents.names.push_back(state.vesData->className);
+		}
+		stored.classIndex = classIndex->second;
+		stored.pos = state.pos;
+		stored.rot = state.rot;
+		stored.orbiterName = state.orbiterName;
+		contents.vessels.push_back(stored);
+
+		for (UINT port = 0; port < state.dockingStatus.size(); ++port)
+		{
+			const DockingPortStatus& status = state.dockingStatus[port];
+			if (!status.docked)
+				continue;
+			//a docking is stored by the end with the lower uid and port, unless the other end doesn't know about it
+			VesselSceneNode* other = vessels.get(status.dockedTo.vesselUID);
+			bool mutual = other != 0 && status.dockedTo.portID < other->dockingPorts.size() &&
+				other->dockingPorts[status.dockedTo.portID].docked &&
+				other->dockingPorts[status.dockedTo.portID].dockedTo.vesselUID == state.uid &&
+				other->dockingPorts[status.dockedTo.portID].dockedTo.portID == port;
+			if (mutual && (status.dockedTo.vesselUID < state.uid || (status.dockedTo.vesselUID == state.uid && status.dockedTo.portID < port)))
+				continue;
+			SessionDocking docking = { state.uid, port, status.dockedTo.vesselUID, status.dockedTo.portID };
+			contents.dockings.push_back(docking);
+		}
+	}
+}
+
+void SessionFile::write(const std::string& path, const SessionContents& contents)
+{
+	//orbiter names go into the string table after the class names, each distinct one once
+	std::vector<std::string> strings = contents.names;
+	std::map<std::string, unsigned int> nameIndices;
+	std::vector<unsigned int> vesselNames(contents.vessels.size(), (unsigned int)noString);
+	for (UINT i = 0; i < contents.vessels.size(); ++i)
+	{
+		const std::string& name = contents.vessels[i].orbiterName;
+		if (name == "")
+			continue;
+		std::map<std::string, unsigned int>::iterator index = nameIndices.find(name);
+		if (index == nameIndices.end())
+		{
+			index = nameIndices.insert(std::make_pair(name, (unsigned int)strings.size())).first;
+			strings.push_back(name);
+		}
+		vesselNames[i] = index->second;
+	}
+	size_t stringBytes = 0;
+	for (UINT i = 0; i < strings.size(); ++i)
+		stringBytes += strings[i].size();
+
+	//the whole file is put together in memory and written in one go
+	std::vector<char> buffer;
+	buffer.reserve(headerSize + contents.vessels.size() * vesselRecordSize + contents.dockings.size() * dockingRecordSize +
+		strings.size() * 4 + stringBytes);
+	buffer.insert(buffer.end(), sessionMagic, sessionMagic + sizeof(sessionMagic));
+	appendU32(buffer, version);
+	appendU32(buffer, contents.vessels.size());
+	appendU32(buffer, contents.dockings.size());
+	appendU32(buffer, strings.size());
+	appendU32(buffer, stringBytes);
+
+	for (UINT i = 0; i < contents.vessels.size(); ++i)
+	{
+		const SessionVessel& vessel = contents.vessels[i];
+		appendU32(buffer, vessel.uid);
+		appendU32(buffer, vessel.classIndex);
+		appendU32(buffer, vesselNames[i]);
+		appendVector(buffer, vessel.pos);
+		appendVector(buffer, vessel.rot);
+	}
+	for (UINT i = 0; i < contents.dockings.size(); ++i)
+	{
+		const SessionDocking& docking = contents.dockings[i];
+		appendU32(buffer, docking.vesselUID);
+		appendU32(buffer, docking.portID);
+		appendU32(buffer, docking.otherVesselUID);
+		appendU32(buffer, docking.otherPortID);
+	}
+	for (UINT i = 0; i < strings.size(); ++i)
+		appendU32(buffer, strings[i].size());
+	for (UINT i = 0; i < strings.size(); ++i)
+		buffer.insert(buffer.end(), strings[i].begin(), strings[i].end());
+
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw SessionFileError("Couldn't open " + path + " for writing");
+	file.write(buffer.data(), buffer.size());
+	file.close();
+	if (!file)
+		throw SessionFileError("Couldn't write " + path);
+}
+
+void SessionFile::read(const std::string& path, SessionContents& contents)
+{
+	MappedFile file(path);
+	if (file.data == NULL)
+		throw SessionFileError("Couldn't map " + path);
+	if (file.size < headerSize || memcmp(file.data, sessionMagic, sizeof(sessionMagic)) != 0)
+		throw SessionFileError("Not a binary session");
+	if (readU32(file.data + 4) != version)
+		throw SessionFileError("Unknown binary session version");
+
+	//64 bit sums, so huge counts in a damaged file can't wrap around
+	unsigned long long vesselCount = readU32(file.data + 8);
+	unsigned long long dockingCount = readU32(file.data + 12);
+	unsigned long long stringCount = readU32(file.data + 16);
+	unsigned long long stringBytes = readU32(file.data + 20);
+	unsigned long long expectedSize = headerSize + vesselCount * vesselRecordSize + dockingCount * dockingRecordSize +
+		stringCount * 4 + stringBytes;
+	if (expectedSize != file.size)
+		throw SessionFileError("Binary session has the wrong size");
+
+	const unsigned char* vesselRecords = file.data + headerSize;
+	const unsigned char* dockingRecords = vesselRecords + vesselCount * vesselRecordSize;
+	const unsigned char* stringLengths = dockingRecords + dockingCount * dockingRecordSize;
+	const unsigned char* characters = stringLengths + stringCount * 4;
+
+	contents.names.resize((size_t)stringCount);
+	unsigned long long offset = 0;
+	for (size_t i = 0; i < stringCount; ++i)
+	{
+		unsigned int length = readU32(stringLengths + i * 4);
+		if (offset + length > stringBytes)
+			throw SessionFileError("Binary session string table is damaged");
+		contents.names[i].assign((const char*)characters + offset, length);
+		offset += length;
+	}
+	if (offset != stringBytes)
+		throw SessionFileError("Binary session string table is damaged");
+
+	//the uids go into the registry as they are, so they have to be in its range and unique
+	std::vector<bool> uidTaken;
+	contents.vessels.resize((size_t)vesselCount);
+	for (size_t i = 0; i < vesselCount; ++i)
+	{
+		const unsigned char* record = vesselRecords + i * vesselRecordSize;
+		SessionVessel& vessel = contents.vessels[i];
+		vessel.uid = readU32(record);
+		if (vessel.uid > VesselRegistry::maxUID)
+			throw SessionFileError("Binary session has a vessel uid out of range");
+		if (vessel.uid >= uidTaken.size())
+			uidTaken.resize(vessel.uid + 1, false);
+		if (uidTaken[vessel.uid])
+			throw SessionFileError("Binary session has two vessels with the same uid");
+		uidTaken[vessel.uid] = true;
+		vessel.classIndex = readU32(record + 4);
+		unsigned int nameIndex = readU32(record + 8);
+		if (vessel.classIndex >= stringCount || (nameIndex != noString && nameIndex >= stringCount))
+			throw SessionFileError("Binary session refers to a string that doesn't exist");
+		if (nameIndex != noString)
+			vessel.orbiterName = contents.names[nameIndex];
+		vessel.pos = readVector(record + 12);
+		vessel.rot = readVector(record + 24);
+	}
+
+	//whether the ports exist depends on the vessel classes, the StackEditor checks that once they are loaded
+	contents.dockings.resize((size_t)dockingCount);
+	for (size_t i = 0; i < dockingCount; ++i)
+	{
+		const unsigned char* record = dockingRecords + i * dockingRecordSize;
+		SessionDocking& docking = contents.dockings[i];
+		docking.vesselUID = readU32(record);
+		docking.portID = readU32(record + 4);
+		docking.otherVesselUID = readU32(record + 8);
+		docking.otherPortID = readU32(record + 12);
+	}
+}
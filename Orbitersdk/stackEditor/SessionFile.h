@@ -0,0 +1,68 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "VesselRegistry.h"
+
+using namespace irr;
+
+//a vessel as stored in a session. the class is an index into the names of the session
+struct SessionVessel
+{
+	unsigned int uid;
+	unsigned int classIndex;
+	core::vector3df pos, rot;
+	std::string orbiterName;
+};
+
+//a docking between two ports, stored once for both of them
+struct SessionDocking
+{
+	unsigned int vesselUID, portID;
+	unsigned int otherVesselUID, otherPortID;
+};
+
+struct SessionContents
+{
+	std::vector<std::string> names;		//class names, and whatever else the file stores as strings
+	std::vector<SessionVessel> vessels;
+	std::vector<SessionDocking> dockings;
+};
+
+//binary sessions, VERSION 2. text sessions (VERSION 1) are still read and written by the StackEditor itself.
+//all numbers are 32 bit little endian, the file is laid out as:
+//	header			"SESB", version, vessel count, docking count, string count, string bytes
+//	vessels			36 bytes each: uid, class string, orbiter name string (0xffffffff if none), pos xyz, rot xyz
+//	dockings		16 bytes each: uid, port, other uid, other port
+//	string table	the length of every string, followed by the characters of all of them
+//loading maps the file and checks all sizes, indices and vessel uids before anything is taken from it
+class SessionFile
+{
+public:
+	class SessionFileError : public std::runtime_error
+	{
+	public:
+		SessionFileError(const std::string& arg) : runtime_error(arg){}
+	};
+
+	//true if the file starts like a binary session
+	static bool isBinary(const std::string& path);
+	//collects the vessels and dockings of the scene, in uid order
+	static void gather(const VesselRegistry& vessels, SessionContents& contents);
+	//both throw SessionFileError
+	static void write(const std::string& path, const SessionContents& contents);
+	static void read(const std::string& path, SessionContents& contents);
+
+	static const unsigned int version = 2;
+	static const unsigned int noString = 0xffffffff;
+
+private:
+	static const unsigned int headerSize = 24;
+	static const unsigned int vesselRecordSize = 36;
+	static const unsigned int dockingRecordSize = 16;
+};
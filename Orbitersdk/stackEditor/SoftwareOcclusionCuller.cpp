@@ -0,0 +1,286 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "SoftwareOcclusionCuller.h"
+#include "VesselSceneNode.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+
+//an occluder candidate and how much of the depth buffer its bounding box covers
+struct OccluderCandidate
+{
+	VesselSceneNode* vessel;
+	f32 screenArea;
+};
+
+static bool largerOccluder(const OccluderCandidate& a, const OccluderCandidate& b)
+{
+	return a.screenArea > b.screenArea;
+}
+
+//points closer than this to the camera plane can't be projected reliably
+static const f32 minClipW = 0.001f;
+//vessels covering less of the buffer than this aren't worth rasterizing
+static const f32 minOccluderArea = 64.0f;
+
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(scene::ISceneManager* mgr, const VesselRegistry* vessels)
+	: smgr(mgr), vesselMap(vessels), prepared(false), hasCamera(false),
+	frames(0), totalTests(0), totalOccluded(0), totalMicroseconds(0)
+{
+	depthBuffer.resize(bufferWidth * bufferHeight, FLT_MAX);
+}
+
+void SoftwareOcclusionCuller::beginFrame()
+{
+	//fold the last frame into the totals
+	if (prepared)
+	{
+		frames++;
+		totalTests += stats.tests;
+		totalOccluded += stats.occluded;
+		totalMicroseconds += stats.microseconds;
+	}
+	prepared = false;
+	stats = SoftwareOcclusionStats();
+}
+
+bool SoftwareOcclusionCuller::isActiveFor(scene::ISceneManager* mgr)
+{
+	return mgr == smgr;
+}
+
+const SoftwareOcclusionStats& SoftwareOcclusionCuller::getStats()
+{
+	return stats;
+}
+
+void SoftwareOcclusionCuller::logSummary()
+{
+	if (frames == 0 || totalTests == 0)
+		return;
+	Log::writeToLog(Log::INFO, "Occlusion culling: ", totalOccluded * 100.0 / totalTests, "% of ", totalTests,
+		" tested boxes occluded over ", frames, " frames, ", totalMicroseconds / frames, " microseconds per frame");
+}
+
+bool SoftwareOcclusionCuller::projectPoint(const core::matrix4& matrix, const core::vector3df& point, core::vector3df& screenPoint)
+{
+	f32 clip[4];
+	matrix.transformVect(clip, point);
+	if (clip[3] < minClipW)
+		return false;
+	f32 invW = 1.0f / clip[3];
+	screenPoint.X = (clip[0] * invW * 0.5f + 0.5f) * bufferWidth;
+	screenPoint.Y = (0.5f - clip[1] * invW * 0.5f) * bufferHeight;
+	screenPoint.Z = clip[2] * invW;
+	return true;
+}
+
+//projects all corners of the box. returns false if a corner lies behind the camera, the rect is useless in that case
+bool SoftwareOcclusionCuller::projectBox(const core::aabbox3d<f32>& box, const core::matrix4& matrix, core::rect<f32>& screenRect, f32& nearestDepth)
+{
+	core::vector3df corners[8];
+	box.getEdges(corners);
+	nearestDepth = FLT_MAX;
+	for (u32 i = 0; i < 8; i++)
+	{
+		core::vector3df screenPoint;
+		if (!projectPoint(matrix, corners[i], screenPoint))
+			return false;
+		if (i == 0)
+			screenRect = core::rect<f32>(screenPoint.X, screenPoint.Y, screenPoint.X, screenPoint.Y);
+		else
+			screenRect.addInternalPoint(screenPoint.X, screenPoint.Y);
+		nearestDepth = std::min(nearestDepth, screenPoint.Z);
+	}
+	return true;
+}
+
+void SoftwareOcclusionCuller::prepare()
+{
+	prepared = true;
+	std::fill(depthBuffer.begin(), depthBuffer.end(), FLT_MAX);
+
+	scene::ICameraSceneNode* camera = smgr->getActiveCamera();
+	hasCamera = camera != 0;
+	if (!hasCamera)
+		return;
+	viewProjection = camera->getProjectionMatrix() * camera->getViewMatrix();
+
+	//the biggest vessels on screen are the ones most likely to hide something
+	std::vector<OccluderCandidate> candidates;
+	for (VesselRegistry::const_iterator it = vesselMap->begin(); it != vesselMap->end(); ++it)
+	{
+		VesselSceneNode* vessel = it->second;
+		//transparent vessels don't hide anything
+		if (!vessel->isVisible() || vessel->isTransparent())
+			continue;
+		core::rect<f32> screenRect;
+		f32 nearestDepth;
+		if (!projectBox(vessel->getTransformedBoundingBox(), viewProjection, screenRect, nearestDepth))
+			continue;
+		screenRect.clipAgainst(core::rect<f32>(0, 0, (f32)bufferWidth, (f32)bufferHeight));
+		OccluderCandidate candidate;
+		candidate.vessel = vessel;
+		candidate.screenArea = screenRect.getArea();
+		if (candidate.screenArea >= minOccluderArea)
+			candidates.push_back(candidate);
+	}
+
+	u32 occluderCount = std::min((u32)candidates.size(), maxOccluders);
+	std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end(), largerOccluder);
+	for (u32 i = 0; i < occluderCount; i++)
+		rasterizeOccluder(candidates[i].vessel);
+	stats.occluders = occluderCount;
+}
+
+//rasterizes the actual mesh of the vessel. the bounding box would be cheaper, but it isn't a conservative occluder
+void SoftwareOcclusionCuller::rasterizeOccluder(VesselSceneNode* vessel)
+{
+	OrbiterMesh* mesh = vessel->returnVesselData()->vesselMesh;
+	core::matrix4 worldViewProjection = viewProjection * vessel->getAbsoluteTransformation();
+
+	for (u32 i = 0; i < mesh->meshGroups.size(); i++)
+	{
+		const scene::IMeshBuffer* buffer = mesh->meshGroups[i].meshBuffer;
+		if (buffer == 0 || mesh->meshGroups[i].renderMaterialIndex == -1)
+			continue;
+
+		//project every vertex once, triangles share most of them
+		u32 vertexCount = buffer->getVertexCount();
+		projectedVertices.resize(vertexCount);
+		vertexValid.resize(vertexCount);
+		for (u32 j = 0; j < vertexCount; j++)
+			vertexValid[j] = projectPoint(worldViewProjection, buffer->getPosition(j), projectedVertices[j]);
+
+		u32 indexCount = buffer->getIndexCount();
+		const u16* indices16 = buffer->getIndexType() == video::EIT_16BIT ? buffer->getIndices() : 0;
+		const u32* indices32 = buffer->getIndexType() == video::EIT_32BIT ? (const u32*)buffer->getIndices() : 0;
+		for (u32 j = 0; j + 2 < indexCount; j += 3)
+		{
+			u32 a = indices16 ? indices16[j] : indices32[j];
+			u32 b = indices16 ? indices16[j + 1] : indices32[j + 1];
+			u32 c = indices16 ? indices16[j + 2] : indices32[j + 2];
+			//triangles crossing the camera plane are simply left out, that only makes the buffer less occluding
+			if (!vertexValid[a] || !vertexValid[b] || !vertexValid[c])
+				continue;
+			rasterizeTriangle(projectedVertices[a], projectedVertices[b], projectedVertices[c]);
+		}
+	}
+}
+
+//half-space rasterizer, four pixels of a row at a time. depth is interpolated linearly in screen space, which is exact for projected depth
+void SoftwareOcclusionCuller::rasterizeTriangle(const core::vector3df& a, const core::vector3df& b, const core::vector3df& c)
+{
+	const core::vector3df* v0 = &a;
+	const core::vector3df* v1 = &b;
+	const core::vector3df* v2 = &c;
+	f32 area = (v1->X - v0->X) * (v2->Y - v0->Y) - (v2->X - v0->X) * (v1->Y - v0->Y);
+	if (area == 0)
+		return;
+	//both faces occlude, so just bring the triangle into a consistent winding
+	if (area < 0)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	s32 minX = std::max(0, (s32)floor(std::min(v0->X, std::min(v1->X, v2->X))));
+	s32 maxX = std::min((s32)bufferWidth - 1, (s32)ceil(std::max(v0->X, std::max(v1->X, v2->X))));
+	s32 minY = std::max(0, (s32)floor(std::min(v0->Y, std::min(v1->Y, v2->Y))));
+	s32 maxY = std::min((s32)bufferHeight - 1, (s32)ceil(std::max(v0->Y, std::max(v1->Y, v2->Y))));
+	if (minX > maxX || minY > maxY)
+		return;
+	//start on a multiple of four, the buffer width is one as well so the last block never runs past the row
+	minX &= ~3;
+	stats.rasterizedTriangles++;
+
+	//edge functions, each one is positive on the inner side of its edge and weights the opposite vertex
+	f32 a0 = v1->Y - v2->Y, b0 = v2->X - v1->X, c0 = v1->X * v2->Y - v2->X * v1->Y;
+	f32 a1 = v2->Y - v0->Y, b1 = v0->X - v2->X, c1 = v2->X * v0->Y - v0->X * v2->Y;
+	f32 a2 = v0->Y - v1->Y, b2 = v1->X - v0->X, c2 = v0->X * v1->Y - v1->X * v0->Y;
+	//depth as a plane over the screen
+	f32 invArea = 1.0f / area;
+	f32 zA = (a0 * v0->Z + a1 * v1->Z + a2 * v2->Z) * invArea;
+	f32 zB = (b0 * v0->Z + b1 * v1->Z + b2 * v2->Z) * invArea;
+	f32 zC = (c0 * v0->Z + c1 * v1->Z + c2 * v2->Z) * invArea;
+
+	const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 edgeA0 = _mm_set1_ps(a0), edgeA1 = _mm_set1_ps(a1), edgeA2 = _mm_set1_ps(a2);
+	const __m128 depthA = _mm_set1_ps(zA);
+
+	for (s32 y = minY; y <= maxY; y++)
+	{
+		f32 py = y + 0.5f;
+		__m128 rowE0 = _mm_set1_ps(b0 * py + c0);
+		__m128 rowE1 = _mm_set1_ps(b1 * py + c1);
+		__m128 rowE2 = _mm_set1_ps(b2 * py + c2);
+		__m128 rowZ = _mm_set1_ps(zB * py + zC);
+		f32* row = &depthBuffer[y * bufferWidth];
+
+		for (s32 x = minX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((f32)x), pixelOffsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA0, px), rowE0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA1, px), rowE1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA2, px), rowE2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), rowZ);
+			__m128 depth = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(depth, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+		}
+	}
+}
+
+bool SoftwareOcclusionCuller::isOccluded(const core::aabbox3d<f32>& worldBox)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (!prepared)
+		prepare();
+	stats.tests++;
+
+	bool occluded = false;
+	core::rect<f32> screenRect;
+	f32 nearestDepth;
+	//boxes reaching behind the camera are always visible
+	if (hasCamera && stats.occluders > 0 && projectBox(worldBox, viewProjection, screenRect, nearestDepth))
+	{
+		s32 minX = std::max(0, (s32)floor(screenRect.UpperLeftCorner.X));
+		s32 maxX = std::min((s32)bufferWidth - 1, (s32)ceil(screenRect.LowerRightCorner.X));
+		s32 minY = std::max(0, (s32)floor(screenRect.UpperLeftCorner.Y));
+		s32 maxY = std::min((s32)bufferHeight - 1, (s32)ceil(screenRect.LowerRightCorner.Y));
+
+		//the box is hidden if every covered pixel holds something nearer than its nearest corner
+		occluded = minX <= maxX && minY <= maxY;
+		const __m128 boxDepth = _mm_set1_ps(nearestDepth);
+		for (s32 y = minY; y <= maxY && occluded; y++)
+		{
+			const f32* row = &depthBuffer[y * bufferWidth];
+			s32 x = minX;
+			for (; x + 3 <= maxX; x += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0)
+				{
+					occluded = false;
+					break;
+				}
+			}
+			for (; x <= maxX && occluded; x++)
+			{
+				if (row[x] >= nearestDepth)
+					occluded = false;
+			}
+		}
+	}
+
+	if (occluded)
+		stats.occluded++;
+	stats.microseconds += std::chrono::duration<f64, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	return occluded;
+}
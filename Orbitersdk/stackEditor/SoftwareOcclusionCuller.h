@@ -0,0 +1,74 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include "Log.h"
+#include "VesselRegistry.h"
+
+using namespace irr;
+
+class VesselSceneNode;
+
+//per frame counters of the occlusion pass, reset in beginFrame()
+struct SoftwareOcclusionStats
+{
+	SoftwareOcclusionStats() : occluders(0), rasterizedTriangles(0), tests(0), occluded(0), microseconds(0) {}
+	u32 occluders;
+	u32 rasterizedTriangles;
+	u32 tests;
+	u32 occluded;
+	f64 microseconds;				//time spent rasterizing occluders and testing boxes
+};
+
+//CPU side occlusion culling. the meshes of the largest vessels on screen are rasterized into a small depth buffer,
+//other vessels and mesh groups are then tested against it before being submitted for drawing.
+//completely independent of the video driver, so it works with the software and null drivers as well.
+class SoftwareOcclusionCuller
+{
+public:
+	SoftwareOcclusionCuller(scene::ISceneManager* mgr, const VesselRegistry* vessels);
+
+	//call once per frame before drawing. the occluders are rasterized lazily on the first test,
+	//because the camera only updates its matrices during drawAll
+	void beginFrame();
+	//returns true if the box, in world coordinates, is completely hidden behind the rasterized occluders
+	bool isOccluded(const core::aabbox3d<f32>& worldBox);
+	//the culler only knows about the vessels of one scene manager
+	bool isActiveFor(scene::ISceneManager* mgr);
+
+	const SoftwareOcclusionStats& getStats();
+	//writes the occluded percentage and the average cost of the pass over all frames so far to the log
+	void logSummary();
+
+	static const u32 bufferWidth = 256;				//must be a multiple of 4
+	static const u32 bufferHeight = 128;
+	static const u32 maxOccluders = 24;
+
+private:
+	void prepare();
+	void rasterizeOccluder(VesselSceneNode* vessel);
+	void rasterizeTriangle(const core::vector3df& a, const core::vector3df& b, const core::vector3df& c);
+	bool projectBox(const core::aabbox3d<f32>& box, const core::matrix4& matrix, core::rect<f32>& screenRect, f32& nearestDepth);
+	bool projectPoint(const core::matrix4& matrix, const core::vector3df& point, core::vector3df& screenPoint);
+
+	scene::ISceneManager* smgr;
+	const VesselRegistry* vesselMap;
+	std::vector<f32> depthBuffer;
+	std::vector<core::vector3df> projectedVertices;
+	std::vector<bool> vertexValid;
+	core::matrix4 viewProjection;
+	bool prepared;
+	bool hasCamera;
+	SoftwareOcclusionStats stats;
+
+	//running totals for logSummary
+	u32 frames;
+	u64 totalTests;
+	u64 totalOccluded;
+	f64 totalMicroseconds;
+};
@@ -16,12 +16,21 @@ StackEditor::StackEditor(ExportData *exportdata, ImportData *importdata)
 	dialogOpen = false;
 	device = NULL;
 	lastSpawnedVessel = NULL;
+	staticBake = NULL;
+	occlusionCuller = NULL;
+	frameScheduler = NULL;
+	interpenetrationChecker = NULL;
+	showMetricsOverlay = false;
+	benchmarkRequested = false;
+	autoDockTolerance = 0;
+	binarySessions = false;
 	session = "unnamed";
 	areSplittingStack = false;
 	_exportdata = exportdata;
 	_importdata = importdata;
 
     Helpers::setVesselMap(&uidVesselMap);
+    VesselSceneNode::undoHistory = &undoHistory;
 }
 
 StackEditor::~StackEditor()
@@ -30,13 +39,31 @@ StackEditor::~StackEditor()
     Log::writeToLog("Terminating StackEditor...");
 }
 
-void StackEditor::setupDevice(IrrlichtDevice * _device, std::string toolboxSet)
+void StackEditor::setupDevice(IrrlichtDevice * _device, const CONFIGPARAMS& params)
 {
 	device = _device;
 	smgr = device->getSceneManager();
 	collisionManager = smgr->getSceneCollisionManager();
 	guiEnv = device->getGUIEnvironment();
-	tbxSet = toolboxSet;
+	tbxSet = params.toolboxset;
+
+	if (params.staticbake)
+	{
+		Log::writeToLog(Log::INFO, "Static geometry baking enabled");
+		staticBake = new StaticGeometryBake(smgr->getRootSceneNode(), smgr);
+	}
+	if (params.occlusionculling)
+	{
+		Log::writeToLog(Log::INFO, "Occlusion culling enabled");
+		occlusionCuller = new SoftwareOcclusionCuller(smgr, &uidVesselMap);
+		VesselSceneNode::occlusionCuller = occlusionCuller;
+	}
+
+	frameScheduler = new FrameScheduler(params.idlefps);
+	autoDockTolerance = params.autodocktolerance;
+	binarySessions = params.binarysessions;
+	undoHistory.setLimits(params.undodepth, (size_t)params.undomemory * 1024 * 1024);
+	interpenetrationChecker = new InterpenetrationChecker(smgr);
 
 	dataManager.Initialise(device);
 
@@ -118,15 +145,21 @@ void StackEditor::loop()
 //			device->postEventFromUser(EMIE_MMOUSE_PRESSED_DOWN);
 		}
 
-		Helpers::videoDriverMutex.lock();
-		driver->beginScene(true, true, scenebgcolor);
-		
-		smgr->drawAll();
+		if (staticBake)
+		{
+			staticBake->update(uidVesselMap, selectedVesselStack);
+		}
+
+		//a few milliseconds of overlap testing per iteration, keep iterating until the check is done
+		if (interpenetrationChecker->update(3000) || interpenetrationChecker->isRunning())
+			FrameScheduler::markDirty();
 
-		guiEnv->drawAll();
+		if (benchmarkRequested)
+			runBenchmark();
 
-		driver->endScene();
-		Helpers::videoDriverMutex.unlock();
+		//only draw if something changed, or the idle frame is due
+		if (frameScheduler->beginIteration())
+			drawFrame(driver);
 
 		//checking toolbox for vessels to be created
 		ToolboxData* toolboxData = toolboxes[activetoolbox]->checkCreateVessel();
@@ -142,10 +175,101 @@ void StackEditor::loop()
 		//checking import struct for imports, only has effect in orbiter version
 		if (_importdata && !_importdata->locked && _importdata->stack.size() > 0)
 		{
-			importStack();
+			autoDockCoincidentPorts("import", importStack());
+			//the import and whatever it docked can be undone in one step
+			pushUndoStack();
 		}
+
+		//comparing snapshots that share everything costs nothing, so this only does work after an edit
+		if (!undoHistory.getScene().isSameAs(captionScene))
+			updateCaption();
+
+		frameScheduler->waitForWork();
 	}
     clearSession();
+    //nothing is going to reuse them anymore
+    VesselNodePool::getPool(smgr)->clear();
+    VesselSceneNode::undoHistory = NULL;
+	if (staticBake)
+	{
+		//stops the bake thread
+		staticBake->remove();
+		staticBake->drop();
+		staticBake = NULL;
+	}
+	if (occlusionCuller)
+	{
+		occlusionCuller->logSummary();
+		VesselSceneNode::occlusionCuller = NULL;
+		delete occlusionCuller;
+		occlusionCuller = NULL;
+	}
+	delete interpenetrationChecker;
+	interpenetrationChecker = NULL;
+	frameScheduler->logSummary();
+	ProfiledMutex::logSummary();
+	delete frameScheduler;
+	frameScheduler = NULL;
+}
+
+//draws the scene and the gui once, returns how long it took in milliseconds
+double StackEditor::drawFrame(video::IVideoDriver* driver)
+{
+	std::chrono::high_resolution_clock::time_point frameStart = std::chrono::high_resolution_clock::now();
+	Helpers::videoDriverMutex.lock(__FUNCTION__);
+	VesselRenderQueue::renderStats.reset();
+	if (occlusionCuller)
+		occlusionCuller->beginFrame();
+	driver->beginScene(true, true, scenebgcolor);
+
+	smgr->drawAll();
+	interpenetrationChecker->draw(driver);
+
+	guiEnv->drawAll();
+
+	if (showMetricsOverlay)
+		drawMetricsOverlay(driver);
+
+	driver->endScene();
+	Helpers::videoDriverMutex.unlock();
+	double frameTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+	publishFrameMetrics(frameTime);
+	return frameTime;
+}
+
+void StackEditor::publishFrameMetrics(double frameTime)
+{
+	const VesselRenderStats& stats = VesselRenderQueue::renderStats;
+	Metrics::recordSample("frame.time_ms", frameTime);
+	Metrics::setGauge("render.draw_calls", stats.drawCalls);
+	Metrics::setGauge("render.triangles", stats.triangles);
+	Metrics::setGauge("render.material_switches", stats.materialSwitches);
+	Metrics::setGauge("render.texture_switches", stats.textureSwitches);
+	Metrics::setGauge("render.culled_vessels", stats.culledVessels);
+	Metrics::setGauge("render.culled_groups", stats.culledGroups);
+	Metrics::setGauge("render.culled_triangles", stats.culledTriangles);
+	Metrics::setGauge("scene.vessels", (double)uidVesselMap.size());
+	//taking every lock once more isn't free, only do it if someone is looking
+	if (showMetricsOverlay)
+		ProfiledMutex::publishMetrics();
+	if (occlusionCuller)
+	{
+		const SoftwareOcclusionStats& occlusion = occlusionCuller->getStats();
+		Metrics::setGauge("occlusion.occluded_percent", occlusion.tests > 0 ? occlusion.occluded * 100.0 / occlusion.tests : 0.0);
+		Metrics::setGauge("occlusion.pass_us", occlusion.microseconds);
+	}
+}
+
+//draws all metrics as text in the top left corner of the scene, right of the toolbox list
+void StackEditor::drawMetricsOverlay(video::IVideoDriver* driver)
+{
+	gui::IGUIFont* font = guiEnv->getSkin()->getFont();
+	std::wstring text = Metrics::getOverlayText();
+	core::dimension2d<u32> size = font->getDimension(text.c_str());
+	core::rect<s32> area(130, 10, 140 + size.Width, 20 + size.Height);
+	driver->draw2DRectangle(video::SColor(180, 0, 0, 0), area);
+	area.UpperLeftCorner += core::vector2d<s32>(5, 5);
+	font->draw(text.c_str(), area, video::SColor(255, 255, 255, 255));
 }
 
 VesselSceneNode *StackEditor::addVessel(VesselData* vesseldata, bool snaptocursor)
@@ -157,7 +281,7 @@ VesselSceneNode *StackEditor::addVessel(VesselData* vesseldata, bool snaptocurso
 	}
 
 	//add the vessel
-	VesselSceneNode* newvessel = new VesselSceneNode(vesseldata, smgr->getRootSceneNode(), smgr, VESSEL_ID);
+	VesselSceneNode* newvessel = VesselNodePool::getPool(smgr)->acquire(vesseldata, smgr->getRootSceneNode(), VESSEL_ID);
 
 	if (snaptocursor)
 	{
@@ -168,6 +292,7 @@ VesselSceneNode *StackEditor::addVessel(VesselData* vesseldata, bool snaptocurso
 	}
 
 	lastSpawnedVessel = vesseldata;
+	FrameScheduler::markDirty();
 
 	//remove focus from the element so no vessels can be spawned while the current one is still being selected
 	guiEnv->removeFocus(toolboxes[activetoolbox]);
@@ -213,6 +338,11 @@ core::aabbox3d<f32> StackEditor::returnOverallBoundingBox()
 
 bool StackEditor::OnEvent(const SEvent& event)
 {
+	//every input or gui event can move the camera or a stack, or change the gui, so the frame has to be redrawn
+	if (event.EventType == EET_GUI_EVENT || event.EventType == EET_KEY_INPUT_EVENT || event.EventType == EET_MOUSE_INPUT_EVENT)
+	{
+		FrameScheduler::markDirty();
+	}
 	
 	//EGET_LISTBOX_CHANGED seems to fire unreliably, so we have to check it ourselves
 	//also, some events fire before setupDevice() is called, so we have to make sure that it has already been initialised
@@ -276,8 +406,7 @@ bool StackEditor::processGuiEvent(const SEvent &event)
 					std::vector<std::string> tokens;
 					Helpers::tokenize(fullfilename, tokens, "/\\.");
 					session = tokens[tokens.size() - 2];
-					std::string newcaption = "Orbiter Stack Editor - " + session;
-					device->setWindowCaption(std::wstring(newcaption.begin(), newcaption.end()).c_str());
+					updateCaption();
 				}
 				Helpers::resetDirectory();
 			}
@@ -475,6 +604,23 @@ bool StackEditor::processKeyboardEvent(const SEvent &event)
 	if (event.KeyInput.Key == KEY_KEY_C)
 		centerCamera();
 
+	//F3 toggles the performance overlay, F4 dumps the same numbers to a file.
+	//shift+F4 runs the benchmark, which writes a file of its own when it's done
+	if (event.KeyInput.PressedDown && event.KeyInput.Key == KEY_F3)
+		showMetricsOverlay = !showMetricsOverlay;
+	if (event.KeyInput.PressedDown && event.KeyInput.Key == KEY_F4 && isKeyDown[EKEY_CODE::KEY_LSHIFT])
+		benchmarkRequested = true;
+	else if (event.KeyInput.PressedDown && event.KeyInput.Key == KEY_F4)
+	{
+		if (Metrics::writeCSV("./StackEditor/metrics.csv"))
+			Log::writeToLog(Log::INFO, "Wrote metrics to StackEditor/metrics.csv");
+		else
+			Log::writeToLog(Log::ERR, "Could not write StackEditor/metrics.csv");
+	}
+	//F5 checks the selected stack, or everything if nothing is selected, for vessels stuck in each other
+	if (event.KeyInput.PressedDown && event.KeyInput.Key == KEY_F5)
+		checkInterpenetration(true);
+
     if (event.KeyInput.PressedDown && event.KeyInput.Key == KEY_KEY_Z)
     {
         if (isKeyDown[EKEY_CODE::KEY_LCONTROL])
@@ -648,14 +794,12 @@ bool StackEditor::processMouseEvent(const SEvent &event)
 		{
 			if (areSplittingStack)
 			{
-				//try seeing if we clicked on a docking node
-				scene::ISceneNode* selectedNode = collisionManager->getSceneNodeFromScreenCoordinatesBB(
-					device->getCursorControl()->getPosition(), HELPER_ID, true);
-				if (selectedNode->getID() == HELPER_ID)
+				//try seeing if we clicked on a docking port
+				OrbiterDockingPort* selectedDockingPort = pickDockingPort(HELPER_ID);
+				if (selectedDockingPort != 0)
 				{
 					//get vessel and port
-					VesselSceneNode* nodeVessel = (VesselSceneNode*)selectedNode->getParent();
-					OrbiterDockingPort* selectedDockingPort = nodeVessel->dockingPortHelperNodeToOrbiter(selectedNode);
+					VesselSceneNode* nodeVessel = selectedDockingPort->parent;
 
 					//if it is docked, undock it to split the stack
 					//and regenerate stack
@@ -676,16 +820,23 @@ bool StackEditor::processMouseEvent(const SEvent &event)
 			{
 
 				//try docking this node
-				scene::ISceneNode* selectedNode = collisionManager->getSceneNodeFromScreenCoordinatesBB(
-					device->getCursorControl()->getPosition(), DOCKPORT_ID, true);
-				if (selectedNode->getID() == DOCKPORT_ID)
+				OrbiterDockingPort* selectedDockingPort = pickDockingPort(DOCKPORT_ID);
+				if (selectedDockingPort != 0)
 				{
-                    selectedVesselStack->checkForSnapping((VesselSceneNode*)selectedNode->getParent(), selectedNode, true);
+                    selectedVesselStack->checkForSnapping(selectedDockingPort, true);
+					//closing a ring puts more ports on top of each other than the one we just docked.
+					//only the selected stack moved
+					std::vector<VesselSceneNode*> moved;
+					for (UINT i = 0; i < selectedVesselStack->numVessels(); ++i)
+						moved.push_back(selectedVesselStack->getVessel(i));
+					autoDockCoincidentPorts("snap", moved);
 				}
 
 				//hide docking ports
                 setAllDockingPortVisibility(false, false);
 
+				//check where the stack ended up
+				checkInterpenetration(false);
 				delete selectedVesselStack;
 				selectedVesselStack = 0;
 
@@ -707,12 +858,12 @@ bool StackEditor::processMouseEvent(const SEvent &event)
 		{
 			//try to select a node
 			selectedVesselStack = 0;
-			scene::ISceneNode* selectedNode = collisionManager->getSceneNodeFromScreenCoordinatesBB(
-				device->getCursorControl()->getPosition(), VESSEL_ID, true);
-			if (selectedNode->getID() == VESSEL_ID)
+			core::line3df ray = collisionManager->getRayFromScreenCoordinates(device->getCursorControl()->getPosition());
+			VesselSceneNode* selectedNode = ScenePickingTree::getTree(smgr)->pickVessel(ray);
+			if (selectedNode != 0)
 			{
 				//it's a vessel!  Create the stack
-				selectedVesselStack = new VesselStack((VesselSceneNode*)selectedNode);
+				selectedVesselStack = new VesselStack(selectedNode);
 				selectedNode = 0;
 			}
 			setupSelectedStack();
@@ -726,21 +877,24 @@ bool StackEditor::processMouseEvent(const SEvent &event)
 		//AND we aren't selecting a node to split the stack
 		if (selectedVesselStack != 0 && !areSplittingStack && !camera->IsActionInProgress() && !isKeyDown[EKEY_CODE::KEY_LCONTROL])
 		{
+			std::chrono::high_resolution_clock::time_point moveStart = std::chrono::high_resolution_clock::now();
 			//move the stack
 			selectedVesselStack->moveStackReferenced(returnMouseRelativePos());
 
 			//try snapping
-			scene::ISceneNode* selectedNode = collisionManager->getSceneNodeFromScreenCoordinatesBB(
-				device->getCursorControl()->getPosition(), DOCKPORT_ID, true);
-			if (selectedNode->getID() == DOCKPORT_ID)
+			OrbiterDockingPort* selectedDockingPort = pickDockingPort(DOCKPORT_ID);
+			if (selectedDockingPort != 0)
 			{
-				selectedVesselStack->checkForSnapping((VesselSceneNode*)selectedNode->getParent(), selectedNode);
+				selectedVesselStack->checkForSnapping(selectedDockingPort);
 			}
 			else if (selectedVesselStack->isSnaped())
 				//there's no dockport nearby, release the stack from snap and set up a new move reference
 			{
 				selectedVesselStack->unSnap(returnMouseRelativePos());
 			}
+			checkInterpenetration(false);
+			Metrics::recordSample("input.mouse_move_us",
+				std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - moveStart).count());
 		}
 		//update camera position
 		camera->UpdatePosition((float)event.MouseInput.X, (float)event.MouseInput.Y, isKeyDown[EKEY_CODE::KEY_LCONTROL]);
@@ -765,6 +919,13 @@ void StackEditor::setupSelectedStack()
 	}
 }
 
+//returns the docking port under the mouse cursor whose marker is shown as markerType, or 0
+OrbiterDockingPort* StackEditor::pickDockingPort(u32 markerType)
+{
+	core::line3df ray = collisionManager->getRayFromScreenCoordinates(device->getCursorControl()->getPosition());
+	return ScenePickingTree::getTree(smgr)->pickDockingPort(ray, markerType);
+}
+
 void StackEditor::setAllDockingPortVisibility(bool showEmpty, bool showDocked)
 {
     if (selectedVesselStack != 0)
@@ -876,21 +1037,61 @@ void StackEditor::switchToolBox()
 void StackEditor::saveSession(std::string filename)
 {
     Log::writeToLog(Log::INFO, "Saving session to ", filename, ".ses");
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
 	std::string fullpath = Helpers::workingDirectory + "\\StackEditor\\Sessions\\" + filename + ".ses";
-	ofstream file(fullpath);
+	if (binarySessions)
+	{
+		if (!saveBinarySession(fullpath))
+			return;
+	}
+	else
+		saveTextSession(fullpath);
+	Metrics::recordSample("session.save_ms",
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+	session = filename;
+	savedScene = undoHistory.getScene();
+	updateCaption();
+}
+
+bool StackEditor::saveBinarySession(const std::string& path)
+{
+	SessionContents contents;
+	SessionFile::gather(uidVesselMap, contents);
+	try
+	{
+		SessionFile::write(path, contents);
+	}
+	catch (SessionFile::SessionFileError& e)
+	{
+		Log::writeToLog(Log::ERR, "Unable to save session: ", e.what());
+		guiEnv->addMessageBox(L"He's dead, Jim!", L"error while saving session");
+		return false;
+	}
+	Log::writeToLog(Log::INFO, "Saved binary session: ", contents.vessels.size(), " vessels, ", contents.dockings.size(), " dockings");
+	return true;
+}
+
+void StackEditor::saveTextSession(const std::string& path)
+{
+	ofstream file(path);
     //write version number
     file << "VERSION = 1\n";
 
+    //vessels are written ordered by uid, loading relies on the DOCKINFO entries being in the same order as the vessels
+    std::vector<VesselRegistryEntry> vessels;
+    uidVesselMap.getSorted(vessels);
+
     //write vessel info
-    for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+    for (auto it = vessels.begin(); it != vessels.end(); ++it)
     {
         it->second->saveState().saveToFile(file);
     }
 
     //write docking info
     file << "DOCKINFO =";
-    for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+    for (auto it = vessels.begin(); it != vessels.end(); ++it)
     {
         for (auto docking_it = it->second->dockingPorts.begin(); docking_it != it->second->dockingPorts.end(); ++docking_it)
         {
@@ -909,9 +1110,16 @@ void StackEditor::saveSession(std::string filename)
     }
 
 	file.close();
-	std::string newcaption = "Orbiter Stack Editor - " + filename;
+}
+
+//a star after the session name marks changes that haven't been saved yet
+void StackEditor::updateCaption()
+{
+	captionScene = undoHistory.getScene();
+	std::string newcaption = "Orbiter Stack Editor - " + session;
+	if (undoHistory.differsFrom(savedScene))
+		newcaption += " *";
 	device->setWindowCaption(std::wstring(newcaption.begin(), newcaption.end()).c_str());
-	session = filename;
 }
 
 
@@ -919,9 +1127,112 @@ bool StackEditor::loadSession(std::string path)
 {
     Helpers::resetDirectory();
     Log::writeToLog(Log::INFO, "Loading session from ", path);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 	clearSession();
+	//both versions are loaded, whatever the config says about saving
+	if (SessionFile::isBinary(path) ? !loadBinarySession(path) : !loadTextSession(path))
+		return false;
+	Metrics::recordSample("session.load_ms",
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	//docked before undo starts, so it doesn't mark the session as changed or get undone on its own
+	std::vector<VesselSceneNode*> loaded;
+	for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+		if (it->second->getID() == VESSEL_ID)
+			loaded.push_back(it->second);
+	autoDockCoincidentPorts("session load", loaded);
+
+	//the loaded session is where undo starts from
+	undoHistory.discardPending();
+	savedScene = undoHistory.getScene();
+	return true;
+}
+
+bool StackEditor::loadBinarySession(const std::string& path)
+{
+	SessionContents contents;
+	try
+	{
+		SessionFile::read(path, contents);
+	}
+	catch (SessionFile::SessionFileError& e)
+	{
+		Log::writeToLog(Log::ERR, "Unable to load session: ", e.what());
+		guiEnv->addMessageBox(L"He's dead, Jim!", L"error while loading session");
+		return false;
+	}
+
+	//the file names every class once, so every class only gets looked up once.
+	//all of them are resolved before the first vessel is created, so a missing one leaves the scene empty
+	std::vector<VesselData*> classes(contents.names.size(), (VesselData*)NULL);
+	std::vector<bool> classLoaded(contents.names.size(), false);
+	for (UINT i = 0; i < contents.vessels.size(); ++i)
+	{
+		UINT classIndex = contents.vessels[i].classIndex;
+		if (classLoaded[classIndex])
+			continue;
+		classes[classIndex] = dataManager.GetGlobalConfig(contents.names[classIndex], device->getVideoDriver());
+		classLoaded[classIndex] = true;
+		if (classes[classIndex] == NULL)
+		{
+			Log::writeToLog(Log::ERR, "Session contains a vessel that can't be loaded: ", contents.names[classIndex]);
+			guiEnv->addMessageBox(L"He's dead, Jim!", L"error while loading session");
+			return false;
+		}
+	}
+
+	VesselNodePool* pool = VesselNodePool::getPool(smgr);
+	for (UINT i = 0; i < contents.vessels.size(); ++i)
+	{
+		const SessionVessel& stored = contents.vessels[i];
+		VesselSceneNodeState state;
+		state.vesData = classes[stored.classIndex];
+		state.uid = stored.uid;
+		state.pos = stored.pos;
+		state.rot = stored.rot;
+		state.orbiterName = stored.orbiterName;
+		pool->acquire(state, smgr->getRootSceneNode(), VESSEL_ID);
+	}
+
+	//both ends of a docking are set before anyone is told
+	std::vector<VesselSceneNode*> docked;
+	for (UINT i = 0; i < contents.dockings.size(); ++i)
+	{
+		const SessionDocking& docking = contents.dockings[i];
+		VesselSceneNode* vessel = uidVesselMap.get(docking.vesselUID);
+		VesselSceneNode* other = uidVesselMap.get(docking.otherVesselUID);
+		if (vessel == 0 || other == 0 || docking.portID >= vessel->dockingPorts.size() || docking.otherPortID >= other->dockingPorts.size())
+		{
+			Log::writeToLog(Log::WARN, "Ignoring docking to a vessel or port that doesn't exist, UID: ", docking.vesselUID,
+				" port: ", docking.portID);
+			continue;
+		}
+		OrbiterDockingPort& port = vessel->dockingPorts[docking.portID];
+		OrbiterDockingPort& otherPort = other->dockingPorts[docking.otherPortID];
+		port.docked = true;
+		port.dockedTo.vesselUID = docking.otherVesselUID;
+		port.dockedTo.portID = docking.otherPortID;
+		otherPort.docked = true;
+		otherPort.dockedTo.vesselUID = docking.vesselUID;
+		otherPort.dockedTo.portID = docking.portID;
+		docked.push_back(vessel);
+		docked.push_back(other);
+	}
+	std::sort(docked.begin(), docked.end());
+	docked.erase(std::unique(docked.begin(), docked.end()), docked.end());
+	for (UINT i = 0; i < docked.size(); ++i)
+		docked[i]->dockingStatusChanged();
+
+	Log::writeToLog(Log::INFO, "Loaded binary session: ", contents.vessels.size(), " vessels, ", contents.dockings.size(), " dockings");
+	return true;
+}
+
+bool StackEditor::loadTextSession(const std::string& path)
+{
 	ifstream file(path.c_str());
 	std::vector<std::string> tokens;
+	//the whole file is read before any vessel gets created, so the uids can be checked first
+	std::vector<VesselSceneNodeState> states;
+	std::vector<std::string> dockInfo;
     int version = 1;
 	while (Helpers::readLine(file, tokens))
 	{
@@ -954,12 +1265,17 @@ bool StackEditor::loadSession(std::string path)
 				guiEnv->addMessageBox(L"He's dead, Jim!", L"No FILE declared for vessel, unable to load session");
 				return false;
 			}
+			VesselData* vesselData = dataManager.GetGlobalConfig(tokens[1], device->getVideoDriver());
+			if (vesselData == NULL)
+			{
+				Log::writeToLog(Log::ERR, "Session contains a vessel that can't be loaded: ", tokens[1]);
+				guiEnv->addMessageBox(L"He's dead, Jim!", L"error while loading session");
+				return false;
+			}
 
             try
             {
-                VesselSceneNode* newvessel = new VesselSceneNode(
-                    VesselSceneNodeState(dataManager.GetGlobalConfig(tokens[1], device->getVideoDriver()), file)
-                    , smgr->getRootSceneNode(), smgr, VESSEL_ID);
+                states.push_back(VesselSceneNodeState(vesselData, file));
             }
             catch (VesselSceneNodeState::VesselSceneNodeParseError)
 			{
@@ -968,32 +1284,79 @@ bool StackEditor::loadSession(std::string path)
 			}
 		}
 		else if (tokens[0].compare("DOCKINFO") == 0)
-		//establish docking connections
 		{
-			UINT tokenidx = 1;
-            for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
-            {
-                for (auto docking_it = it->second->dockingPorts.begin(); docking_it != it->second->dockingPorts.end(); ++docking_it)
-                {
-                    //take appart the token containing the index of the docked vessel and its dockport
-                    vector<std::string> connection;
-                    Helpers::tokenize(tokens[tokenidx], connection, ":");
-                    UINT vesselidx = Helpers::stringToInt(connection[0]);
-                    UINT portidx = Helpers::stringToInt(connection[1]);
-                    if (vesselidx != -1 && portidx != -1)
-                    {
-                        //we have a connection, update the dockport of the vessel
-                        docking_it->docked = true;
-                        docking_it->dockedTo.vesselUID = vesselidx;
-                        docking_it->dockedTo.portID = portidx;
-                    }
-                    tokenidx++;
-                }
-            }
+			dockInfo = tokens;
 		}
 		tokens.clear();
 	}
 	file.close();
+
+	//the uids come straight from the file. ones the registry can't take, and second vessels with the same uid,
+	//get a free uid instead. dockings to an out of range uid follow the vessel, dockings to a duplicate stay with the first one
+	std::vector<UINT> savedUIDs(states.size());
+	std::set<UINT> usedUIDs;
+	std::map<UINT, UINT> remappedUIDs;
+	std::vector<UINT> needNewUID;
+	for (UINT i = 0; i < states.size(); ++i)
+	{
+		savedUIDs[i] = states[i].uid;
+		if (states[i].uid > VesselRegistry::maxUID || !usedUIDs.insert(states[i].uid).second)
+			needNewUID.push_back(i);
+	}
+	UINT nextUID = 0;
+	for (UINT i = 0; i < needNewUID.size(); ++i)
+	{
+		VesselSceneNodeState& state = states[needNewUID[i]];
+		while (usedUIDs.count(nextUID))
+			++nextUID;
+		Log::writeToLog(Log::WARN, "Session vessel has an unusable or duplicate UID ", state.uid, ", loading it as UID ", nextUID);
+		if (state.uid > VesselRegistry::maxUID)
+			remappedUIDs[state.uid] = nextUID;
+		state.uid = nextUID;
+		usedUIDs.insert(nextUID);
+	}
+
+	std::vector<VesselSceneNode*> created(states.size());
+	VesselNodePool* pool = VesselNodePool::getPool(smgr);
+	for (UINT i = 0; i < states.size(); ++i)
+		created[i] = pool->acquire(states[i], smgr->getRootSceneNode(), VESSEL_ID);
+
+	//establish docking connections
+	if (dockInfo.size() > 0)
+	{
+		//the ports are listed in the order the vessels were saved in, which is by their uid in the file
+		std::vector<UINT> order(states.size());
+		for (UINT i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&savedUIDs](UINT a, UINT b) { return savedUIDs[a] < savedUIDs[b]; });
+
+		UINT tokenidx = 1;
+		for (UINT i = 0; i < order.size(); ++i)
+		{
+			VesselSceneNode* vessel = created[order[i]];
+			for (auto docking_it = vessel->dockingPorts.begin(); docking_it != vessel->dockingPorts.end() && tokenidx < dockInfo.size(); ++docking_it)
+			{
+				//take appart the token containing the index of the docked vessel and its dockport
+				vector<std::string> connection;
+				Helpers::tokenize(dockInfo[tokenidx], connection, ":");
+				tokenidx++;
+				if (connection.size() < 2)
+					continue;
+				UINT vesselidx = Helpers::stringToInt(connection[0]);
+				UINT portidx = Helpers::stringToInt(connection[1]);
+				if (vesselidx != -1 && portidx != -1)
+				{
+					if (remappedUIDs.count(vesselidx))
+						vesselidx = remappedUIDs[vesselidx];
+					//we have a connection, update the dockport of the vessel
+					docking_it->docked = true;
+					docking_it->dockedTo.vesselUID = vesselidx;
+					docking_it->dockedTo.portID = portidx;
+				}
+			}
+			vessel->dockingStatusChanged();
+		}
+	}
 	return true;
 }
 
@@ -1004,32 +1367,48 @@ void StackEditor::clearSession()
 
     //make a list of children to delete
     //because we can't remove directly from uidVesselMap because vessels auto-remove
-    std::vector<ISceneNode*> childrenToDelete;
+    std::vector<VesselSceneNode*> childrenToDelete;
     for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
     {
         childrenToDelete.push_back(it->second);
     }
 
+    //the next session most likely uses the same classes again
+    VesselNodePool* pool = VesselNodePool::getPool(smgr);
     for (UINT i = 0; i < childrenToDelete.size(); ++i)
     {
-        ISceneNode* vessel = childrenToDelete[i];
+        VesselSceneNode* vessel = childrenToDelete[i];
+        if (vessel->getID() == VESSEL_ID)
+        {
+            pool->release(vessel);
+            continue;
+        }
+        //the photo studio vessels live in a scene of their own, they don't belong in our pool
         vessel->removeAll(); //removeAll only drops children, not the node itself
         vessel->remove(); //remove from scene graph
         vessel->drop(); //We need the extra drop because we called VesselSceneNode, which returns a pointer
     }
 
+    if (staticBake)
+    {
+        staticBake->invalidate();
+    }
+    if (interpenetrationChecker)
+    {
+        interpenetrationChecker->clear();
+    }
+
     //clear undo and redo stacks
-    while (!redoStack.empty())
-        redoStack.pop();
-    while (!undoStack.empty())
-        undoStack.pop();
+    undoHistory.clear(uidVesselMap);
+    savedScene = undoHistory.getScene();
 }
 
-//creates a stack from importdata
-void StackEditor::importStack()
+//creates a stack from importdata, returns the created vessels
+std::vector<VesselSceneNode*> StackEditor::importStack()
 {
 	//vector to store the created vessels during creation. We need them in fixed order for the docking to work!
 	vector<VesselSceneNode*> createdvessels;
+	bool hasDocked = false;
 	while (_importdata->stack.size() > 0)
 	{
 		VesselExport newv = _importdata->stack.front();
@@ -1055,100 +1434,364 @@ void StackEditor::importStack()
 			OrbiterDockingPort *tgtport = &createdvessels[port.dockedToVessel]->dockingPorts[port.dockedToPort];
 			VesselSceneNode *curv = createdvessels[createdvessels.size() - 1];
 
-			//grab the new vessel, turn it into a stack and snap it to where it belongs
-			VesselStack *stack = new VesselStack(curv);
-			stack->snapStack(0, port.myindex, tgtport);
-			delete stack;
-			//set the actual dock status
+			//set the actual dock status, the vessel gets put where it belongs once everything is docked
 			curv->dock(curv->dockingPorts[port.myindex], *tgtport);
+			hasDocked = true;
 		}
 	}
+
+	if (hasDocked)
+	//every vessel docks to one created before it, so the whole stack can be placed in one go from the first one
+	{
+		VesselStack *stack = new VesselStack(createdvessels[0]);
+		stack->snapStack(0);
+		delete stack;
+	}
+	return createdvessels;
 }
 
-void StackEditor::pushUndoStack()
+//starts looking for vessels that intersect each other. while dragging, only the selected stack against the rest of the scene.
+//on demand, the vessels of the selected stack are checked against each other as well, or the whole scene if nothing is selected
+void StackEditor::checkInterpenetration(bool onDemand)
 {
-    //get new global state
-    SE_GlobalState currentState = SE_GlobalState(uidVesselMap);
+	std::vector<VesselSceneNode*> vessels;
+	if (selectedVesselStack != 0)
+	{
+		for (UINT i = 0; i < selectedVesselStack->numVessels(); ++i)
+			vessels.push_back(selectedVesselStack->getVessel(i));
+	}
+	else if (onDemand)
+	{
+		for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+			vessels.push_back(it->second);
+	}
+	if (vessels.size() > 0)
+		interpenetrationChecker->start(vessels, onDemand);
+}
 
-    //create diff state from CURRENT state to OLD state, that is the correct diff
-    undoStack.push(SE_DiffState(currentState, lastGlobalState));
-    lastGlobalState = currentState;
+//docks all free ports that sit on top of each other and tells the user which ones
+void StackEditor::autoDockCoincidentPorts(const std::string& reason, const std::vector<VesselSceneNode*>& moved)
+{
+	if (autoDockTolerance <= 0)
+		return;
+	std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> > pairs =
+		VesselStackOperations::dockCoincidentPorts(moved, smgr, autoDockTolerance);
+	if (pairs.size() == 0)
+		return;
+
+	Log::writeToLog(Log::INFO, "Automatically docked ", pairs.size(), " coincident port pairs after ", reason);
+	std::string msg = std::to_string(pairs.size()) + " more port pairs were sitting on top of each other and have been docked:\n";
+	for (UINT i = 0; i < pairs.size(); ++i)
+	{
+		std::string pairName = pairs[i].first->parent->getClassName() + " #" + std::to_string(pairs[i].first->parent->getUID()) +
+			" port " + std::to_string(pairs[i].first->portID) + " - " +
+			pairs[i].second->parent->getClassName() + " #" + std::to_string(pairs[i].second->parent->getUID()) +
+			" port " + std::to_string(pairs[i].second->portID);
+		Log::writeToLog(Log::INFO, "Auto-docked ", pairName);
+		//keep the message box on screen, the log has the full list
+		if (i < 10)
+			msg += pairName + "\n";
+		else if (i == 10)
+			msg += "...\nsee StackEditor.log for the full list.";
+	}
+	guiEnv->addMessageBox(L"Auto-docking", std::wstring(msg.begin(), msg.end()).c_str());
+}
 
-    //clear redo stack, if we do an action it destroys redo
-    while (!redoStack.empty())
-        redoStack.pop();
+void StackEditor::pushUndoStack()
+{
+    //only the vessels that changed since the last undo step end up in the new one
+    undoHistory.commit();
 }
 
 void StackEditor::undo()
 {
-    if (undoStack.size() > 0)
+    try
     {
-        try
-        {
-            Log::writeToLog(Log::INFO, "Undo triggered");
-            SE_GlobalState preUndoState = SE_GlobalState(uidVesselMap);
+        Log::writeToLog(Log::INFO, "Undo triggered");
+        if (!undoHistory.undo(smgr))
+            return;
+    }
+    catch (std::exception& e)
+    {
+        Log::writeToLog(Log::ERR, "Caught exception during undo: ", e.what());
+        //clear redo/undo stacks
+        undoHistory.clear(uidVesselMap);
+        guiEnv->addMessageBox(L"Undo failed", L"Something failed during undo, details logged and undo/redo stacks cleared.\nPlease report this on the StackEditor development thread.");
+    }
+    //undo moves vessels outside of the selected stack
+    if (staticBake)
+    {
+        staticBake->invalidate();
+    }
+}
 
-            undoStack.top().apply(smgr);
-            undoStack.pop();
+void StackEditor::redo()
+{
+    try
+    {
+        Log::writeToLog(Log::INFO, "Redo triggered");
+        if (!undoHistory.redo(smgr))
+            return;
+    }
+    catch (std::exception& e)
+    {
+        Log::writeToLog(Log::ERR, "Caught exception during redo: ", e.what());
+        //clear redo/undo stacks
+        undoHistory.clear(uidVesselMap);
+        guiEnv->addMessageBox(L"Redo failed", L"Something failed during redo, details logged and undo/redo stacks cleared.\nPlease report this on the StackEditor development thread.");
+    }
+    if (staticBake)
+    {
+        staticBake->invalidate();
+    }
+}
 
-            //get new global state
-            SE_GlobalState postUndoState = SE_GlobalState(uidVesselMap);
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
-            //create diff state from CURRENT state to OLD state, that is the correct diff
-            redoStack.push(SE_DiffState(postUndoState, preUndoState));
+//measures the editor on scenes of growing size, doing what a user would do, and records the results as benchmark.<vessels>.*.
+//the scenes are a docked chain of the class that was spawned last, so that class needs at least two docking ports.
+//only runs on a saved session: the session is stashed and loaded back afterwards as it was, but its undo history is lost.
+//the results go to StackEditor/benchmark_<driver>.csv, so runs on different drivers can be compared
+void StackEditor::runBenchmark()
+{
+	benchmarkRequested = false;
+	if (lastSpawnedVessel == NULL || lastSpawnedVessel->dockingPorts.size() < 2)
+	{
+		Log::writeToLog(Log::WARN, "The benchmark needs a vessel class with at least two docking ports, spawn one first");
+		guiEnv->addMessageBox(L"Benchmark", L"The benchmark needs a vessel class with at least two docking ports.\nSpawn one first, the benchmark fills the scene with that class.");
+		return;
+	}
+	if (undoHistory.differsFrom(savedScene))
+	{
+		Log::writeToLog(Log::WARN, "Not running the benchmark, the session has unsaved changes");
+		guiEnv->addMessageBox(L"Benchmark", L"The session has unsaved changes, save it before running the benchmark.\nThe benchmark replaces the scene while it runs and loses the undo history.");
+		return;
+	}
+	VesselData* vesselClass = lastSpawnedVessel;
 
-            //set global state
-            lastGlobalState = SE_GlobalState(uidVesselMap);
-        }
-        catch (std::exception& e)
-        {
-            Log::writeToLog(Log::ERR, "Caught exception during undo: ", e.what());
-            //clear redo/undo stacks
-            while (!redoStack.empty())
-                redoStack.pop();
-            while (!undoStack.empty())
-                undoStack.pop();
-            //restore last known state
-            lastGlobalState.apply(smgr);
-            guiEnv->addMessageBox(L"Undo failed", L"Something failed during undo, details logged and undo/redo stacks cleared.\nPlease report this on the StackEditor development thread.");
+	//file dialogs change the working directory, everything goes by absolute paths like saving and loading sessions do
+	Helpers::resetDirectory();
+	std::string stashPath = Helpers::workingDirectory + "\\StackEditor\\benchmark_stash.ses";
+	if (!saveBinarySession(stashPath))
+	{
+		Log::writeToLog(Log::ERR, "Not running the benchmark, the session couldn't be stashed at ", stashPath);
+		return;
+	}
 
-        }
-    }
+	std::string driverName;
+	switch (device->getVideoDriver()->getDriverType())
+	{
+	case video::EDT_NULL:			driverName = "null"; break;
+	case video::EDT_SOFTWARE:		driverName = "software"; break;
+	case video::EDT_BURNINGSVIDEO:	driverName = "burnings"; break;
+	case video::EDT_DIRECT3D9:		driverName = "d3d9"; break;
+	case video::EDT_OPENGL:			driverName = "opengl"; break;
+	default:						driverName = "other"; break;
+	}
+	Log::writeToLog(Log::INFO, "Starting benchmark with ", vesselClass->className, " on the ", driverName, " driver");
+
+	//the selected stack and the highlights would point at vessels that are about to go
+	setAllDockingPortVisibility(false, false);
+	delete selectedVesselStack;
+	selectedVesselStack = 0;
+	interpenetrationChecker->clear();
+
+	const UINT vesselCounts[] = { 10, 100, 500, 1000, 10000 };
+	for (UINT i = 0; i < sizeof(vesselCounts) / sizeof(vesselCounts[0]); ++i)
+		benchmarkScene(vesselClass, vesselCounts[i]);
+
+	//back exactly as it was saved. not through loadSession, auto-docking has no business changing the user's session
+	clearSession();
+	Helpers::resetDirectory();
+	if (loadBinarySession(stashPath))
+		std::remove(stashPath.c_str());
+	else
+	{
+		Log::writeToLog(Log::ERR, "Couldn't restore the session after the benchmark, it is still in ", stashPath);
+		std::string msg = "The session couldn't be restored after the benchmark.\nIt is still there, in " + stashPath;
+		guiEnv->addMessageBox(L"He's dead, Jim!", std::wstring(msg.begin(), msg.end()).c_str());
+	}
+	undoHistory.clear(uidVesselMap);
+	savedScene = undoHistory.getScene();
+	updateCaption();
+
+	std::string csvPath = Helpers::workingDirectory + "\\StackEditor\\benchmark_" + driverName + ".csv";
+	if (Metrics::writeCSV(csvPath))
+		Log::writeToLog(Log::INFO, "Benchmark done, wrote results to ", csvPath);
+	else
+		Log::writeToLog(Log::ERR, "Benchmark done, but could not write ", csvPath);
 }
 
-void StackEditor::redo()
+void StackEditor::benchmarkScene(VesselData* vesselClass, UINT vesselCount)
 {
-    if (redoStack.size() > 0)
-    {
-        try
-        {
-            Log::writeToLog(Log::INFO, "Redo triggered");
-            SE_GlobalState preRedoState = SE_GlobalState(uidVesselMap);
+	typedef std::chrono::high_resolution_clock clock;
+	std::string prefix = "benchmark." + std::to_string(vesselCount) + ".";
+	Log::writeToLog(Log::INFO, "Benchmarking ", vesselCount, " vessels");
+	clearSession();
+	std::mt19937 random(vesselCount);
 
-            redoStack.top().apply(smgr);
-            redoStack.pop();
-            //get new global state
-            SE_GlobalState postRedoState = SE_GlobalState(uidVesselMap);
+	//every vessel docks its first port to the second port of the one before it, the solver places them all in one go
+	clock::time_point start = clock::now();
+	VesselNodePool* pool = VesselNodePool::getPool(smgr);
+	std::vector<VesselSceneNode*> chain;
+	for (UINT i = 0; i < vesselCount; ++i)
+	{
+		chain.push_back(pool->acquire(vesselClass, smgr->getRootSceneNode(), VESSEL_ID));
+		if (i > 0)
+			chain[i]->dock(chain[i]->dockingPorts[0], chain[i - 1]->dockingPorts[1]);
+	}
+	Metrics::recordSample(prefix + "create_ms", millisecondsSince(start));
+	start = clock::now();
+	{
+		VesselStack stack(chain[0]);
+		stack.snapStack(0);
+	}
+	Metrics::recordSample(prefix + "snap_stack_ms", millisecondsSince(start));
+	for (UINT i = 0; i < chain.size(); ++i)
+		chain[i]->updateAbsolutePosition();
+	undoHistory.discardPending();
 
-            //create diff state from CURRENT state to OLD state, that is the correct diff
-            undoStack.push(SE_DiffState(postRedoState, preRedoState));
+	video::IVideoDriver* driver = device->getVideoDriver();
+	for (UINT i = 0; i < 30; ++i)
+		Metrics::recordSample(prefix + "frame_ms", drawFrame(driver));
 
-            //set global state
-            lastGlobalState = SE_GlobalState(uidVesselMap);
-        }
-        catch (std::exception& e)
-        {
-            Log::writeToLog(Log::ERR, "Caught exception during redo: ", e.what());
-            //clear redo/undo stacks
-            while (!redoStack.empty())
-                redoStack.pop();
-            while (!undoStack.empty())
-                undoStack.pop();
-            //restore last known state
-            lastGlobalState.apply(smgr);
-            guiEnv->addMessageBox(L"Redo failed", L"Something failed during redo, details logged and undo/redo stacks cleared.\nPlease report this on the StackEditor development thread.");
+	//picking rays through random vessels, the way a click finds them
+	std::uniform_int_distribution<UINT> anyVessel(0, vesselCount - 1);
+	for (UINT i = 0; i < 200; ++i)
+	{
+		core::vector3df target = chain[anyVessel(random)]->getTransformedBoundingBox().getCenter();
+		core::line3df ray = collisionManager->getRayFromScreenCoordinates(collisionManager->getScreenCoordinatesFrom3DPosition(target));
+		start = clock::now();
+		ScenePickingTree::getTree(smgr)->pickVessel(ray);
+		Metrics::recordSample(prefix + "pick_us", millisecondsSince(start) * 1000);
+	}
 
-        }
+	//uid lookups and whole scene passes, against the std::map the registry replaced
+	std::vector<UINT> uids;
+	std::map<UINT, VesselSceneNode*> uidMap;
+	for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+	{
+		uids.push_back(it->first);
+		uidMap[it->first] = it->second;
+	}
+	std::shuffle(uids.begin(), uids.end(), random);
+	const UINT lookups = 1000000;
+	const UINT passes = 100;
+	size_t checksum = 0;
+	start = clock::now();
+	for (UINT i = 0; i < lookups; ++i)
+		checksum += Helpers::getVesselByUID(uids[i % uids.size()])->dockingPorts.size();
+	Metrics::recordSample(prefix + "registry_lookup_ns", millisecondsSince(start) * 1000000 / lookups);
+	start = clock::now();
+	for (UINT i = 0; i < lookups; ++i)
+		checksum += uidMap.at(uids[i % uids.size()])->dockingPorts.size();
+	Metrics::recordSample(prefix + "map_lookup_ns", millisecondsSince(start) * 1000000 / lookups);
+	start = clock::now();
+	for (UINT pass = 0; pass < passes; ++pass)
+		for (auto it = uidVesselMap.begin(); it != uidVesselMap.end(); ++it)
+			checksum += it->second->dockingPorts.size();
+	Metrics::recordSample(prefix + "registry_iterate_us", millisecondsSince(start) * 1000 / passes);
+	start = clock::now();
+	for (UINT pass = 0; pass < passes; ++pass)
+		for (auto it = uidMap.begin(); it != uidMap.end(); ++it)
+			checksum += it->second->dockingPorts.size();
+	Metrics::recordSample(prefix + "map_iterate_us", millisecondsSince(start) * 1000 / passes);
+	//only there so the loops above can't be left out
+	Metrics::setGauge("benchmark.checksum", (double)checksum);
+
+	start = clock::now();
+	for (UINT i = 0; i < 1000; ++i)
+	{
+		SceneState snapshot = undoHistory.getScene();
+	}
+	Metrics::recordSample(prefix + "snapshot_ns", millisecondsSince(start) * 1000);
+
+	//one vessel moves, the diff only has to walk the path to it
+	SceneState beforeMove = undoHistory.getScene();
+	chain[0]->setPosition(chain[0]->getPosition() + core::vector3df(0, 0, 1));
+	pushUndoStack();
+	std::vector<SceneStateChange> changes;
+	start = clock::now();
+	beforeMove.diff(undoHistory.getScene(), changes);
+	Metrics::recordSample(prefix + "diff_one_us", millisecondsSince(start) * 1000);
+
+	//paste a copy of the whole chain, drag it onto the free port at the start of the chain, delete it, then undo and redo all of it
+	OrbiterDockingPort* freePort = &chain[0]->dockingPorts[0];
+	for (UINT cycle = 0; cycle < 3; ++cycle)
+	{
+		SceneState beforePaste = undoHistory.getScene();
+		start = clock::now();
+		std::vector<VesselSceneNode*> copies;
+		{
+			VesselStack original(chain[0]);
+			copies = VesselStackOperations::copyStack(&original, smgr);
+		}
+		pushUndoStack();
+		Metrics::recordSample(prefix + "paste_ms", millisecondsSince(start));
 
-    }
+		changes.clear();
+		start = clock::now();
+		beforePaste.diff(undoHistory.getScene(), changes);
+		Metrics::recordSample(prefix + "diff_paste_us", millisecondsSince(start) * 1000);
+
+		{
+			VesselStack dragged(copies[0]);
+			core::vector3df reference(0, 0, 0);
+			dragged.setMoveReference(reference);
+			for (UINT move = 0; move < 20; ++move)
+			{
+				start = clock::now();
+				dragged.moveStackReferenced(reference + core::vector3df((f32)move, 0, 0));
+				dragged.checkForSnapping(freePort);
+				if (dragged.isSnaped())
+					dragged.unSnap(reference);
+				Metrics::recordSample(prefix + "drag_move_us", millisecondsSince(start) * 1000);
+			}
+		}
+		pushUndoStack();
+
+		start = clock::now();
+		{
+			VesselStack doomed(copies[0]);
+			VesselStackOperations::deleteStack(&doomed);
+		}
+		pushUndoStack();
+		Metrics::recordSample(prefix + "delete_ms", millisecondsSince(start));
+
+		//delete, drag and paste
+		for (UINT step = 0; step < 3; ++step)
+		{
+			start = clock::now();
+			undo();
+			Metrics::recordSample(prefix + "undo_ms", millisecondsSince(start));
+		}
+		for (UINT step = 0; step < 3; ++step)
+		{
+			start = clock::now();
+			redo();
+			Metrics::recordSample(prefix + "redo_ms", millisecondsSince(start));
+		}
+	}
+
+	//both formats, loading goes through loadSession like opening a file does
+	Helpers::resetDirectory();
+	std::string textPath = Helpers::workingDirectory + "\\StackEditor\\benchmark_text.ses";
+	std::string binaryPath = Helpers::workingDirectory + "\\StackEditor\\benchmark_binary.ses";
+	start = clock::now();
+	saveTextSession(textPath);
+	Metrics::recordSample(prefix + "save_text_ms", millisecondsSince(start));
+	start = clock::now();
+	saveBinarySession(binaryPath);
+	Metrics::recordSample(prefix + "save_binary_ms", millisecondsSince(start));
+	start = clock::now();
+	loadSession(textPath);
+	Metrics::recordSample(prefix + "load_text_ms", millisecondsSince(start));
+	start = clock::now();
+	loadSession(binaryPath);
+	Metrics::recordSample(prefix + "load_binary_ms", millisecondsSince(start));
+	std::remove(textPath.c_str());
+	std::remove(binaryPath.c_str());
 }
@@ -5,20 +5,30 @@
 #include <irrlicht.h>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 #include <stack>
 #include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
 
 #include "resource.h"
 #include "VesselSceneNode.h"
 #include "VesselStack.h"
 #include "VesselStackOperations.h"
+#include "VesselNodePool.h"
+#include "SessionFile.h"
 #include "SE_State.h"
 //#include "CSceneNodeAnimatorCameraCustom.h"
 #include "StackEditorCamera.h"
 #include "DataManager.h"
 #include "SE_ToolBox.h"
 #include "SE_PhotoStudio.h"
+#include "StaticGeometryBake.h"
+#include "FrameScheduler.h"
+#include "InterpenetrationChecker.h"
+#include "Metrics.h"
 #include "StackExportStructs.h"
 #include "Log.h"
 
@@ -35,7 +45,7 @@ class StackEditor : public IEventReceiver
 public:
 	StackEditor(ExportData *exportdata = NULL, ImportData *importdata = NULL);
 	~StackEditor();
-	void setupDevice(IrrlichtDevice * _device, std::string toolboxSet);
+	void setupDevice(IrrlichtDevice * _device, const CONFIGPARAMS& params);
 	void loop();
 	bool OnEvent(const SEvent & event);
 
@@ -53,7 +63,7 @@ private:
 	std::string tbxSet;
 	gui::IGUIEnvironment* guiEnv;
 
-    std::map<UINT, VesselSceneNode*> uidVesselMap;
+    VesselRegistry uidVesselMap;
 	bool isKeyDown[KEY_KEY_CODES_COUNT];
 	bool isOpenDialogOpen;
 	IrrlichtDevice * device;
@@ -64,9 +74,22 @@ private:
 	scene::ISceneCollisionManager* collisionManager;
 	scene::ISceneManager* smgr;
 	DataManager dataManager;
+	StaticGeometryBake* staticBake;												//only exists if static baking is switched on in the config
+	SoftwareOcclusionCuller* occlusionCuller;									//only exists if occlusion culling is switched on in the config
+	FrameScheduler* frameScheduler;												//decides when the scene actually needs redrawing
+	InterpenetrationChecker* interpenetrationChecker;							//highlights vessels stuck inside each other
+	void checkInterpenetration(bool onDemand);
+	bool showMetricsOverlay;													//toggled with F3
+	double drawFrame(video::IVideoDriver* driver);
+	void publishFrameMetrics(double frameTime);
+	void drawMetricsOverlay(video::IVideoDriver* driver);
+	bool benchmarkRequested;													//shift+F4, runs from the loop, not from inside the key event
+	void runBenchmark();
+	void benchmarkScene(VesselData* vesselClass, UINT vesselCount);
 	VesselSceneNode *addVessel(VesselData* vesseldata, bool snaptocursor = true);		//adds a new vessel to the scene
 
     void setAllDockingPortVisibility(bool showEmpty, bool showDocked);
+	OrbiterDockingPort* pickDockingPort(u32 markerType);
 	
 	bool cursorOnGui;															//registers when the cursor is over a GUI element, so events can be passed on
 	bool dialogOpen;															//true while dialog windows are open
@@ -83,17 +106,25 @@ private:
 
 	void saveSession(std::string filename);
 	bool loadSession(std::string path);
+	void saveTextSession(const std::string& path);
+	bool loadTextSession(const std::string& path);
+	bool saveBinarySession(const std::string& path);
+	bool loadBinarySession(const std::string& path);
+	bool binarySessions;														//new sessions are saved as VERSION 2
 	void clearSession();
-	void importStack();
+	std::vector<VesselSceneNode*> importStack();
+	f32 autoDockTolerance;														//0 if automatic docking of coincident ports is switched off
+	void autoDockCoincidentPorts(const std::string& reason, const std::vector<VesselSceneNode*>& moved);
 
-    std::stack<SE_DiffState> undoStack;
-    std::stack<SE_DiffState> redoStack;
+    SE_UndoHistory undoHistory;
     void undo();
     void redo();
     void pushUndoStack();
-    SE_GlobalState lastGlobalState;
 
 	std::string session;
+	SceneState savedScene;				//the scene as it was last loaded or saved
+	SceneState captionScene;			//the scene the window caption was last updated for
+	void updateCaption();
 	ExportData *_exportdata;
 	ImportData *_importdata;
 };
@@ -50,6 +50,16 @@ void StackExport::prepareExportData()
 		}
 		_vessels.push(newv);
 	}
+
+	if (_data->stack->getStackSize() > 0)
+	//orbiter works out the mass properties of the stack itself, these are for reference
+	{
+		StackMassReport mass = StackMassProperties::getStackProperties(_data->stack->getVessel(0));
+		Log::writeToLog(Log::INFO, "Exporting stack of ", mass.vessels, " vessels. dry mass: ", mass.dry.mass, " kg, wet mass: ", mass.wet.mass,
+			" kg, center of mass (wet): ", mass.wet.centerOfMass.X, " ", mass.wet.centerOfMass.Y, " ", mass.wet.centerOfMass.Z,
+			", inertia (wet, xx yy zz): ", mass.wet.inertia[0], " ", mass.wet.inertia[1], " ", mass.wet.inertia[2],
+			", power in/out: ", mass.powerInput, "/", mass.powerOutput, " W, thrust: ", mass.thrust, " N, crew capacity: ", mass.crewCapacity);
+	}
 }
 
 
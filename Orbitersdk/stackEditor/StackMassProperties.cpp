@@ -0,0 +1,207 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "StackMassProperties.h"
+#include "VesselSceneNode.h"
+#include "DockingGraph.h"
+
+std::vector<MassSums> StackMassProperties::vesselSums;
+std::vector<MassSums> StackMassProperties::componentSums;
+
+MassMoments::MassMoments() : mass(0)
+{
+	for (int i = 0; i < 3; i++)
+		first[i] = 0;
+	for (int i = 0; i < 6; i++)
+		second[i] = 0;
+}
+
+void MassMoments::add(const MassMoments& other)
+{
+	mass += other.mass;
+	for (int i = 0; i < 3; i++)
+		first[i] += other.first[i];
+	for (int i = 0; i < 6; i++)
+		second[i] += other.second[i];
+}
+
+void MassMoments::subtract(const MassMoments& other)
+{
+	mass -= other.mass;
+	for (int i = 0; i < 3; i++)
+		first[i] -= other.first[i];
+	for (int i = 0; i < 6; i++)
+		second[i] -= other.second[i];
+}
+
+MassSums::MassSums() : powerInput(0), powerOutput(0), thrust(0), crewCapacity(0), vessels(0)
+{
+}
+
+void MassSums::add(const MassSums& other)
+{
+	dry.add(other.dry);
+	wet.add(other.wet);
+	powerInput += other.powerInput;
+	powerOutput += other.powerOutput;
+	thrust += other.thrust;
+	crewCapacity += other.crewCapacity;
+	vessels += other.vessels;
+}
+
+void MassSums::subtract(const MassSums& other)
+{
+	dry.subtract(other.dry);
+	wet.subtract(other.wet);
+	powerInput -= other.powerInput;
+	powerOutput -= other.powerOutput;
+	thrust -= other.thrust;
+	crewCapacity -= other.crewCapacity;
+	vessels -= other.vessels;
+}
+
+//a point mass with a diagonal inertia tensor in its own axes, rotated into the world and moved out to where it is
+static MassMoments momentsOf(f64 mass, const core::vector3d<f64>& inertiaPerMass, const core::matrix4& transformation)
+{
+	MassMoments moments;
+	moments.mass = mass;
+	core::vector3df position = transformation.getTranslation();
+	f64 p[3] = { position.X, position.Y, position.Z };
+	for (int i = 0; i < 3; i++)
+		moments.first[i] = mass * p[i];
+
+	//R * I * R^T, the columns of the rotation are the rotated axes of the vessel
+	f64 local[3] = { mass * inertiaPerMass.X, mass * inertiaPerMass.Y, mass * inertiaPerMass.Z };
+	f64 world[3][3];
+	for (int a = 0; a < 3; a++)
+	{
+		for (int b = 0; b < 3; b++)
+		{
+			world[a][b] = 0;
+			for (int k = 0; k < 3; k++)
+				world[a][b] += transformation[k * 4 + a] * local[k] * transformation[k * 4 + b];
+		}
+	}
+
+	//parallel axis theorem, about the world origin
+	f64 distanceSq = p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+	moments.second[0] = world[0][0] + mass * (distanceSq - p[0] * p[0]);
+	moments.second[1] = world[1][1] + mass * (distanceSq - p[1] * p[1]);
+	moments.second[2] = world[2][2] + mass * (distanceSq - p[2] * p[2]);
+	moments.second[3] = world[0][1] - mass * p[0] * p[1];
+	moments.second[4] = world[0][2] - mass * p[0] * p[2];
+	moments.second[5] = world[1][2] - mass * p[1] * p[2];
+	return moments;
+}
+
+MassSums MassSums::forVessel(const VesselMassData& data, const core::matrix4& transformation, const core::aabbox3df& meshBox)
+{
+	core::vector3d<f64> inertiaPerMass;
+	if (data.hasPmi)
+		inertiaPerMass = core::vector3d<f64>(data.pmi.X, data.pmi.Y, data.pmi.Z);
+	else
+	{
+		//a solid box the size of the mesh is better than nothing
+		core::vector3df extent = meshBox.getExtent();
+		inertiaPerMass = core::vector3d<f64>(
+			(extent.Y * extent.Y + extent.Z * extent.Z) / 12.0,
+			(extent.X * extent.X + extent.Z * extent.Z) / 12.0,
+			(extent.X * extent.X + extent.Y * extent.Y) / 12.0);
+	}
+
+	//orbiter puts the center of mass of a vessel at its origin, the fuel is assumed to sit there as well
+	MassSums sums;
+	sums.dry = momentsOf(data.mass, inertiaPerMass, transformation);
+	sums.wet = momentsOf(data.mass + data.maxFuel, inertiaPerMass, transformation);
+	sums.powerInput = data.powerInput;
+	sums.powerOutput = data.powerOutput;
+	sums.thrust = data.thrust;
+	sums.crewCapacity = data.crewCapacity;
+	sums.vessels = 1;
+	return sums;
+}
+
+MassProperties MassProperties::fromMoments(const MassMoments& moments)
+{
+	MassProperties result;
+	result.mass = moments.mass;
+	if (moments.mass <= 0)
+	{
+		result.centerOfMass = core::vector3d<f64>(0, 0, 0);
+		for (int i = 0; i < 6; i++)
+			result.inertia[i] = 0;
+		return result;
+	}
+	f64 c[3] = { moments.first[0] / moments.mass, moments.first[1] / moments.mass, moments.first[2] / moments.mass };
+	result.centerOfMass = core::vector3d<f64>(c[0], c[1], c[2]);
+
+	//parallel axis theorem again, from the origin back to the center of mass
+	f64 distanceSq = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+	result.inertia[0] = moments.second[0] - moments.mass * (distanceSq - c[0] * c[0]);
+	result.inertia[1] = moments.second[1] - moments.mass * (distanceSq - c[1] * c[1]);
+	result.inertia[2] = moments.second[2] - moments.mass * (distanceSq - c[2] * c[2]);
+	result.inertia[3] = moments.second[3] + moments.mass * c[0] * c[1];
+	result.inertia[4] = moments.second[4] + moments.mass * c[0] * c[2];
+	result.inertia[5] = moments.second[5] + moments.mass * c[1] * c[2];
+	return result;
+}
+
+void StackMassProperties::vesselAdded(unsigned int vessel, unsigned int component, VesselSceneNode* node)
+{
+	if (vessel >= vesselSums.size())
+		vesselSums.resize(vessel + 1);
+	vesselSums[vessel] = MassSums::forVessel(node->returnVesselData()->massData, node->getAbsoluteTransformation(), node->getBoundingBox());
+	//a new vessel always gets a new component of its own
+	componentSums[component] = vesselSums[vessel];
+}
+
+void StackMassProperties::vesselRemoved(unsigned int vessel, unsigned int component)
+{
+	componentSums[component].subtract(vesselSums[vessel]);
+	vesselSums[vessel] = MassSums();
+}
+
+void StackMassProperties::vesselMovedToComponent(unsigned int vessel, unsigned int from, unsigned int to)
+{
+	componentSums[from].subtract(vesselSums[vessel]);
+	componentSums[to].add(vesselSums[vessel]);
+}
+
+void StackMassProperties::componentsMerged(unsigned int into, unsigned int from)
+{
+	componentSums[into].add(componentSums[from]);
+	componentSums[from] = MassSums();
+}
+
+void StackMassProperties::componentCreated(unsigned int component)
+{
+	if (component >= componentSums.size())
+		componentSums.resize(component + 1);
+	componentSums[component] = MassSums();
+}
+
+void StackMassProperties::vesselMoved(VesselSceneNode* node)
+{
+	unsigned int vessel = node->getGraphIndex();
+	unsigned int component = DockingGraph::getComponentIndex(node);
+	componentSums[component].subtract(vesselSums[vessel]);
+	vesselSums[vessel] = MassSums::forVessel(node->returnVesselData()->massData, node->getAbsoluteTransformation(), node->getBoundingBox());
+	componentSums[component].add(vesselSums[vessel]);
+}
+
+StackMassReport StackMassProperties::getStackProperties(VesselSceneNode* node)
+{
+	return makeReport(componentSums[DockingGraph::getComponentIndex(node)]);
+}
+
+StackMassReport StackMassProperties::makeReport(const MassSums& sums)
+{
+	StackMassReport report;
+	report.dry = MassProperties::fromMoments(sums.dry);
+	report.wet = MassProperties::fromMoments(sums.wet);
+	report.powerInput = sums.powerInput;
+	report.powerOutput = sums.powerOutput;
+	report.thrust = sums.thrust;
+	report.crewCapacity = sums.crewCapacity;
+	report.vessels = sums.vessels;
+	return report;
+}
@@ -0,0 +1,96 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+
+using namespace irr;
+
+class VesselSceneNode;
+
+//mass and IMS figures of a vessel class, as read from its cfg
+struct VesselMassData
+{
+	VesselMassData() : mass(0), maxFuel(0), hasPmi(false), powerInput(0), powerOutput(0), thrust(0), crewCapacity(0) {}
+	f64 mass;					//dry mass in kg
+	f64 maxFuel;
+	core::vector3df pmi;		//principal moments of inertia per unit mass, in m^2
+	bool hasPmi;				//if not, the inertia is estimated from the bounding box of the mesh
+	f64 powerInput;				//in W
+	f64 powerOutput;
+	f64 thrust;					//in N, summed over all thrusters of the module
+	u32 crewCapacity;
+};
+
+//the moments of a mass distribution. all of them are plain sums over the vessels, which is what makes adding
+//and removing single vessels possible. the second moment is about the world origin, in world axes
+struct MassMoments
+{
+	MassMoments();
+	void add(const MassMoments& other);
+	void subtract(const MassMoments& other);
+
+	f64 mass;
+	f64 first[3];				//sum of mass * position
+	f64 second[6];				//inertia about the origin: xx, yy, zz, xy, xz, yz
+};
+
+//everything that gets summed up per stack
+struct MassSums
+{
+	MassSums();
+	void add(const MassSums& other);
+	void subtract(const MassSums& other);
+	//the contribution of one vessel in the world, with the center of mass at its origin
+	static MassSums forVessel(const VesselMassData& data, const core::matrix4& transformation, const core::aabbox3df& meshBox);
+
+	MassMoments dry, wet;
+	f64 powerInput, powerOutput, thrust;
+	u32 crewCapacity;
+	u32 vessels;
+};
+
+//what a query returns. the inertia tensor is about the center of mass, in world axes
+struct MassProperties
+{
+	f64 mass;
+	core::vector3d<f64> centerOfMass;
+	f64 inertia[6];				//xx, yy, zz, xy, xz, yz
+
+	static MassProperties fromMoments(const MassMoments& moments);
+};
+
+struct StackMassReport
+{
+	MassProperties dry, wet;
+	f64 powerInput, powerOutput, thrust;
+	u32 crewCapacity;
+	u32 vessels;
+};
+
+//mass, center of mass and inertia of every stack, kept up to date by the DockingGraph as vessels come, go, dock and undock.
+//every vessel keeps its own contribution and every stack the sum of them, so a change only costs the vessels it moves
+//from one stack to another, and a moved vessel only has to swap its old contribution for the new one.
+//the sums are doubles, so adding and taking away contributions over and over doesn't drift noticeably
+class StackMassProperties
+{
+public:
+	//called by the DockingGraph, indices are its vessel and component indices
+	static void vesselAdded(unsigned int vessel, unsigned int component, VesselSceneNode* node);
+	static void vesselRemoved(unsigned int vessel, unsigned int component);
+	static void vesselMovedToComponent(unsigned int vessel, unsigned int from, unsigned int to);
+	static void componentsMerged(unsigned int into, unsigned int from);
+	static void componentCreated(unsigned int component);
+
+	//the vessel was moved or rotated in the world
+	static void vesselMoved(VesselSceneNode* node);
+
+	//properties of the stack the vessel is part of
+	static StackMassReport getStackProperties(VesselSceneNode* node);
+	static StackMassReport makeReport(const MassSums& sums);
+
+private:
+	static std::vector<MassSums> vesselSums;
+	static std::vector<MassSums> componentSums;
+};
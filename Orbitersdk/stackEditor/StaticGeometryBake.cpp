@@ -0,0 +1,361 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "StaticGeometryBake.h"
+
+StaticGeometryBake::StaticGeometryBake(scene::ISceneNode* parent, scene::ISceneManager* mgr)
+	: scene::ISceneNode(parent, mgr, 0), nextId(1), lastSelectedStack(0), lastSelectedSize(0),
+	lastVesselCount(0), needsReconcile(true), jobMutex("StaticGeometryBake::jobMutex"), stopWorker(false)
+{
+	//the chunks get culled individually in render()
+	setAutomaticCulling(scene::EAC_OFF);
+	identity.makeIdentity();
+	worker = std::thread(&StaticGeometryBake::workerLoop, this);
+}
+
+StaticGeometryBake::~StaticGeometryBake()
+{
+	//stop the bake thread before freeing anything it might still be writing to
+	jobMutex.lock(__FUNCTION__);
+	stopWorker = true;
+	jobMutex.unlock();
+	jobCondition.notify_all();
+	worker.join();
+
+	for (UINT i = 0; i < finishedChunks.size(); ++i)
+		freeChunk(finishedChunks[i]);
+	for (std::map<UINT, StaticBakeChunk*>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+		freeChunk(it->second);
+}
+
+//the driver keeps its own reference to every buffer it has uploaded, dropping ours alone would keep
+//the vertices and the hardware buffer around until the driver gets around to expiring the link
+void StaticGeometryBake::freeChunk(StaticBakeChunk* chunk)
+{
+	video::IVideoDriver* driver = SceneManager->getVideoDriver();
+	Helpers::videoDriverMutex.lock(__FUNCTION__);
+	for (UINT i = 0; i < chunk->buffers.size(); ++i)
+	{
+		driver->removeHardwareBuffer(chunk->buffers[i]);
+		chunk->buffers[i]->drop();
+	}
+	Helpers::videoDriverMutex.unlock();
+	delete chunk;
+}
+
+void StaticGeometryBake::update(const VesselRegistry& vessels, VesselStack* selectedStack)
+{
+	//pick up whatever the bake thread finished since the last frame
+	std::vector<StaticBakeChunk*> arrived;
+	jobMutex.lock(__FUNCTION__);
+	arrived.swap(finishedChunks);
+	jobMutex.unlock();
+	for (UINT i = 0; i < arrived.size(); ++i)
+		installChunk(arrived[i], vessels);
+
+	UINT selectedSize = selectedStack ? selectedStack->numVessels() : 0;
+	if (needsReconcile || selectedStack != lastSelectedStack || selectedSize != lastSelectedSize || vessels.size() != lastVesselCount)
+	{
+		reconcile(vessels, selectedStack);
+		lastSelectedStack = selectedStack;
+		lastSelectedSize = selectedSize;
+		lastVesselCount = vessels.size();
+		needsReconcile = false;
+	}
+
+	if (toMerge.size() > 0)
+	{
+		std::vector<UINT> members(toMerge.begin(), toMerge.end());
+		toMerge.clear();
+		submitJob(members, vessels);
+	}
+}
+
+void StaticGeometryBake::invalidate()
+{
+	Log::writeToLog(Log::L_DEBUG, "Invalidating static geometry bake");
+	while (chunks.size() > 0)
+		dismantleChunk(chunks.begin()->first);
+	//results of running jobs are dropped when they arrive, since their vessels aren't pending anymore
+	pendingIn.clear();
+	toMerge.clear();
+	needsReconcile = true;
+}
+
+//brings the bake in line with the scene: vessels of the selected stack get taken out,
+//everything else that isn't baked or on its way gets queued for merging
+void StaticGeometryBake::reconcile(const VesselRegistry& vessels, VesselStack* selectedStack)
+{
+	std::set<UINT> selected;
+	if (selectedStack)
+	{
+		for (UINT i = 0; i < selectedStack->numVessels(); ++i)
+			selected.insert(selectedStack->getVessel(i)->getUID());
+	}
+
+	//take apart chunks that contain selected or deleted vessels
+	std::set<UINT> doomedChunks;
+	for (std::map<UINT, UINT>::iterator it = bakedIn.begin(); it != bakedIn.end(); ++it)
+	{
+		if (selected.count(it->first) || !vessels.contains(it->first))
+			doomedChunks.insert(it->second);
+	}
+	for (std::set<UINT>::iterator it = doomedChunks.begin(); it != doomedChunks.end(); ++it)
+		dismantleChunk(*it);
+
+	//forget pending vessels that got selected or deleted, their job result will be discarded
+	for (std::map<UINT, UINT>::iterator it = pendingIn.begin(); it != pendingIn.end();)
+	{
+		if (selected.count(it->first) || !vessels.contains(it->first))
+			it = pendingIn.erase(it);
+		else
+			++it;
+	}
+
+	toMerge.clear();
+	for (VesselRegistry::const_iterator it = vessels.begin(); it != vessels.end(); ++it)
+	{
+		if (!selected.count(it->first) && !bakedIn.count(it->first) && !pendingIn.count(it->first))
+			toMerge.insert(it->first);
+	}
+}
+
+//removes a chunk from rendering. its vessels draw themselves again until they are merged into a new chunk
+void StaticGeometryBake::dismantleChunk(UINT chunkId)
+{
+	std::map<UINT, StaticBakeChunk*>::iterator pos = chunks.find(chunkId);
+	if (pos == chunks.end())
+		return;
+	StaticBakeChunk* chunk = pos->second;
+	for (UINT i = 0; i < chunk->members.size(); ++i)
+	{
+		bakedIn.erase(chunk->members[i]);
+		if (Helpers::isUIDRegistered(chunk->members[i]))
+		{
+			Helpers::getVesselByUID(chunk->members[i])->setBaked(false);
+			toMerge.insert(chunk->members[i]);
+		}
+	}
+	freeChunk(chunk);
+	chunks.erase(pos);
+	//the caller decides which of the freed vessels actually get merged again
+	needsReconcile = true;
+}
+
+void StaticGeometryBake::installChunk(StaticBakeChunk* chunk, const VesselRegistry& vessels)
+{
+	//the chunk is only valid if nothing happened to any of its vessels while it was baking
+	bool valid = true;
+	for (UINT i = 0; i < chunk->members.size(); ++i)
+	{
+		std::map<UINT, UINT>::iterator pos = pendingIn.find(chunk->members[i]);
+		if (pos == pendingIn.end() || pos->second != chunk->id || !vessels.contains(chunk->members[i]))
+		{
+			valid = false;
+			break;
+		}
+	}
+
+	if (!valid)
+	{
+		Log::writeToLog(Log::L_DEBUG, "Discarding outdated static bake chunk ", chunk->id);
+		//whoever is still waiting for this chunk has to go again
+		for (UINT i = 0; i < chunk->members.size(); ++i)
+		{
+			std::map<UINT, UINT>::iterator pos = pendingIn.find(chunk->members[i]);
+			if (pos != pendingIn.end() && pos->second == chunk->id)
+			{
+				pendingIn.erase(pos);
+				toMerge.insert(chunk->members[i]);
+			}
+		}
+		freeChunk(chunk);
+		return;
+	}
+
+	for (UINT i = 0; i < chunk->members.size(); ++i)
+	{
+		pendingIn.erase(chunk->members[i]);
+		bakedIn[chunk->members[i]] = chunk->id;
+		vessels.get(chunk->members[i])->setBaked(true);
+	}
+	chunks[chunk->id] = chunk;
+	Log::writeToLog(Log::L_DEBUG, "Installed static bake chunk ", chunk->id, " with ", chunk->members.size(),
+		" vessels in ", chunk->buffers.size(), " buffers");
+	consolidate();
+}
+
+//keeps the number of chunks, and with it the number of draw calls, bounded by merging the smallest ones again
+void StaticGeometryBake::consolidate()
+{
+	while (chunks.size() > maxChunks)
+	{
+		UINT smallest[2] = { 0, 0 };
+		UINT smallestSize[2] = { UINT_MAX, UINT_MAX };
+		for (std::map<UINT, StaticBakeChunk*>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+		{
+			UINT size = it->second->members.size();
+			if (size < smallestSize[0])
+			{
+				smallest[1] = smallest[0];
+				smallestSize[1] = smallestSize[0];
+				smallest[0] = it->first;
+				smallestSize[0] = size;
+			}
+			else if (size < smallestSize[1])
+			{
+				smallest[1] = it->first;
+				smallestSize[1] = size;
+			}
+		}
+		dismantleChunk(smallest[0]);
+		dismantleChunk(smallest[1]);
+	}
+}
+
+void StaticGeometryBake::submitJob(const std::vector<UINT>& members, const VesselRegistry& vessels)
+{
+	StaticBakeJob job;
+	job.id = nextId++;
+	for (UINT i = 0; i < members.size(); ++i)
+	{
+		VesselSceneNode* vessel = vessels.get(members[i]);
+		if (vessel == 0)
+			continue;
+		vessel->updateAbsolutePosition();
+		job.members.push_back(members[i]);
+		job.meshes.push_back(vessel->returnVesselData()->vesselMesh);
+		job.transforms.push_back(vessel->getAbsoluteTransformation());
+		pendingIn[members[i]] = job.id;
+	}
+	if (job.members.size() == 0)
+		return;
+
+	Log::writeToLog(Log::L_DEBUG, "Queueing static bake job ", job.id, " with ", job.members.size(), " vessels");
+	jobMutex.lock(__FUNCTION__);
+	jobs.push_back(job);
+	jobMutex.unlock();
+	jobCondition.notify_one();
+}
+
+void StaticGeometryBake::workerLoop()
+{
+	while (true)
+	{
+		StaticBakeJob job;
+		{
+			jobMutex.lock(__FUNCTION__);
+			std::unique_lock<ProfiledMutex> lock(jobMutex, std::adopt_lock);
+			while (jobs.size() == 0 && !stopWorker)
+				jobCondition.wait(lock);
+			if (stopWorker)
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		StaticBakeChunk* chunk = new StaticBakeChunk;
+		chunk->id = job.id;
+		chunk->members = job.members;
+		bakeJob(job, *chunk);
+
+		jobMutex.lock(__FUNCTION__);
+		finishedChunks.push_back(chunk);
+		jobMutex.unlock();
+	}
+}
+
+//merges the transformed geometry of all vessels in the job into one 32 bit mesh buffer per distinct material
+void StaticGeometryBake::bakeJob(const StaticBakeJob& job, StaticBakeChunk& chunk)
+{
+	bool boxInitialised = false;
+	for (UINT i = 0; i < job.members.size(); ++i)
+	{
+		OrbiterMesh* mesh = job.meshes[i];
+		const core::matrix4& transform = job.transforms[i];
+		for (UINT g = 0; g < mesh->meshGroups.size(); ++g)
+		{
+			const OrbiterMeshGroup& group = mesh->meshGroups[g];
+			if (group.renderMaterialIndex == -1)
+				continue;
+			const video::SMaterial& material = mesh->renderMaterials[group.renderMaterialIndex];
+
+			//find the buffer for this material, identical materials of different meshes share one
+			scene::CDynamicMeshBuffer* target = 0;
+			for (UINT m = 0; m < chunk.materials.size(); ++m)
+			{
+				if (chunk.materials[m] == material)
+				{
+					target = (scene::CDynamicMeshBuffer*)chunk.buffers[m];
+					break;
+				}
+			}
+			if (target == 0)
+			{
+				target = new scene::CDynamicMeshBuffer(video::EVT_STANDARD, video::EIT_32BIT);
+				target->setHardwareMappingHint(scene::EHM_STATIC);
+				chunk.materials.push_back(material);
+				chunk.buffers.push_back(target);
+			}
+
+			const scene::IMeshBuffer* source = group.meshBuffer;
+			const video::S3DVertex* vertices = (const video::S3DVertex*)source->getVertices();
+			u32 base = target->getVertexBuffer().size();
+			for (u32 v = 0; v < source->getVertexCount(); ++v)
+			{
+				video::S3DVertex vertex = vertices[v];
+				transform.transformVect(vertex.Pos);
+				transform.rotateVect(vertex.Normal);
+				vertex.Normal.normalize();
+				target->getVertexBuffer().push_back(vertex);
+				if (!boxInitialised)
+				{
+					chunk.box.reset(vertex.Pos);
+					boxInitialised = true;
+				}
+				else
+					chunk.box.addInternalPoint(vertex.Pos);
+			}
+
+			if (source->getIndexType() == video::EIT_16BIT)
+			{
+				const u16* indices = (const u16*)source->getIndices();
+				for (u32 n = 0; n < source->getIndexCount(); ++n)
+					target->getIndexBuffer().push_back(base + indices[n]);
+			}
+			else
+			{
+				const u32* indices = (const u32*)source->getIndices();
+				for (u32 n = 0; n < source->getIndexCount(); ++n)
+					target->getIndexBuffer().push_back(base + indices[n]);
+			}
+		}
+	}
+	for (UINT m = 0; m < chunk.buffers.size(); ++m)
+		chunk.buffers[m]->recalculateBoundingBox();
+}
+
+void StaticGeometryBake::OnRegisterSceneNode()
+{
+	if (IsVisible && chunks.size() > 0)
+		SceneManager->registerNodeForRendering(this);
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void StaticGeometryBake::render()
+{
+	VesselRenderQueue* queue = VesselRenderQueue::getQueue(SceneManager);
+	scene::ICameraSceneNode* camera = SceneManager->getActiveCamera();
+	for (std::map<UINT, StaticBakeChunk*>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+	{
+		StaticBakeChunk* chunk = it->second;
+		if (camera && !camera->getViewFrustum()->getBoundingBox().intersectsWithBox(chunk->box))
+			continue;
+		for (UINT i = 0; i < chunk->buffers.size(); ++i)
+			queue->addItem(chunk->buffers[i], &chunk->materials[i], &identity, false);
+	}
+}
+
+const core::aabbox3d<f32>& StaticGeometryBake::getBoundingBox() const
+{
+	return box;
+}
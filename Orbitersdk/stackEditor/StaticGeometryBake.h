@@ -0,0 +1,89 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <climits>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "VesselSceneNode.h"
+#include "VesselStack.h"
+
+//merged, pre-transformed geometry of a group of vessels, one mesh buffer per material
+struct StaticBakeChunk
+{
+	UINT id;
+	std::vector<UINT> members;
+	std::vector<video::SMaterial> materials;
+	std::vector<scene::IMeshBuffer*> buffers;
+	core::aabbox3d<f32> box;
+};
+
+//a batch of vessels handed to the bake thread. the transforms are copied, so the thread never touches the scene
+struct StaticBakeJob
+{
+	UINT id;
+	std::vector<UINT> members;
+	std::vector<OrbiterMesh*> meshes;
+	std::vector<core::matrix4> transforms;
+};
+
+//draws all vessels that aren't in the selected stack from a few large per-material buffers.
+//merging happens on a background thread; until a vessel is baked it simply renders itself.
+//selecting a stack takes the chunks containing its vessels apart, deselecting merges them back in as a new chunk
+class StaticGeometryBake : public scene::ISceneNode
+{
+public:
+	StaticGeometryBake(scene::ISceneNode* parent, scene::ISceneManager* mgr);
+	~StaticGeometryBake();
+
+	//called once per frame. picks up finished chunks and reacts to selection changes and added or removed vessels
+	void update(const VesselRegistry& vessels, VesselStack* selectedStack);
+	//throws away all baked geometry. needed whenever unselected vessels get moved, e.g. by undo or session loading
+	void invalidate();
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+	virtual const core::aabbox3d<f32>& getBoundingBox() const;
+
+private:
+	void reconcile(const VesselRegistry& vessels, VesselStack* selectedStack);
+	void dismantleChunk(UINT chunkId);
+	void installChunk(StaticBakeChunk* chunk, const VesselRegistry& vessels);
+	void submitJob(const std::vector<UINT>& members, const VesselRegistry& vessels);
+	void freeChunk(StaticBakeChunk* chunk);
+	void consolidate();
+
+	void workerLoop();
+	static void bakeJob(const StaticBakeJob& job, StaticBakeChunk& chunk);
+
+	std::map<UINT, StaticBakeChunk*> chunks;
+	std::map<UINT, UINT> bakedIn;					//vessel uid -> chunk id
+	std::map<UINT, UINT> pendingIn;					//vessel uid -> job id
+	std::set<UINT> toMerge;							//vessels waiting to be handed to the bake thread
+	UINT nextId;
+
+	//selection signature, so the scene only gets walked when something changed
+	VesselStack* lastSelectedStack;
+	UINT lastSelectedSize;
+	UINT lastVesselCount;
+	bool needsReconcile;
+
+	core::matrix4 identity;
+	core::aabbox3d<f32> box;
+
+	std::thread worker;
+	ProfiledMutex jobMutex;
+	std::condition_variable_any jobCondition;
+	std::deque<StaticBakeJob> jobs;
+	std::vector<StaticBakeChunk*> finishedChunks;
+	bool stopWorker;
+
+	static const UINT maxChunks = 8;				//past this, the smallest chunks get merged together again
+};
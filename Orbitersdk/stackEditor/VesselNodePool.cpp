@@ -0,0 +1,110 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "VesselNodePool.h"
+#include "Metrics.h"
+
+std::map<scene::ISceneManager*, VesselNodePool*> VesselNodePool::pools;
+
+VesselNodePool* VesselNodePool::getPool(scene::ISceneManager* mgr)
+{
+	std::map<scene::ISceneManager*, VesselNodePool*>::iterator pos = pools.find(mgr);
+	if (pos != pools.end())
+		return pos->second;
+
+	VesselNodePool* pool = new VesselNodePool(mgr->getRootSceneNode(), mgr);
+	//the root node holds the pool from now on
+	pool->drop();
+	return pool;
+}
+
+//the id is 0, so id masked picking never returns the pool
+VesselNodePool::VesselNodePool(scene::ISceneNode* parent, scene::ISceneManager* mgr)
+	: scene::ISceneNode(parent, mgr, 0), pooledVessels(0)
+{
+	setAutomaticCulling(scene::EAC_OFF);
+	pools[mgr] = this;
+}
+
+VesselNodePool::~VesselNodePool()
+{
+	clear();
+	pools.erase(SceneManager);
+}
+
+VesselSceneNode* VesselNodePool::acquire(VesselData* data, scene::ISceneNode* parent, s32 id)
+{
+	return acquire(data, parent, id, VesselSceneNode::allocateUID());
+}
+
+VesselSceneNode* VesselNodePool::acquire(VesselData* data, scene::ISceneNode* parent, s32 id, UINT uid)
+{
+	std::map<VesselData*, std::vector<VesselSceneNode*> >::iterator pos = freeVessels.find(data);
+	if (pos == freeVessels.end() || pos->second.size() == 0)
+	{
+		Metrics::incrementCounter("vessel_pool.misses");
+		return new VesselSceneNode(data, parent, SceneManager, id, uid);
+	}
+
+	VesselSceneNode* vessel = pos->second.back();
+	pos->second.pop_back();
+	pooledVessels--;
+	//the reference we held is the caller's now
+	vessel->recycle(parent, id, uid);
+	Metrics::incrementCounter("vessel_pool.hits");
+	reportMetrics();
+	return vessel;
+}
+
+VesselSceneNode* VesselNodePool::acquire(const VesselSceneNodeState& state, scene::ISceneNode* parent, s32 id)
+{
+	VesselSceneNode* vessel = acquire(state.vesData, parent, id, state.uid);
+	vessel->loadState(state);
+	return vessel;
+}
+
+void VesselNodePool::release(VesselSceneNode* vessel)
+{
+	vessel->removeAll(); //removeAll only drops children, not the node itself
+	vessel->detach();
+	vessel->remove(); //the caller's reference is all that's left now
+	//a vessel of another scene manager would come back hooked up to that scene's renderers
+	if (vessel->getSceneManager() != SceneManager || pooledVessels >= maxPooledVessels)
+	{
+		vessel->drop();
+		return;
+	}
+	freeVessels[vessel->returnVesselData()].push_back(vessel);
+	pooledVessels++;
+	reportMetrics();
+}
+
+void VesselNodePool::clear()
+{
+	for (auto it = freeVessels.begin(); it != freeVessels.end(); ++it)
+	{
+		for (UINT i = 0; i < it->second.size(); ++i)
+			it->second[i]->drop();
+	}
+	freeVessels.clear();
+	pooledVessels = 0;
+	reportMetrics();
+}
+
+void VesselNodePool::OnRegisterSceneNode()
+{
+	//nothing to draw, the pooled vessels aren't part of the scene graph
+}
+
+void VesselNodePool::render()
+{
+}
+
+const core::aabbox3d<f32>& VesselNodePool::getBoundingBox() const
+{
+	return box;
+}
+
+void VesselNodePool::reportMetrics()
+{
+	Metrics::setGauge("vessel_pool.size", pooledVessels);
+}
@@ -0,0 +1,50 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+
+#include "VesselSceneNode.h"
+
+using namespace irr;
+
+//keeps vessels that were deleted from the scene, so the next vessel of the same class can reuse them instead of
+//building a new scene node and setting up all its docking ports again. undoing a paste, or loading a session over
+//another one, deletes and adds hundreds of vessels of the same few classes.
+//the pool is a node below the root, like the render queue, so the vessels it still holds get deleted with the scene
+class VesselNodePool : public scene::ISceneNode
+{
+public:
+	//returns the pool of the passed scene manager, creating it if it doesn't exist yet
+	static VesselNodePool* getPool(scene::ISceneManager* mgr);
+
+	~VesselNodePool();
+
+	//work like new VesselSceneNode: the vessel is a child of parent, and the caller holds a reference to it
+	VesselSceneNode* acquire(VesselData* data, scene::ISceneNode* parent, s32 id);
+	VesselSceneNode* acquire(VesselData* data, scene::ISceneNode* parent, s32 id, UINT uid);
+	VesselSceneNode* acquire(const VesselSceneNodeState& state, scene::ISceneNode* parent, s32 id);
+	//takes the vessel out of the scene and takes over the caller's reference. replaces removeAll, remove and drop
+	void release(VesselSceneNode* vessel);
+	//deletes all vessels waiting to be reused
+	void clear();
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+	virtual const core::aabbox3d<f32>& getBoundingBox() const;
+
+	//past this, released vessels get deleted right away. so do vessels of another scene manager
+	static const unsigned int maxPooledVessels = 4096;
+
+private:
+	VesselNodePool(scene::ISceneNode* parent, scene::ISceneManager* mgr);
+	void reportMetrics();
+
+	std::map<VesselData*, std::vector<VesselSceneNode*> > freeVessels;
+	unsigned int pooledVessels;
+	core::aabbox3d<f32> box;
+
+	static std::map<scene::ISceneManager*, VesselNodePool*> pools;
+};
@@ -0,0 +1,116 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "VesselRegistry.h"
+#include "Log.h"
+#include <algorithm>
+
+VesselRegistry::VesselRegistry()
+{
+}
+
+bool VesselRegistry::add(unsigned int uid, VesselSceneNode* vessel)
+{
+	if (uid > maxUID)
+	{
+		Log::writeToLog(Log::ERR, "VesselRegistry: uid ", uid, " is out of range, vessel not registered");
+		return false;
+	}
+	if (uid >= slots.size())
+	{
+		Slot freeSlot;
+		freeSlot.index = noVessel;
+		freeSlot.generation = 0;
+		slots.resize(uid + 1, freeSlot);
+	}
+	if (slots[uid].index != noVessel)
+	{
+		//same as the map did, the new vessel replaces the old one
+		Log::writeToLog(Log::WARN, "VesselRegistry: uid ", uid, " registered twice");
+		entries[slots[uid].index].second = vessel;
+		return true;
+	}
+	slots[uid].index = entries.size();
+	entries.push_back(VesselRegistryEntry(uid, vessel));
+	return true;
+}
+
+void VesselRegistry::remove(unsigned int uid)
+{
+	if (!contains(uid))
+		return;
+	//fill the gap with the last entry
+	unsigned int index = slots[uid].index;
+	if (index != entries.size() - 1)
+	{
+		entries[index] = entries.back();
+		slots[entries[index].first].index = index;
+	}
+	entries.pop_back();
+	slots[uid].index = noVessel;
+	slots[uid].generation++;
+}
+
+VesselSceneNode* VesselRegistry::get(unsigned int uid) const
+{
+	if (!contains(uid))
+		return 0;
+	return entries[slots[uid].index].second;
+}
+
+bool VesselRegistry::contains(unsigned int uid) const
+{
+	return uid < slots.size() && slots[uid].index != noVessel;
+}
+
+unsigned int VesselRegistry::findFreeUID(unsigned int startNum) const
+{
+	//new vessels count up past everything there is, so this hardly ever has to look at a slot
+	if (startNum > maxUID)
+		startNum = 0;
+	while (contains(startNum))
+		startNum = startNum < maxUID ? startNum + 1 : 0;
+	return startNum;
+}
+
+VesselHandle VesselRegistry::getHandle(unsigned int uid) const
+{
+	VesselHandle handle;
+	handle.uid = uid;
+	if (uid < slots.size())
+		handle.generation = slots[uid].generation;
+	return handle;
+}
+
+VesselSceneNode* VesselRegistry::get(const VesselHandle& handle) const
+{
+	if (!contains(handle.uid) || slots[handle.uid].generation != handle.generation)
+		return 0;
+	return entries[slots[handle.uid].index].second;
+}
+
+VesselRegistry::const_iterator VesselRegistry::begin() const
+{
+	return entries.begin();
+}
+
+VesselRegistry::const_iterator VesselRegistry::end() const
+{
+	return entries.end();
+}
+
+unsigned int VesselRegistry::size() const
+{
+	return entries.size();
+}
+
+void VesselRegistry::getSorted(std::vector<VesselRegistryEntry>& sorted) const
+{
+	//walking the slots gives uid order without sorting anything
+	sorted.clear();
+	sorted.reserve(entries.size());
+	for (unsigned int uid = 0; uid < slots.size(); ++uid)
+	{
+		if (slots[uid].index != noVessel)
+			sorted.push_back(entries[slots[uid].index]);
+	}
+}
@@ -0,0 +1,65 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <vector>
+#include <utility>
+
+class VesselSceneNode;
+
+//uid and vessel, laid out like a std::map entry so loops over the registry read the same as loops over a map
+typedef std::pair<unsigned int, VesselSceneNode*> VesselRegistryEntry;
+
+//refers to one particular vessel. stays invalid after the vessel is gone, even if its uid gets taken again
+struct VesselHandle
+{
+	VesselHandle() : uid(0), generation(0) {}
+	unsigned int uid;
+	unsigned int generation;
+};
+
+//all vessels of the scene by uid. the uids are what the session files refer to, so they are never changed, only looked up.
+//every uid has a slot with the index of its vessel in a dense array, so looking up a vessel is two array accesses,
+//and going through all vessels walks one contiguous array. removing a vessel moves the last one into its place.
+//uids are handed out counting up from 0, so the slots stay about as many as there are vessels
+class VesselRegistry
+{
+public:
+	typedef std::vector<VesselRegistryEntry>::const_iterator const_iterator;
+
+	VesselRegistry();
+
+	//returns false, and leaves the vessel out, if the uid is above maxUID
+	bool add(unsigned int uid, VesselSceneNode* vessel);
+	void remove(unsigned int uid);
+	//returns 0 if there's no vessel with that uid
+	VesselSceneNode* get(unsigned int uid) const;
+	bool contains(unsigned int uid) const;
+	//returns the first uid at or after startNum that isn't taken
+	unsigned int findFreeUID(unsigned int startNum) const;
+
+	VesselHandle getHandle(unsigned int uid) const;
+	//returns 0 if the vessel the handle was taken from is gone
+	VesselSceneNode* get(const VesselHandle& handle) const;
+
+	//in no particular order
+	const_iterator begin() const;
+	const_iterator end() const;
+	unsigned int size() const;
+	//fills entries with all vessels, ordered by uid
+	void getSorted(std::vector<VesselRegistryEntry>& entries) const;
+
+	//every uid up to this one has a slot, so uids from files have to be checked against it before they get here
+	static const unsigned int maxUID = (1 << 20) - 1;
+
+private:
+	struct Slot
+	{
+		unsigned int index;				//in entries, noVessel if the uid is free
+		unsigned int generation;		//counts up every time a vessel with this uid is removed
+	};
+	static const unsigned int noVessel = 0xffffffff;
+
+	std::vector<Slot> slots;
+	std::vector<VesselRegistryEntry> entries;
+};
@@ -0,0 +1,135 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#include "VesselRenderQueue.h"
+#include <algorithm>
+
+std::map<scene::ISceneManager*, VesselRenderQueue*> VesselRenderQueue::queues;
+VesselRenderStats VesselRenderQueue::renderStats;
+
+void VesselRenderStats::reset()
+{
+	drawCalls = 0;
+	materialSwitches = 0;
+	textureSwitches = 0;
+	transformChanges = 0;
+	triangles = 0;
+	culledVessels = 0;
+	culledGroups = 0;
+	culledTriangles = 0;
+}
+
+//sorts opaque items so items sharing a texture, and then a material, end up next to each other
+static bool opaqueItemOrder(const VesselRenderItem &a, const VesselRenderItem &b)
+{
+	if (a.material->getTexture(0) != b.material->getTexture(0))
+		return a.material->getTexture(0) < b.material->getTexture(0);
+	if (a.material->MaterialType != b.material->MaterialType)
+		return a.material->MaterialType < b.material->MaterialType;
+	if (a.material != b.material)
+		return a.material < b.material;
+	return a.transform < b.transform;
+}
+
+//sorts transparent items back to front
+static bool transparentItemOrder(const VesselRenderItem &a, const VesselRenderItem &b)
+{
+	return a.cameraDistance > b.cameraDistance;
+}
+
+VesselRenderQueue* VesselRenderQueue::getQueue(scene::ISceneManager* mgr)
+{
+	std::map<scene::ISceneManager*, VesselRenderQueue*>::iterator pos = queues.find(mgr);
+	if (pos != queues.end())
+		return pos->second;
+
+	VesselRenderQueue* queue = new VesselRenderQueue(mgr->getRootSceneNode(), mgr);
+	//the root node holds the queue from now on, it gets deleted together with the scene
+	queue->drop();
+	return queue;
+}
+
+VesselRenderQueue::VesselRenderQueue(scene::ISceneNode* parent, scene::ISceneManager* mgr)
+	: scene::ISceneNode(parent, mgr, 0)
+{
+	//the queue draws whatever got submitted, the vessels already did their own culling
+	setAutomaticCulling(scene::EAC_OFF);
+	//the id is 0 so id masked picking never hits the queue instead of a vessel
+	queues[mgr] = this;
+}
+
+VesselRenderQueue::~VesselRenderQueue()
+{
+	queues.erase(SceneManager);
+}
+
+void VesselRenderQueue::addItem(const scene::IMeshBuffer *meshBuffer, const video::SMaterial *material, const core::matrix4 *transform, bool transparent, f32 cameraDistance)
+{
+	VesselRenderItem item;
+	item.meshBuffer = meshBuffer;
+	item.material = material;
+	item.transform = transform;
+	item.cameraDistance = cameraDistance;
+	if (transparent)
+		transparentItems.push_back(item);
+	else
+		opaqueItems.push_back(item);
+}
+
+void VesselRenderQueue::OnRegisterSceneNode()
+{
+	//registration happens before any node renders, so this is the start of a new frame for the queue
+	opaqueItems.clear();
+	transparentItems.clear();
+	if (IsVisible)
+		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT);
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void VesselRenderQueue::render()
+{
+	video::IVideoDriver* driver = SceneManager->getVideoDriver();
+
+	std::sort(opaqueItems.begin(), opaqueItems.end(), opaqueItemOrder);
+	drawItems(driver, opaqueItems);
+
+	std::sort(transparentItems.begin(), transparentItems.end(), transparentItemOrder);
+	drawItems(driver, transparentItems);
+
+	opaqueItems.clear();
+	transparentItems.clear();
+}
+
+void VesselRenderQueue::drawItems(video::IVideoDriver* driver, const std::vector<VesselRenderItem> &items)
+{
+	const video::SMaterial *boundMaterial = 0;
+	const core::matrix4 *boundTransform = 0;
+	for (u32 i = 0; i < items.size(); ++i)
+	{
+		const VesselRenderItem &item = items[i];
+		//different meshes can end up with identical materials, only switch if something actually changes
+		if (boundMaterial == 0 || (item.material != boundMaterial && *item.material != *boundMaterial))
+		{
+			if (boundMaterial == 0 || item.material->getTexture(0) != boundMaterial->getTexture(0))
+				renderStats.textureSwitches++;
+			driver->setMaterial(*item.material);
+			renderStats.materialSwitches++;
+		}
+		boundMaterial = item.material;
+
+		if (item.transform != boundTransform)
+		{
+			driver->setTransform(video::ETS_WORLD, *item.transform);
+			boundTransform = item.transform;
+			renderStats.transformChanges++;
+		}
+
+		driver->drawMeshBuffer(item.meshBuffer);
+		renderStats.drawCalls++;
+		renderStats.triangles += item.meshBuffer->getIndexCount() / 3;
+	}
+}
+
+const core::aabbox3d<f32>& VesselRenderQueue::getBoundingBox() const
+{
+	return box;
+}
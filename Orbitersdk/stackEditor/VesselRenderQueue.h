@@ -0,0 +1,65 @@
+//Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
+//The MIT License - See ../../LICENSE for more info
+#pragma once
+
+#include <irrlicht.h>
+#include <vector>
+#include <map>
+
+using namespace irr;
+
+//per frame rendering counters, reset by the main loop before drawing
+struct VesselRenderStats
+{
+	VesselRenderStats() : drawCalls(0), materialSwitches(0), textureSwitches(0), transformChanges(0),
+		triangles(0), culledVessels(0), culledGroups(0), culledTriangles(0) {}
+	void reset();
+	unsigned int drawCalls;
+	unsigned int materialSwitches;
+	unsigned int textureSwitches;
+	unsigned int transformChanges;
+	unsigned int triangles;
+	unsigned int culledVessels;
+	unsigned int culledGroups;
+	unsigned int culledTriangles;
+};
+
+//a single mesh group of a vessel waiting to be drawn
+struct VesselRenderItem
+{
+	const scene::IMeshBuffer *meshBuffer;
+	const video::SMaterial *material;
+	const core::matrix4 *transform;
+	f32 cameraDistance;				//only used to sort transparent items
+};
+
+//collects the mesh groups of all visible vessels in a scene manager and draws them in one pass.
+//opaque items are sorted by texture and material to keep state changes down,
+//transparent items are drawn back to front afterwards.
+//the queue renders in the transparent pass, so all vessels have submitted their items by then.
+class VesselRenderQueue : public scene::ISceneNode
+{
+public:
+	//returns the queue of the passed scene manager, creating it if it doesn't exist yet
+	static VesselRenderQueue* getQueue(scene::ISceneManager* mgr);
+
+	~VesselRenderQueue();
+
+	void addItem(const scene::IMeshBuffer *meshBuffer, const video::SMaterial *material, const core::matrix4 *transform, bool transparent, f32 cameraDistance = 0);
+
+	virtual void OnRegisterSceneNode();
+	virtual void render();
+	virtual const core::aabbox3d<f32>& getBoundingBox() const;
+
+	static VesselRenderStats renderStats;
+
+private:
+	VesselRenderQueue(scene::ISceneNode* parent, scene::ISceneManager* mgr);
+	void drawItems(video::IVideoDriver* driver, const std::vector<VesselRenderItem> &items);
+
+	std::vector<VesselRenderItem> opaqueItems;
+	std::vector<VesselRenderItem> transparentItems;
+	core::aabbox3d<f32> box;
+
+	static std::map<scene::ISceneManager*, VesselRenderQueue*> queues;
+};
@@ -1,6 +1,7 @@
 //Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
 //The MIT License - See ../../LICENSE for more info
 #include "VesselSceneNode.h"
+#include "SE_State.h"
 
 VesselSceneNodeState::VesselSceneNodeState(VesselData* data, ifstream& file)
 {
@@ -90,21 +91,28 @@ void VesselSceneNodeState::saveToFile(ofstream& file)
 }
 
 UINT VesselSceneNode::next_uid = 0;
+SoftwareOcclusionCuller* VesselSceneNode::occlusionCuller = NULL;
+SE_UndoHistory* VesselSceneNode::undoHistory = NULL;
+std::map<VesselData*, std::vector<RigidTransform> > VesselSceneNode::classPortFrames;
 
 VesselSceneNode::VesselSceneNode(VesselData *vesData, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id, UINT _uid)
-    : scene::ISceneNode(parent, mgr, id), smgr(mgr), uid(_uid)
+    : scene::ISceneNode(parent, mgr, id), smgr(mgr), uid(_uid), pickingTree(0), hasFrustum(false), transparent(false), baked(false), attached(false)
 {
     Log::writeToLog(Log::INFO, "Creating VesselSceneNode with UID: ", _uid, " and classname: ", vesData->className);
 	vesselData = vesData;
 	vesselMesh = vesselData->vesselMesh;
 	dockingPorts = vesselData->dockingPorts;
-
-	setupDockingPortNodes();
-    //set own UID
-    //currently unsafe, as it doesn't check if the UID is actually unique
-    uid = _uid;
-    //register self with map
-    Helpers::registerVessel(uid, this);
+	renderQueue = VesselRenderQueue::getQueue(mgr);
+	portMarkers = DockingPortMarkerRenderer::getRenderer(mgr);
+	//our ports live in the marker renderer, so it has to stay around until we're gone
+	portMarkers->grab();
+	//we do the frustum check ourselves on registration, so we can cull single groups as well
+	setAutomaticCulling(scene::EAC_OFF);
+
+	setupDockingPorts();
+	pickingTree = ScenePickingTree::getTree(mgr);
+	pickingTree->grab();
+	attach(id, _uid);
 }
 
 VesselSceneNode::VesselSceneNode(const VesselSceneNodeState& state, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id)
@@ -117,8 +125,64 @@ VesselSceneNode::VesselSceneNode(const VesselSceneNodeState& state, scene::IScen
 VesselSceneNode::~VesselSceneNode()
 {
     Log::writeToLog(Log::INFO, "Deleting VesselSceneNode with UID: ", uid);
+	if (attached)
+		detach();
+	pickingTree->drop();
+	portMarkers->drop();
+}
+
+UINT VesselSceneNode::allocateUID()
+{
+	//counting on from the uid that was handed out, so the count wraps around with the registry instead of running past it
+	UINT uid = Helpers::findFreeUID(next_uid);
+	next_uid = uid + 1;
+	return uid;
+}
+
+//everything that makes the vessel part of the scene, the rest of the constructor a recycled vessel doesn't have to do again
+void VesselSceneNode::attach(s32 id, UINT _uid)
+{
+	ID = id;
+    //set own UID
+    //currently unsafe, as it doesn't check if the UID is actually unique
+    uid = _uid;
+	attached = true;
+	//the markers are drawn and picked by the marker renderer, they start out hidden
+	portMarkers->addVessel(this);
+	graphIndex = DockingGraph::addVessel(this);
+	pickingTree->addVessel(this);
+    //register self with map
+    Helpers::registerVessel(uid, this);
+	aboutToChange();
+}
+
+void VesselSceneNode::detach()
+{
+	aboutToChange();
     //unregister self from map
     Helpers::unregisterVessel(uid);
+	DockingGraph::removeVessel(this);
+	pickingTree->removeVessel(this);
+	portMarkers->removeVessel(this);
+	attached = false;
+}
+
+void VesselSceneNode::recycle(scene::ISceneNode* parent, s32 id, UINT _uid)
+{
+    Log::writeToLog(Log::INFO, "Recycling VesselSceneNode with UID: ", _uid, " and classname: ", vesselData->className);
+	setParent(parent);
+	//the port geometry stays, only what a vessel can change about itself goes back to the start
+	for (UINT i = 0; i < dockingPorts.size(); i++)
+		dockingPorts[i].docked = false;
+	ISceneNode::setPosition(core::vector3df(0, 0, 0));
+	ISceneNode::setRotation(core::vector3df(0, 0, 0));
+	ISceneNode::updateAbsolutePosition();
+	setVisible(true);
+	transparent = false;
+	baked = false;
+	hasFrustum = false;
+	orbitername = "";
+	attach(id, _uid);
 }
 
 UINT VesselSceneNode::getUID()
@@ -126,7 +190,12 @@ UINT VesselSceneNode::getUID()
     return uid;
 }
 
-void VesselSceneNode::setupDockingPortNodes()
+unsigned int VesselSceneNode::getGraphIndex()
+{
+	return graphIndex;
+}
+
+void VesselSceneNode::setupDockingPorts()
 {
 	for (UINT i = 0; i < dockingPorts.size(); i++)
 	{
@@ -134,83 +203,100 @@ void VesselSceneNode::setupDockingPortNodes()
 		dockingPorts[i].docked = false;
         dockingPorts[i].portID = i;
 
-		dockingPorts[i].portNode = smgr->addSphereSceneNode((f32)1.1, 16, this, DOCKPORT_ID, dockingPorts[i].position);
-		setupDockingPortNode(dockingPorts[i].portNode);
-
-		//rotate portNode so it has the actual orientation of the dockport (direction and up)
-		core::matrix4 matrix;
+		//give the port the actual orientation of the dockport (direction and up)
 		//it's not a camera, but basically the same thing... except in reverse.
-		matrix.buildCameraLookAtMatrixLH(core::vector3df(0, 0, 0), dockingPorts[i].approachDirection, dockingPorts[i].referenceDirection).makeInverse();
-		dockingPorts[i].portNode->setRotation(matrix.getRotationDegrees());
-
-		//the helper node is used to avoid collision conflicts when checking for visual overlap between the mousecursor and docking nodes
-		//in short, the currently selected stack turns on the helper nodes to avoid stealing the overlap event from other vessels
-		dockingPorts[i].helperNode = smgr->addSphereSceneNode((f32)1.1, 16, this, HELPER_ID, dockingPorts[i].position);
-		setupDockingPortNode(dockingPorts[i].helperNode);
+		dockingPorts[i].relativeTransform.buildCameraLookAtMatrixLH(core::vector3df(0, 0, 0), dockingPorts[i].approachDirection, dockingPorts[i].referenceDirection).makeInverse();
+		dockingPorts[i].relativeTransform.setTranslation(dockingPorts[i].position);
 	}
 }
 
-void VesselSceneNode::setupDockingPortNode(IMeshSceneNode *node)
+void VesselSceneNode::OnRegisterSceneNode()
 {
-	//deactivate lighting so we don't get reflections on the nodes and make them transparent
-	node->setMaterialFlag(EMF_LIGHTING, false);
-	node->setMaterialType(video::EMT_TRANSPARENT_ADD_COLOR);
+	if (IsVisible && !baked)
+	{
+		//bring the camera frustum into mesh coordinates, so group bounding boxes can be tested directly
+		scene::ICameraSceneNode* camera = SceneManager->getActiveCamera();
+		hasFrustum = camera != 0;
+		if (hasFrustum)
+		{
+			localFrustum = *camera->getViewFrustum();
+			localFrustum.transform(core::matrix4(AbsoluteTransformation, core::matrix4::EM4CONST_INVERSE));
+		}
+
+		if (hasFrustum && (isOutsideFrustum(vesselMesh->boundingBox) || isOccluded(getTransformedBoundingBox())))
+		{
+			VesselRenderQueue::renderStats.culledVessels++;
+			for (UINT i = 0; i < vesselMesh->meshGroups.size(); i++)
+				VesselRenderQueue::renderStats.culledTriangles += vesselMesh->meshGroups[i].triangleCount;
+		}
+		else
+			smgr->registerNodeForRendering(this);
+	}
+	//the docking port nodes are children, they get registered no matter what happened to us
+	ISceneNode::OnRegisterSceneNode();
+}
 
-	//now that we don't have lighting, we have to set vertex color directly to have any effect
-	S3DVertex *vertices = (S3DVertex*)(node->getMesh()->getMeshBuffer(0)->getVertices());
-	UINT vertexcount = node->getMesh()->getMeshBuffer(0)->getVertexCount();
-	SColor vertexcolor = SColor(255, 13, 161, 247);
-	for (UINT i = 0; i < vertexcount; ++i)
+//returns true if the box, in mesh coordinates, lies completely outside of one of the frustum planes
+bool VesselSceneNode::isOutsideFrustum(const core::aabbox3d<f32>& box)
+{
+	for (UINT i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; i++)
 	{
-		vertices[i].Color = vertexcolor;
+		if (box.classifyPlaneRelation(localFrustum.planes[i]) == core::ISREL3D_FRONT)
+			return true;
 	}
+	return false;
+}
 
-	node->setVisible(false);
+//returns true if the box, in world coordinates, is hidden behind other vessels
+bool VesselSceneNode::isOccluded(const core::aabbox3d<f32>& box)
+{
+	return occlusionCuller && occlusionCuller->isActiveFor(SceneManager) && occlusionCuller->isOccluded(box);
 }
 
-void VesselSceneNode::OnRegisterSceneNode()
+bool VesselSceneNode::isGroupOccluded(UINT group)
 {
-	if (IsVisible)
-		smgr->registerNodeForRendering(this);
-	ISceneNode::OnRegisterSceneNode();
+	if (!occlusionCuller)
+		return false;
+	core::aabbox3d<f32> worldBox = vesselMesh->meshGroups[group].boundingBox;
+	AbsoluteTransformation.transformBoxEx(worldBox);
+	return isOccluded(worldBox);
 }
 
 void VesselSceneNode::render()
 {
-	video::IVideoDriver* driver = SceneManager->getVideoDriver();
-	//loop over the mesh groups, drawing them
+	//our geometry is already part of a merged buffer
+	if (baked)
+		return;
+
+	//the mesh groups don't get drawn here, they get handed to the render queue
+	//so they can be sorted by material together with the groups of all other vessels
+	const vector<video::SMaterial> &groupMaterials = transparent ? vesselMesh->transparentRenderMaterials : vesselMesh->renderMaterials;
+	f32 cameraDistance = 0;
+	if (transparent && SceneManager->getActiveCamera())
+	{
+		cameraDistance = (f32)getTransformedBoundingBox().getCenter().getDistanceFromSQ(
+			SceneManager->getActiveCamera()->getAbsolutePosition());
+	}
 	for (UINT i = 0; i < vesselMesh->meshGroups.size(); i++)
 	{
-		//set the texture of the material
-		//set it to zero if there is no texture
-		if (vesselMesh->meshGroups[i].textureIndex == 0)
-			vesselMesh->materials[vesselMesh->meshGroups[i].materialIndex].setTexture(0, 0);
-		else if (vesselMesh->meshGroups[i].materialIndex < (int)vesselMesh->materials.size() &&
-			vesselMesh->meshGroups[i].textureIndex < (int)vesselMesh->textures.size())
-			vesselMesh->materials[vesselMesh->meshGroups[i].materialIndex].setTexture(0,
-				vesselMesh->textures[vesselMesh->meshGroups[i].textureIndex]);
-		//set the material for the video driver
-		if (vesselMesh->meshGroups[i].materialIndex < (int)vesselMesh->materials.size())
+		//groups without a valid material can't be drawn sensibly
+		int materialIndex = vesselMesh->meshGroups[i].renderMaterialIndex;
+		if (materialIndex == -1)
+			continue;
+		if (hasFrustum && (isOutsideFrustum(vesselMesh->meshGroups[i].boundingBox) || isGroupOccluded(i)))
 		{
-			SMaterial material = vesselMesh->materials[vesselMesh->meshGroups[i].materialIndex];
-			if (transparent)
-			{
-				material.Lighting = false;
-				material.MaterialType = EMT_TRANSPARENT_ADD_COLOR;
-			}
-			driver->setMaterial(material);
+			VesselRenderQueue::renderStats.culledGroups++;
+			VesselRenderQueue::renderStats.culledTriangles += vesselMesh->meshGroups[i].triangleCount;
+			continue;
 		}
-		//set transform
+		renderQueue->addItem(vesselMesh->meshGroups[i].meshBuffer, &groupMaterials[materialIndex],
+			&AbsoluteTransformation, transparent, cameraDistance);
+	}
+	if (DEBUG)
+	{
+		video::IVideoDriver* driver = SceneManager->getVideoDriver();
 		driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
-		//and draw it as a triangle list!
-		driver->drawVertexPrimitiveList(vesselMesh->meshGroups[i].vertices.data(),
-			vesselMesh->meshGroups[i].vertices.size(), vesselMesh->meshGroups[i].triangleList.data(),
-			vesselMesh->meshGroups[i].triangleList.size() / 3, video::EVT_STANDARD, scene::EPT_TRIANGLES,
-			video::EIT_32BIT);
-		if (DEBUG)
-		{
-			drawDockingPortLines(driver);
-		}
+		drawDockingPortLines(driver);
 	}
 }
 
@@ -227,6 +313,31 @@ void VesselSceneNode::drawDockingPortLines(video::IVideoDriver* driver)
 	}
 }
 
+void VesselSceneNode::updateAbsolutePosition()
+{
+	core::matrix4 previousTransformation = AbsoluteTransformation;
+	ISceneNode::updateAbsolutePosition();
+	//the picking tree only refits vessels that actually moved
+	if (pickingTree != 0 && AbsoluteTransformation != previousTransformation)
+	{
+		pickingTree->markMoved(this);
+		StackMassProperties::vesselMoved(this);
+	}
+}
+
+//the undo history has to see where the vessel was before it moves
+void VesselSceneNode::setPosition(const core::vector3df& newpos)
+{
+	aboutToChange();
+	ISceneNode::setPosition(newpos);
+}
+
+void VesselSceneNode::setRotation(const core::vector3df& rotation)
+{
+	aboutToChange();
+	ISceneNode::setRotation(rotation);
+}
+
 const core::aabbox3d<f32>& VesselSceneNode::getBoundingBox() const
 {
 	return vesselMesh->boundingBox;
@@ -234,58 +345,74 @@ const core::aabbox3d<f32>& VesselSceneNode::getBoundingBox() const
 
 u32 VesselSceneNode::getMaterialCount()
 {
-	return vesselMesh->materials.size();
+	return vesselMesh->renderMaterials.size();
 }
 
 video::SMaterial& VesselSceneNode::getMaterial(u32 i)
 {
-	return vesselMesh->materials[i];
+	return vesselMesh->renderMaterials[i];
 }
 
 void VesselSceneNode::changeDockingPortVisibility(bool showEmpty, bool showDocked, bool showHelper)
 {
+	//helper markers are used to avoid collision conflicts when checking for visual overlap between the mousecursor and docking ports
+	//in short, the currently selected stack shows helper markers to avoid stealing the overlap event from other vessels
+	u32 markerType = showHelper ? HELPER_ID : DOCKPORT_ID;
 	for (unsigned int i = 0; i < dockingPorts.size(); i++)
 	{
-		if (showHelper)
-		//show the helper node instead of the port node. 
-		{
-			if (dockingPorts[i].docked == false)
-				dockingPorts[i].helperNode->setVisible(showEmpty);
-			else
-				dockingPorts[i].helperNode->setVisible(showDocked);
-		}
-		else
-		{
-			if (dockingPorts[i].docked == false)
-				dockingPorts[i].portNode->setVisible(showEmpty);
-			else
-				dockingPorts[i].portNode->setVisible(showDocked);
-		}
+		bool show = dockingPorts[i].docked ? showDocked : showEmpty;
+		setDockingPortMarker(i, show ? markerType : 0);
 	}
 }
 
+void VesselSceneNode::setDockingPortMarker(UINT portID, u32 flags)
+{
+	portMarkers->setFlags(dockingPorts[portID].markerIndex, flags);
+}
+
+core::matrix4 VesselSceneNode::getDockingPortAbsoluteTransformation(UINT portID)
+{
+	return AbsoluteTransformation * dockingPorts[portID].relativeTransform;
+}
+
+core::vector3df VesselSceneNode::getDockingPortAbsolutePosition(UINT portID)
+{
+	core::vector3df position = dockingPorts[portID].position;
+	AbsoluteTransformation.transformVect(position);
+	return position;
+}
+
 core::vector3df VesselSceneNode::returnRotatedVector(const core::vector3df& vec)
 {
 	//update our absolute position
 	updateAbsolutePosition();
 	//first, rotate the vector of the approach port by our current rotation
 	//do this by making a quaternoin
-	core::quaternion thisRotation = core::quaternion(getRotation() * core::DEGTORAD);
+	//use the absolute rotation, the vessel might be sitting in the group of a stack that's being moved
+	core::quaternion thisRotation = core::quaternion(AbsoluteTransformation.getRotationDegrees() * core::DEGTORAD);
 	//now return a rotated vector
 	return thisRotation * vec;
 }
 
-void VesselSceneNode::snap(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort)
+const std::vector<RigidTransform>& VesselSceneNode::getPortFrames()
 {
+	std::map<VesselData*, std::vector<RigidTransform> >::iterator pos = classPortFrames.find(vesselData);
+	if (pos != classPortFrames.end())
+		return pos->second;
 
-	ISceneNode* ourNode = ourPort.portNode;
-	ISceneNode* theirNode = theirPort.portNode;
+	std::vector<RigidTransform>& frames = classPortFrames[vesselData];
+	for (UINT i = 0; i < dockingPorts.size(); ++i)
+		frames.push_back(DockingSolver::getPortFrame(dockingPorts[i].position, dockingPorts[i].approachDirection, dockingPorts[i].referenceDirection));
+	return frames;
+}
 
-	theirNode->updateAbsolutePosition();
-	ourNode->updateAbsolutePosition();
+//returns the absolute transformation this vessel needs for ourPort to sit on theirPort, without moving anything
+core::matrix4 VesselSceneNode::getSnapTransformation(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort)
+{
+	theirPort.parent->updateAbsolutePosition();
 
 	//absolute rotation of the target port
-	core::matrix4 theirMatrix = theirNode->getAbsoluteTransformation();
+	core::matrix4 theirMatrix = theirPort.parent->getDockingPortAbsoluteTransformation(theirPort.portID);
 
 	//Origin up and facing (inversed) of the target port
 	core::vector3df theirDir = core::vector3df(0, 0, -1);
@@ -302,24 +429,26 @@ void VesselSceneNode::snap(OrbiterDockingPort& ourPort, OrbiterDockingPort& thei
 	ourPortToTheirPort.buildCameraLookAtMatrixLH(core::vector3df(0, 0, 0), theirDir, theirRot).makeInverse();
 
 	//get inverted source port rotation relative to its vessel
-	core::matrix4 ourVesselToOurPort = ourNode->getRelativeTransformation();
-	ourVesselToOurPort.makeInverse();
+	core::matrix4 ourVesselToOurPort = core::matrix4(ourPort.relativeTransform, core::matrix4::EM4CONST_INVERSE);
 
 	//multiply the rotation from our vessel origin to our port and from our port origin to the target to get the total transformation for the vessel
 	core::matrix4 ourVesselToTheirPort = ourPortToTheirPort * ourVesselToOurPort;
 
-	//apply the whole brouhaha
-	setRotation(ourVesselToTheirPort.getRotationDegrees());
+	//position the vessel so the docking ports touch
+	core::vector3df portOffset = ourPort.position;
+	ourVesselToTheirPort.setTranslation(core::vector3df(0, 0, 0));
+	ourVesselToTheirPort.rotateVect(portOffset);
+	ourVesselToTheirPort.setTranslation(theirPort.parent->getDockingPortAbsolutePosition(theirPort.portID) - portOffset);
+	return ourVesselToTheirPort;
+}
 
-	//we MUST update positions for getAbsolutePosition to reflect the rotation we just did.
-	//also, we MUST update the position of the parent before the child, or the child still won't reflect the changes
-	//we also MUST update the child seperately, it doesn't get updated by the parent
-	updateAbsolutePosition();
-	ourNode->updateAbsolutePosition();
+void VesselSceneNode::snap(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort)
+{
+	core::matrix4 snapTransformation = getSnapTransformation(ourPort, theirPort);
 
-	//position the vessel so the docking ports touch
-	core::vector3df pos = ourNode->getAbsolutePosition() - getAbsolutePosition();
-	setPosition(theirNode->getAbsolutePosition() - pos);
+	//apply the whole brouhaha
+	setRotation(snapTransformation.getRotationDegrees());
+	setPosition(snapTransformation.getTranslation());
 	//update the new position, in case there's a vessel being snapped to this right next
 	updateAbsolutePosition();				
 }
@@ -329,6 +458,8 @@ void VesselSceneNode::dock(OrbiterDockingPort& ourPort, OrbiterDockingPort& thei
     Log::writeToLog(Log::INFO, "Docking ourPort (VUID: ", ourPort.parent->getUID(), " PID: ", ourPort.portID,
         ") to theirPort (VUID: ", theirPort.parent->getUID(), " PID: ", theirPort.portID, ")");
 
+	ourPort.parent->aboutToChange();
+	theirPort.parent->aboutToChange();
 	//set both docked flags
 	ourPort.docked = true;
 	theirPort.docked = true;
@@ -338,6 +469,24 @@ void VesselSceneNode::dock(OrbiterDockingPort& ourPort, OrbiterDockingPort& thei
 
     theirPort.dockedTo.vesselUID = ourPort.parent->getUID();
     theirPort.dockedTo.portID = ourPort.portID;
+
+	ourPort.parent->dockingStatusChanged();
+	theirPort.parent->dockingStatusChanged();
+}
+
+//the free ports of the scene are indexed for snapping, docked ones have to leave the index.
+//the docking graph follows the docked flags as well
+void VesselSceneNode::dockingStatusChanged()
+{
+	pickingTree->markMoved(this);
+	DockingGraph::updateVessel(this);
+}
+
+void VesselSceneNode::aboutToChange()
+{
+	//the photo studio makes its own vessels for the toolbox images, those aren't part of the scene
+	if (undoHistory != NULL && ID == VESSEL_ID)
+		undoHistory->vesselChanging(this);
 }
 
 void VesselSceneNode::dock(UINT ourPortNum, UINT otherVesselUID, UINT otherPortID)
@@ -351,8 +500,18 @@ VesselSceneNodeState VesselSceneNode::saveState()
     VesselSceneNodeState output;
     output.vesData = returnVesselData();
     output.uid = uid;
-    output.pos = getPosition();
-    output.rot = getRotation();
+    if (Parent != SceneManager->getRootSceneNode())
+    //the vessel is part of a stack that is being moved around, see VesselStack::beginRigidTransform
+    {
+        updateAbsolutePosition();
+        output.pos = AbsoluteTransformation.getTranslation();
+        output.rot = AbsoluteTransformation.getRotationDegrees();
+    }
+    else
+    {
+        output.pos = getPosition();
+        output.rot = getRotation();
+    }
     output.orbiterName = orbitername;
 
     for (UINT i = 0; i < dockingPorts.size(); ++i)
@@ -382,31 +541,7 @@ void VesselSceneNode::loadState(const VesselSceneNodeState& state)
             dockingPorts[i].dockedTo = state.dockingStatus[i].dockedTo;
         }
     }
-
-}
-
-OrbiterDockingPort* VesselSceneNode::dockingPortSceneNodeToOrbiter(scene::ISceneNode* sceneNode)
-{
-	for (UINT i = 0; i < dockingPorts.size(); ++i)
-	{
-		if (sceneNode == dockingPorts[i].portNode)
-		{
-			return &(dockingPorts[i]);
-		}
-	}
-	return 0;
-}
-
-OrbiterDockingPort* VesselSceneNode::dockingPortHelperNodeToOrbiter(scene::ISceneNode* sceneNode)
-{
-	for (UINT i = 0; i < dockingPorts.size(); ++i)
-	{
-		if (sceneNode == dockingPorts[i].helperNode)
-		{
-			return &(dockingPorts[i]);
-		}
-	}
-	return 0;
+	dockingStatusChanged();
 }
 
 VesselData* VesselSceneNode::returnVesselData()
@@ -436,3 +571,14 @@ void VesselSceneNode::setTransparency(bool transparency)
 	transparent = transparency;
 }
 
+
+bool VesselSceneNode::isTransparent()
+{
+	return transparent;
+}
+
+
+void VesselSceneNode::setBaked(bool isBaked)
+{
+	baked = isBaked;
+}
@@ -14,6 +14,13 @@
 #include "OrbiterDockingPort.h"
 #include "resource.h"
 #include "DataManager.h"
+#include "VesselRenderQueue.h"
+#include "SoftwareOcclusionCuller.h"
+#include "DockingPortMarkers.h"
+#include "ScenePickingTree.h"
+#include "DockingGraph.h"
+#include "DockingSolver.h"
+#include "StackMassProperties.h"
 
 using namespace irr;
 using namespace std;
@@ -38,30 +45,41 @@ struct VesselSceneNodeState
     std::vector<DockingPortStatus> dockingStatus;
 };
 
+class SE_UndoHistory;
+
 class VesselSceneNode : public scene::ISceneNode
 {
 public:
-	VesselSceneNode(VesselData *vesData, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id, UINT _uid = Helpers::findFreeUID(next_uid++)); 
+	VesselSceneNode(VesselData *vesData, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id, UINT _uid = allocateUID());
     VesselSceneNode(const VesselSceneNodeState& state, scene::ISceneNode* parent, scene::ISceneManager* mgr, s32 id);
     ~VesselSceneNode();
 
 	virtual void OnRegisterSceneNode();
 	virtual void render();
+	virtual void updateAbsolutePosition();
+	virtual void setPosition(const core::vector3df& newpos);
+	virtual void setRotation(const core::vector3df& rotation);
 	virtual void drawDockingPortLines(video::IVideoDriver* driver);
 	virtual const core::aabbox3d<f32>& getBoundingBox() const;
 	virtual u32 getMaterialCount();
 	virtual video::SMaterial& getMaterial(u32 i);
-	void setupDockingPortNodes();
+	void setupDockingPorts();
 	void changeDockingPortVisibility(bool showEmpty, bool showDocked, bool showHelper = false);
+	void setDockingPortMarker(UINT portID, u32 flags);
+	core::matrix4 getDockingPortAbsoluteTransformation(UINT portID);
+	core::vector3df getDockingPortAbsolutePosition(UINT portID);
+	const std::vector<RigidTransform>& getPortFrames();		//port frames for the DockingSolver, shared by all vessels of a class
+	core::matrix4 getSnapTransformation(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort);
 	void snap(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort);
 	void dock(OrbiterDockingPort& ourPort, OrbiterDockingPort& theirPort);
     void dock(UINT ourPortNum, UINT otherVesselUID, UINT otherPortID);
+	void dockingStatusChanged();		//call after changing the docked flag of one of our ports from outside
+	void aboutToChange();				//call before changing the docked flag of one of our ports from outside
 	core::vector3df returnRotatedVector(const core::vector3df& vec);
 	VesselData* returnVesselData();
 	void setTransparency(bool transparency);
-
-	OrbiterDockingPort* dockingPortSceneNodeToOrbiter(scene::ISceneNode* sceneNode);
-	OrbiterDockingPort* dockingPortHelperNodeToOrbiter(scene::ISceneNode* sceneNode);
+	bool isTransparent();
+	void setBaked(bool isBaked);
 
     VesselSceneNodeState saveState();
     void loadState(const VesselSceneNodeState& state);
@@ -69,6 +87,8 @@ public:
 	std::string getClassName();
 
     UINT getUID();
+	static UINT allocateUID();			//a UID no vessel uses yet
+	unsigned int getGraphIndex();		//dense index of the vessel in the DockingGraph
 	std::string getOrbiterName();
 	void setOrbiterName(std::string name);
 
@@ -76,13 +96,34 @@ public:
 
     class UID_Mismatch : public std::exception {};
 
+	//used by the VesselNodePool. detach takes the vessel out of everything that knows about the vessels in the scene,
+	//recycle resets it to how a new vessel starts out and puts it back in, under a new UID if need be
+	void detach();
+	void recycle(scene::ISceneNode* parent, s32 id, UINT _uid);
+
+	static SoftwareOcclusionCuller* occlusionCuller;		//only set if occlusion culling is switched on in the config
+	static SE_UndoHistory* undoHistory;						//gets told about every change to a vessel, if set
+
 private:
+	void attach(s32 id, UINT _uid);
+
     UINT uid;
     static UINT next_uid;
+	static std::map<VesselData*, std::vector<RigidTransform> > classPortFrames;
+	unsigned int graphIndex;
 	scene::ISceneManager* smgr;
+	VesselRenderQueue* renderQueue;
+	DockingPortMarkerRenderer* portMarkers;
+	ScenePickingTree* pickingTree;
 	OrbiterMesh *vesselMesh;
 	VesselData *vesselData;
-	void setupDockingPortNode(IMeshSceneNode *node);
+	bool isOutsideFrustum(const core::aabbox3d<f32>& box);
+	bool isOccluded(const core::aabbox3d<f32>& box);
+	bool isGroupOccluded(UINT group);
+	scene::SViewFrustum localFrustum;		//camera frustum in mesh coordinates, updated every frame on registration
+	bool hasFrustum;
 	bool transparent;
+	bool baked;						//true while the static geometry bake draws this vessel
+	bool attached;					//false while the vessel waits in the VesselNodePool
 	std::string orbitername;
 };
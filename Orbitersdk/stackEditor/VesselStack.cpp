@@ -2,15 +2,74 @@
 //The MIT License - See ../../LICENSE for more info
 #include "VesselStack.h"
 
-VesselStack::VesselStack(VesselSceneNode* startingVessel)
+VesselStack::VesselStack(VesselSceneNode* startingVessel) : group(0)
 {
-	//recurse through with the helper
-	createStackHelper(startingVessel);
+	//the stack is everything docked to the starting vessel, which has to come first
+	const std::vector<unsigned int>& component = DockingGraph::getComponent(startingVessel);
+	nodes.reserve(component.size());
+	nodes.push_back(startingVessel);
+	for (UINT i = 0; i < component.size(); ++i)
+	{
+		VesselSceneNode* vessel = DockingGraph::getVessel(component[i]);
+		if (vessel != startingVessel)
+			nodes.push_back(vessel);
+	}
+	for (UINT i = 0; i < nodes.size(); ++i)
+		nodeIndices[nodes[i]] = i;
 
     Log::writeToLog(Log::L_DEBUG, "Created vessel stack: ", toString());
 	issnaped = false;
 }
 
+VesselStack::~VesselStack()
+{
+	bakeTransforms();
+}
+
+//the group starts out where the first vessel is, so the first vessel sits at the origin of the group.
+//rotating the group then rotates the stack around the first vessel, same as it always did
+void VesselStack::beginRigidTransform()
+{
+	if (group != 0)
+		return;
+	scene::ISceneManager* smgr = nodes[0]->getSceneManager();
+	group = smgr->addEmptySceneNode(smgr->getRootSceneNode(), 0);
+	group->setPosition(nodes[0]->getPosition());
+	group->setRotation(nodes[0]->getRotation());
+	group->updateAbsolutePosition();
+
+	core::matrix4 worldToGroup(group->getAbsoluteTransformation(), core::matrix4::EM4CONST_INVERSE);
+	for (UINT i = 0; i < nodes.size(); ++i)
+	{
+		//the vessels are children of the root, their relative transformation is the absolute one
+		core::matrix4 relative = worldToGroup * nodes[i]->getRelativeTransformation();
+		//set the transformation while still under the root, so the undo history sees the world position it had
+		nodes[i]->setPosition(relative.getTranslation());
+		nodes[i]->setRotation(relative.getRotationDegrees());
+		nodes[i]->setParent(group);
+		nodes[i]->updateAbsolutePosition();
+	}
+}
+
+void VesselStack::bakeTransforms()
+{
+	if (group == 0)
+		return;
+	group->updateAbsolutePosition();
+	scene::ISceneNode* root = group->getSceneManager()->getRootSceneNode();
+	for (UINT i = 0; i < nodes.size(); ++i)
+	{
+		core::matrix4 absolute = group->getAbsoluteTransformation() * nodes[i]->getRelativeTransformation();
+		//still under the group while the transformation changes, same reason as above
+		nodes[i]->setPosition(absolute.getTranslation());
+		nodes[i]->setRotation(absolute.getRotationDegrees());
+		nodes[i]->setParent(root);
+		nodes[i]->updateAbsolutePosition();
+	}
+	group->remove();
+	group = 0;
+}
+
 void VesselStack::changeDockingPortVisibility(bool showEmpty, bool showDocked)
 {
 		for (unsigned int i = 0; i < nodes.size(); i++)
@@ -45,17 +104,18 @@ void VesselStack::rotateStack(core::quaternion relativeRot)
 {
     Log::writeToLog(Log::INFO, "Rotating vessel stack: ", toString(),
         "by X: ", relativeRot.X, " Y: ", relativeRot.Y, " Z: ", relativeRot.Z, " W: ", relativeRot.W);
-	//simplified by only rotating the first vessel in the stack (the one the stack was selected with) and just snapping the rest of the stack to it.
-	//prevents the stack from running away when being rotated.
+	//only the group gets rotated. the first vessel sits at its origin, so the stack rotates around it
+	//and the rest of the stack just comes along, there's no need to snap it.
+	beginRigidTransform();
 
-	core::quaternion thisNodeRotation = core::quaternion(nodes[0]->getRotation() * core::DEGTORAD);
+	core::quaternion thisNodeRotation = core::quaternion(group->getRotation() * core::DEGTORAD);
 	//rotate this sucker
 	thisNodeRotation = thisNodeRotation * relativeRot;
 	//set the rotation
 	core::vector3df eulerRotation;
 	thisNodeRotation.toEuler(eulerRotation);
-	nodes[0]->setRotation(eulerRotation * core::RADTODEG);
-	nodes[0]->updateAbsolutePosition();
+	group->setRotation(eulerRotation * core::RADTODEG);
+	group->updateAbsolutePosition();
 	snapStack(0);
 
 	//use the force, erm, quaternoins to rotate each node in the stack to avoid gimbal lock
@@ -65,12 +125,9 @@ void VesselStack::setMoveReference(core::vector3df refPos)
 {
 	//set the reference
 	moveReference = refPos;
-	//set the inital positions of each node
-	previousPositions.clear();
-	for (unsigned int i = 0; i < nodes.size(); i++)
-	{
-		previousPositions.push_back(nodes[i]->getPosition());
-	}
+	//from now on only the group moves
+	beginRigidTransform();
+	groupStartPosition = group->getPosition();
 }
 
 void VesselStack::moveStackRelative(core::vector3df movePos)
@@ -89,18 +146,15 @@ void VesselStack::moveStackReferenced(core::vector3df movePos)
 	if (issnaped)
 		return;
 
-	//check to make sure that we have the same amount of positions in previousPositions than we have nodes
-	if (nodes.size() != previousPositions.size())
+	if (group == 0)
 	{
-        Log::writeToLog(Log::WARN, "Tried to move a vessel stack without setting up previousPositions");
+        Log::writeToLog(Log::WARN, "Tried to move a vessel stack without setting up a move reference");
 		return;
 	}
 
-	//loop over, setting relative position
-	for (unsigned int i = 0; i < nodes.size(); i++)
-	{
-		nodes[i]->setPosition(previousPositions[i] + (movePos - moveReference));
-	}
+	//the whole stack moves with the group
+	group->setPosition(groupStartPosition + (movePos - moveReference));
+	group->updateAbsolutePosition();
 
 	//set current location, in "move-referenced" local coords
 	currentStackLocation = movePos;
@@ -121,62 +175,54 @@ bool VesselStack::isSnaped()
 	return issnaped;
 }
 
-void VesselStack::checkForSnapping(VesselSceneNode* vessel, ISceneNode* dockportnode, bool dock)
+void VesselStack::checkForSnapping(OrbiterDockingPort* targetPort, bool dock)
 {
 	if (issnaped && !dock)
 		return;
 
-	//find which port on the target the node belongs to
-	int targetdock = -1;
-	for (UINT i = 0; i < vessel->dockingPorts.size(); ++i)
-	{
-		if (!vessel->dockingPorts[i].docked && dockportnode == vessel->dockingPorts[i].portNode)
-		{
-			targetdock = i;
-			break;
-		}
-	}
-	if (targetdock == -1)
+	if (targetPort->docked)
 	//the dockingport on the target is already occupied
 	{
 		return;
 	}
+	std::chrono::high_resolution_clock::time_point searchStart = std::chrono::high_resolution_clock::now();
+	core::vector3df targetPosition = targetPort->parent->getDockingPortAbsolutePosition(targetPort->portID);
+
+	//get the free ports of this stack closest to the snapping port in the world, and pick the one closest on screen
+	scene::ISceneManager* smgr = Helpers::irrdevice->getSceneManager();
+	std::vector<OrbiterDockingPort*> candidates;
+	ScenePickingTree::getTree(smgr)->findNearestFreePorts(targetPosition, snapCandidates,
+		[this](OrbiterDockingPort* port) { return isVesselInStack(port->parent); },
+		candidates);
 
-	//get the dockport on this stack that is closest to the snapping port
 	int closestvessel = -1;
 	int closestport = -1;
 	float closestdist = (float)99999999999;
-	for (UINT i = 0; i < nodes.size(); ++i)
+	ISceneCollisionManager *col = smgr->getSceneCollisionManager();
+	core::position2di targetScreenPosition = col->getScreenCoordinatesFrom3DPosition(targetPosition);
+	for (UINT i = 0; i < candidates.size(); ++i)
 	{
-		VesselSceneNode* v = nodes[i];
-		for (UINT j = 0; j < v->dockingPorts.size(); ++j)
+		//get the distance between the ports
+		float dist = targetScreenPosition.getDistanceFrom(col->getScreenCoordinatesFrom3DPosition(
+						candidates[i]->parent->getDockingPortAbsolutePosition(candidates[i]->portID)));
+		if (dist < closestdist)
+			//this one's closer, mark it as the closest so far
 		{
-			if (!v->dockingPorts[j].docked)
-			{
-				//get the distance between the ports
-				v->dockingPorts[j].portNode->updateAbsolutePosition();
-
-				ISceneCollisionManager *col = Helpers::irrdevice->getSceneManager()->getSceneCollisionManager();
-				float dist = col->getScreenCoordinatesFrom3DPosition(dockportnode->getAbsolutePosition()).getDistanceFrom(
-								col->getScreenCoordinatesFrom3DPosition(v->dockingPorts[j].portNode->getAbsolutePosition()));
-				if (dist < closestdist)
-					//this one's closer, mark it as the closest so far
-				{
-					closestvessel = i;
-					closestport = j;
-					closestdist = dist;
-				}
-			}
+			closestvessel = getIndexOfVessel(candidates[i]->parent);
+			closestport = candidates[i]->portID;
+			closestdist = dist;
 		}
 	}
+	Metrics::recordSample("snapping.search_us",
+		std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - searchStart).count());
 	
 	if (closestvessel != -1 && closestport != -1)
 	{
 		//we have a valid vessel in the stack and a valid dockport, let's snap
-		snapStack(closestvessel, closestport, &vessel->dockingPorts[targetdock]);
+		snapStack(closestvessel, closestport, targetPort);
 		if (dock)
 		{
-			nodes[closestvessel]->dock(nodes[closestvessel]->dockingPorts[closestport], vessel->dockingPorts[targetdock]);
+			nodes[closestvessel]->dock(nodes[closestvessel]->dockingPorts[closestport], *targetPort);
 		}
 	}
 }
@@ -189,91 +235,79 @@ void VesselStack::checkForSnapping(VesselSceneNode* vessel, ISceneNode* dockport
 void VesselStack::snapStack(int srcvesselidx, int srcdockportidx, OrbiterDockingPort *tgtport)
 {
 	VesselSceneNode *srcvessel = nodes[srcvesselidx];
-	vector<VesselSceneNode*> snapped_in_last_pass;							//will remember the vessels processed in the last pass
-	vector<VesselSceneNode*> hasSnapped = snapped_in_last_pass;				//will contain all vessels that have already snapped
-
-	if (tgtport != NULL && srcdockportidx != -1)
-	//a target port has been defined, snap the passed vessel to it
-	{
-		srcvessel->snap(srcvessel->dockingPorts[srcdockportidx], *tgtport);
-		hasSnapped.push_back(tgtport->parent);									//mark the vessel we snaped to, or the algorithm will spill over into the neighbouring stack
-	}
-
-	//continue to snap the rest of the stack to the source vessel
-	snapped_in_last_pass.push_back(srcvessel);								//this is where we start from
-
 
-	while (snapped_in_last_pass.size() != 0)									//if there's no vessels snapped in a pass, the algorithm is complete
+	if (group != 0)
+	//the stack is rigid, move the group so the source vessel ends up where snapping would put it
 	{
-		vector<VesselSceneNode*> snapped_in_this_pass;						//will remember the vessels snapped during this pass
-
-		for (vector<VesselSceneNode*>::iterator it = snapped_in_last_pass.begin(); it != snapped_in_last_pass.end(); ++it)
-		//loop through all vessels snapped in last pass
+		if (tgtport != NULL && srcdockportidx != -1)
 		{
-			VesselSceneNode * i = (*it);
-			for (vector<OrbiterDockingPort>::iterator jt = i->dockingPorts.begin(); jt != i->dockingPorts.end(); ++jt)
-			//loop through all dockports, snap all connected that aren't snapped already
-			{
-				OrbiterDockingPort j = (*jt);
-				if (j.docked && std::find(hasSnapped.begin(), hasSnapped.end(), Helpers::getVesselByUID(j.dockedTo.vesselUID)) == hasSnapped.end())
-				//if the dockport has a connection and the connected vessel hasn't snapped already
-				{
-                    VesselSceneNode* dockedToVessel = Helpers::getVesselByUID(j.dockedTo.vesselUID);
-					dockedToVessel->snap(dockedToVessel->dockingPorts[j.dockedTo.portID], j);
-					snapped_in_this_pass.push_back(dockedToVessel);
-					hasSnapped.push_back(dockedToVessel);
-				}
-			}
+			core::matrix4 snapped = srcvessel->getSnapTransformation(srcvessel->dockingPorts[srcdockportidx], *tgtport);
+			core::matrix4 groupTransformation = snapped * core::matrix4(srcvessel->getRelativeTransformation(), core::matrix4::EM4CONST_INVERSE);
+			group->setPosition(groupTransformation.getTranslation());
+			group->setRotation(groupTransformation.getRotationDegrees());
+			group->updateAbsolutePosition();
 		}
-		snapped_in_last_pass = snapped_in_this_pass;
+		issnaped = true;
+		return;
 	}
 
-	issnaped = true;
-}
-
-//recursive function to init a vessel stack
-void VesselStack::createStackHelper(VesselSceneNode* startingVessel)
-{
-	//recurse through the docking ports, through docked vessels
-
-	//if the nodes doesn't contain this vessel yet, add it and recurse through the nodes
-	if (std::find(nodes.begin(), nodes.end(), startingVessel) == nodes.end())
+	RigidTransform sourceTransform;
+	if (tgtport != NULL && srcdockportidx != -1)
+	//a target port has been defined, the passed vessel goes there
+	{
+		sourceTransform = DockingSolver::fromMatrix(srcvessel->getSnapTransformation(srcvessel->dockingPorts[srcdockportidx], *tgtport));
+	}
+	else
 	{
-		nodes.push_back(startingVessel);
+		srcvessel->updateAbsolutePosition();
+		sourceTransform = DockingSolver::fromMatrix(srcvessel->getAbsoluteTransformation());
+	}
 
-		for (UINT i = 0; i < startingVessel->dockingPorts.size(); ++i)
+	//the rest of the stack gets placed by the docking solver, starting out from the source vessel.
+	//the vessel we snapped to isn't docked to us yet, so the solver can't spill over into the neighbouring stack
+	DockingSolver solver;
+	for (UINT i = 0; i < nodes.size(); ++i)
+		solver.addVessel(&nodes[i]->getPortFrames());
+	for (UINT i = 0; i < nodes.size(); ++i)
+	{
+		const std::vector<DockingEdge>& edges = DockingGraph::getEdges(nodes[i]);
+		for (UINT j = 0; j < edges.size(); ++j)
 		{
-			//store all dockingport nodes in the stack. It could occur that the stack tries to dock with itself otherwise
-			dockportnodes.push_back(startingVessel->dockingPorts[i].portNode);
-            //and recurse into other vessels if docked
-            if (startingVessel->dockingPorts[i].docked)
-                createStackHelper(Helpers::getVesselByUID(startingVessel->dockingPorts[i].dockedTo.vesselUID));
+			//every docking shows up on both vessels, only add it once
+			int dockedToIndex = getIndexOfVessel(DockingGraph::getVessel(edges[j].otherVessel));
+			if (dockedToIndex > (int)i)
+				solver.addDocking(i, edges[j].ourPort, dockedToIndex, edges[j].otherPort);
 		}
 	}
+	solver.solve(srcvesselidx, sourceTransform);
 
-	//base case if we have already added this vessel to the list
+	//write the results back in one go
+	for (UINT i = 0; i < nodes.size(); ++i)
+	{
+		if (!solver.isSolved(i))
+			continue;
+		core::matrix4 transformation = DockingSolver::toMatrix(solver.getTransform(i));
+		nodes[i]->setRotation(transformation.getRotationDegrees());
+		nodes[i]->setPosition(transformation.getTranslation());
+		nodes[i]->updateAbsolutePosition();
+	}
 
-	//we must be in the base case!
-	return;
+	issnaped = true;
 }
 
-
 bool VesselStack::isVesselInStack(VesselSceneNode* vessel)
 {
-	return std::find(nodes.begin(), nodes.end(), vessel) != nodes.end();
+	return nodeIndices.count(vessel) != 0;
 }
 
 
 //returns the index of the vessel in the stacks nodes vector. returns -1 if vessel is not in stack
 int VesselStack::getIndexOfVessel(VesselSceneNode* vessel)
 {
-	int idx = -1;
-	vector<VesselSceneNode*>::iterator it = std::find(nodes.begin(), nodes.end(), vessel);
-	if (it != nodes.end())
-	{
-		idx = it - nodes.begin();
-	}
-	return idx;
+	std::unordered_map<VesselSceneNode*, int>::iterator pos = nodeIndices.find(vessel);
+	if (pos == nodeIndices.end())
+		return -1;
+	return pos->second;
 }
 
 UINT VesselStack::getStackSize()
@@ -289,7 +323,7 @@ void VesselStack::showFirstNodeForSplitting()
 	{
 		if (nodes[0]->dockingPorts[i].docked)
 		{
-			nodes[0]->dockingPorts[i].helperNode->setVisible(true);
+			nodes[0]->setDockingPortMarker(i, HELPER_ID);
 		}
 	}
 }
@@ -300,7 +334,7 @@ void VesselStack::resetFirstNode()
 	nodes[0]->setTransparency(false);
 	for (UINT i = 0; i < nodes[0]->dockingPorts.size(); ++i)
 	{
-		nodes[0]->dockingPorts[i].helperNode->setVisible(false);
+		nodes[0]->setDockingPortMarker(i, 0);
 	}
 }
 
@@ -3,25 +3,31 @@
 #pragma once
 
 #include "Log.h"
+#include "Metrics.h"
 
 #include <vector>
 #include <string>
 #include <map>
 #include <algorithm>
+#include <chrono>
+#include <unordered_map>
 #include "VesselSceneNode.h"
 #include "OrbiterDockingPort.h"
+#include "DockingGraph.h"
+#include "DockingSolver.h"
 
 class VesselStack
 {
 public:
 	VesselStack(VesselSceneNode* startingVessel);
+	~VesselStack();
 	void rotateStack(core::vector3df relativeRot);
 	void rotateStack(core::quaternion relativeRot);
 //	void rotateStackAroundVessel(core::vector3df relativeRot, VesselSceneNode *vessel = NULL);
 	void setMoveReference(core::vector3df refPos);
 	void moveStackReferenced(core::vector3df movePos);
 	void moveStackRelative(core::vector3df movePos);
-	void checkForSnapping(VesselSceneNode* vessel, ISceneNode* dockportnode, bool dock=false);
+	void checkForSnapping(OrbiterDockingPort* targetPort, bool dock=false);
 	void snapStack(int srcvesselidx, int srcdockportidx = -1, OrbiterDockingPort *tgtport = NULL);
 	void changeDockingPortVisibility(bool showEmpty, bool showDocked);
 	UINT numVessels();
@@ -30,18 +36,23 @@ public:
 	int getIndexOfVessel(VesselSceneNode* vessel);
 	void unSnap(core::vector3df refPos);
 	bool isSnaped();
-	OrbiterDockingPort* dockingPortSceneNodeToOrbiter(scene::ISceneNode* sceneNode);
 	UINT getStackSize();
 	void showFirstNodeForSplitting();
 	void resetFirstNode();
+	//moves the vessels under a common group node, so moving or rotating the stack only changes the group
+	void beginRigidTransform();
+	//writes the absolute transformations back to the vessels and puts them back under the root node.
+	//has to happen before anything reads vessel positions directly, which the destructor takes care of
+	void bakeTransforms();
 
     std::string toString();
 private:
-	//recursive helper to init the stack
-	void createStackHelper(VesselSceneNode* startingVessel);
-	std::vector<core::vector3df> previousPositions;
+	std::unordered_map<VesselSceneNode*, int> nodeIndices;	//index of every vessel in nodes
+	scene::ISceneNode* group;							//parent of all vessels while the stack is moved around, 0 otherwise
+	core::vector3df groupStartPosition;					//position of the group when the move reference was set
 	core::vector3df moveReference, currentStackLocation;
 	std::vector<VesselSceneNode*> nodes;
-	std::vector<ISceneNode*> dockportnodes;
 	bool issnaped;
+
+	static const u32 snapCandidates = 8;				//free ports of the stack projected to the screen when snapping
 };
@@ -1,6 +1,9 @@
 //Copyright (c) 2015 Christopher Johnstone(meson800) and Benedict Haefeli(jedidia)
 //The MIT License - See ../../LICENSE for more info
 #include "VesselStackOperations.h"
+#include "VesselNodePool.h"
+
+const f32 VesselStackOperations::coincidentPortAngle = 1.0f;
 
 void VesselStackOperations::splitStack(OrbiterDockingPort* sourcePort)
 {
@@ -9,9 +12,13 @@ void VesselStackOperations::splitStack(OrbiterDockingPort* sourcePort)
     OrbiterDockingPort* destPort = &(Helpers::getVesselByUID(sourcePort->dockedTo.vesselUID)->
         dockingPorts[sourcePort->dockedTo.portID]);
 	
+	sourcePort->parent->aboutToChange();
+	destPort->parent->aboutToChange();
 	//reset docked flags	
 	sourcePort->docked = false;
 	destPort->docked = false;
+	sourcePort->parent->dockingStatusChanged();
+	destPort->parent->dockingStatusChanged();
 	//reset dockedTo pointers
 	sourcePort->dockedTo.vesselUID = 0;
     sourcePort->dockedTo.portID = 0;
@@ -24,12 +31,15 @@ std::vector<VesselSceneNode*> VesselStackOperations::copyStack(VesselStack* stac
     Log::writeToLog(Log::INFO, "Copying vessel stack: ", stack->toString());
 	//Ugh, too bad ISceneNode doesn't implement a copy constructor, so we have to manually implement :(
 
+	//the copies take their positions from the originals, so those have to be real world positions
+	stack->bakeTransforms();
+
 	//Start by copying every node
 	vector<VesselSceneNode*> newNodes;
 	for (UINT i = 0; i < stack->numVessels(); ++i)
 	{
 		VesselSceneNode* oldVessel = stack->getVessel(i);
-		VesselSceneNode* newVessel = new VesselSceneNode(oldVessel->returnVesselData(), smgr->getRootSceneNode(), smgr, VESSEL_ID);
+		VesselSceneNode* newVessel = VesselNodePool::getPool(smgr)->acquire(oldVessel->returnVesselData(), smgr->getRootSceneNode(), VESSEL_ID);
 		newNodes.push_back(newVessel);
 
 		//Now copy position and rotation of node
@@ -59,6 +69,7 @@ std::vector<VesselSceneNode*> VesselStackOperations::copyStack(VesselStack* stac
 			newVessel->dockingPorts[j].dockedTo.vesselUID = vesselUIDTransferMap[oldVessel->dockingPorts[j].dockedTo.vesselUID];
             newVessel->dockingPorts[j].dockedTo.portID = oldVessel->dockingPorts[j].dockedTo.portID;
 		}
+		newVessel->dockingStatusChanged();
 	}
 
 	//Finally, return the new vessels we created so they can be registered
@@ -71,11 +82,46 @@ std::vector<VesselSceneNode*> VesselStackOperations::copyStack(VesselStack* stac
 void VesselStackOperations::deleteStack(VesselStack* stack)
 {
     Log::writeToLog(Log::INFO, "Deleting vessel stack: ", stack->toString());
+	//gets rid of the group node
+	stack->bakeTransforms();
 	for (UINT i = 0; i < stack->numVessels(); ++i)
 	{
         VesselSceneNode* vessel = stack->getVessel(i);
-		vessel->removeAll(); //removeAll only drops children, not the node itself
-		vessel->remove(); //remove from scene graph
-        vessel->drop(); //We need the extra drop because we called VesselSceneNode, which returns a pointer
+		//kept around for the next vessel of its class, pasting and undoing the delete make new ones right away
+		VesselNodePool::getPool(vessel->getSceneManager())->release(vessel);
 	}
 }
+
+std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> > VesselStackOperations::dockCoincidentPorts(
+	const std::vector<VesselSceneNode*>& moved, scene::ISceneManager* smgr, f32 maxDistance)
+{
+	std::chrono::high_resolution_clock::time_point searchStart = std::chrono::high_resolution_clock::now();
+	//vessels that were just loaded or snapped may not have their absolute positions up to date yet.
+	//updating them marks them as moved, the picking tree refits only those
+	for (UINT i = 0; i < moved.size(); ++i)
+		moved[i]->updateAbsolutePosition();
+
+	f32 minCos = cos(coincidentPortAngle * core::DEGTORAD);
+	//docked ports face each other, with the same up direction. see VesselSceneNode::snap
+	auto portsMatch = [minCos](OrbiterDockingPort* a, OrbiterDockingPort* b)
+	{
+		core::matrix4 transformA = a->parent->getDockingPortAbsoluteTransformation(a->portID);
+		core::matrix4 transformB = b->parent->getDockingPortAbsoluteTransformation(b->portID);
+		core::vector3df dirA(0, 0, 1), dirB(0, 0, 1), upA(0, 1, 0), upB(0, 1, 0);
+		transformA.rotateVect(dirA);
+		transformB.rotateVect(dirB);
+		transformA.rotateVect(upA);
+		transformB.rotateVect(upB);
+		return dirA.normalize().dotProduct(dirB.normalize()) <= -minCos && upA.normalize().dotProduct(upB.normalize()) >= minCos;
+	};
+
+	std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> > pairs;
+	ScenePickingTree::getTree(smgr)->findCoincidentFreePorts(maxDistance, portsMatch, pairs);
+	for (UINT i = 0; i < pairs.size(); ++i)
+		pairs[i].first->parent->dock(*pairs[i].first, *pairs[i].second);
+
+	Metrics::recordSample("autodock.search_us",
+		std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - searchStart).count());
+	Metrics::incrementCounter("autodock.pairs", pairs.size());
+	return pairs;
+}
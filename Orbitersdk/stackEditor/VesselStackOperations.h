@@ -15,4 +15,11 @@ public:
 	static void splitStack(OrbiterDockingPort* sourcePort);
 	static std::vector<VesselSceneNode*> copyStack(VesselStack* stack, scene::ISceneManager* smgr);
 	static void deleteStack(VesselStack* stack);
+	//docks every pair of free ports in the scene that sit on top of each other, facing each other with matching up directions.
+	//moved are the vessels that were created or moved since the last frame, the rest of the scene is already up to date.
+	//returns the pairs that got docked
+	static std::vector<std::pair<OrbiterDockingPort*, OrbiterDockingPort*> > dockCoincidentPorts(
+		const std::vector<VesselSceneNode*>& moved, scene::ISceneManager* smgr, f32 maxDistance);
+
+	static const f32 coincidentPortAngle;			//maximum angle in degrees between the directions of two ports that get docked
 };
@@ -49,7 +49,7 @@ int main()
 	Helpers::workingDirectory = directory;
 
 	//pass it off to StackEditor
-	stackEditor.setupDevice(device, params.toolboxset);
+	stackEditor.setupDevice(device, params);
 	//and run!
 	stackEditor.loop();
 	device->drop();
@@ -133,7 +133,7 @@ void OpenSE()
 	Helpers::workingDirectory = directory;
 
 	//pass it off to StackEditor
-	stackEditor.setupDevice(device, params.toolboxset);
+	stackEditor.setupDevice(device, params);
 	//and run!
 	stackEditor.loop();
 	device->drop();